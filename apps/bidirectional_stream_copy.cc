@@ -3,6 +3,8 @@
 #include "byte_stream.hh"
 #include "eventloop.hh"
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <unistd.h>
 
@@ -11,6 +13,7 @@ using namespace std;
 void bidirectional_stream_copy( Socket& socket, string_view peer_name )
 {
 	constexpr size_t buffer_size = 1048576;
+	constexpr uint64_t read_size = 65536; // reserved per read, so a stream's buffer grows only as data arrives
 
 	EventLoop eventloop {};
 	FileDescriptor input { STDIN_FILENO };
@@ -30,10 +33,9 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
 	  input,
 	  Direction::In,
 	  [&] {
-		  string data;
-		  data.resize( outbound.writer().available_capacity() );
-		  input.read( data );
-		  outbound.writer().push( move( data ) );
+		  const uint64_t len = min( outbound.writer().available_capacity(), read_size );
+		  const auto regions = outbound.writer().reserve( len );
+		  outbound.writer().commit( input.read( regions ) );
 		  if ( input.eof() ) {
 			  outbound.writer().close();
 		  }
@@ -56,7 +58,7 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
 	  Direction::Out,
 	  [&] {
 		  if ( outbound.reader().bytes_buffered() ) {
-			  outbound.reader().pop( socket.write( outbound.reader().peek() ) );
+			  outbound.reader().pop( socket.write( outbound.reader().peek_regions() ) );
 		  }
 		  if ( outbound.reader().is_finished() ) {
 			  socket.shutdown( SHUT_WR );
@@ -81,10 +83,9 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
 	  socket,
 	  Direction::In,
 	  [&] {
-		  string data;
-		  data.resize( inbound.writer().available_capacity() );
-		  socket.read( data );
-		  inbound.writer().push( move( data ) );
+		  const uint64_t len = min( inbound.writer().available_capacity(), read_size );
+		  const auto regions = inbound.writer().reserve( len );
+		  inbound.writer().commit( socket.read( regions ) );
 		  if ( socket.eof() ) {
 			  inbound.writer().close();
 		  }
@@ -107,7 +108,7 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
 	  Direction::Out,
 	  [&] {
 		  if ( inbound.reader().bytes_buffered() ) {
-			  inbound.reader().pop( output.write( inbound.reader().peek() ) );
+			  inbound.reader().pop( output.write( inbound.reader().peek_regions() ) );
 		  }
 		  if ( inbound.reader().is_finished() ) {
 			  output.close();
@@ -0,0 +1,205 @@
+#include "eventloop.hh"
+#include "eventloop_group.hh"
+#include "socket.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+void show_usage( const char* argv0 )
+{
+	cerr << "Usage: " << argv0 << " [max_loops] [connections] [seconds]\n\n"
+		 << "  Runs a loopback echo server on an EventLoopGroup of 1, 2, 4, ... up to `max_loops` loops (default:\n"
+		 << "  one per CPU). As many client threads keep `connections` connections (default 64) busy with 64-byte\n"
+		 << "  round trips for `seconds` seconds (default 2), reconnecting every 100 round trips, and the\n"
+		 << "  connections accepted and round trips per second are reported for each size of group.\n";
+}
+
+constexpr size_t MESSAGE_SIZE = 64;
+constexpr size_t TRIPS_PER_CONNECTION = 100;
+
+struct EchoConnection
+{
+	TCPSocket socket;
+	string pending {};
+};
+
+// The rule categories of the loop on this thread (an EventLoop has room for only a few, so each connection can't
+// add its own)
+struct EchoCategories
+{
+	EventLoop* loop {};
+	size_t read {};
+	size_t write {};
+};
+
+// Echo everything a connection sends, until it closes
+void echo( EventLoop& loop, TCPSocket socket )
+{
+	thread_local EchoCategories categories;
+	if ( categories.loop != &loop ) {
+		categories = { &loop, loop.add_category( "echo read" ), loop.add_category( "echo write" ) };
+	}
+
+	socket.set_blocking( false );
+	auto c = make_shared<EchoConnection>( EchoConnection { std::move( socket ) } );
+	loop.add_rule(
+	  categories.read,
+	  c->socket,
+	  Direction::In,
+	  [c] {
+		  string buffer;
+		  c->socket.read( buffer );
+		  c->pending += buffer;
+		  if ( not c->pending.empty() ) {
+			  c->pending.erase( 0, c->socket.write( c->pending ) );
+		  }
+	  },
+	  [c] { return c->pending.size() < 65536; },
+	  [c] { c->socket.close(); } );
+	loop.add_rule(
+	  categories.write,
+	  c->socket,
+	  Direction::Out,
+	  [c] { c->pending.erase( 0, c->socket.write( c->pending ) ); },
+	  [c] { return not c->pending.empty(); } );
+}
+
+struct Counts
+{
+	atomic<uint64_t> accepted {};
+	atomic<uint64_t> round_trips {};
+};
+
+// Accept connections on `listener` and hand them to the group, until `stop`
+void accept_connections( TCPSocket& listener, EventLoopGroup& group, Counts& counts, const atomic<bool>& stop )
+{
+	EventLoop loop {};
+	loop.add_rule( "accept", listener, Direction::In, [&] {
+		group.assign( listener.accept() );
+		++counts.accepted;
+	} );
+	while ( not stop ) {
+		loop.wait_next_event( 10 );
+	}
+}
+
+// Keep `connections` connections busy with round trips, reconnecting each after TRIPS_PER_CONNECTION, until `stop`
+void run_client( const Address& server, const size_t connections, Counts& counts, const atomic<bool>& stop )
+{
+	const string message( MESSAGE_SIZE, 'x' );
+	vector<TCPSocket> sockets;
+	while ( not stop ) {
+		sockets.clear();
+		for ( size_t i = 0; i < connections; ++i ) {
+			sockets.emplace_back().connect( server );
+		}
+
+		for ( size_t trip = 0; trip < TRIPS_PER_CONNECTION and not stop; ++trip ) {
+			for ( auto& socket : sockets ) {
+				socket.write( message );
+			}
+			for ( auto& socket : sockets ) {
+				size_t received = 0;
+				string buffer;
+				while ( received < MESSAGE_SIZE ) {
+					socket.read( buffer );
+					if ( socket.eof() ) {
+						throw runtime_error( "the server closed a connection" );
+					}
+					received += buffer.size();
+				}
+			}
+			counts.round_trips += sockets.size();
+		}
+	}
+}
+
+// Run the benchmark with `loops` server loops; returns the round trips per second
+double benchmark( const size_t loops, const size_t connections, const double seconds, const double baseline )
+{
+	EventLoopGroup group { loops, echo };
+	TCPSocket listener;
+	listener.set_reuseaddr();
+	listener.bind( Address { "127.0.0.1", 0 } );
+	listener.listen( 1024 );
+	listener.set_blocking( false );
+	const Address server = listener.local_address();
+
+	Counts counts;
+	atomic<bool> stop = false;
+	thread acceptor { [&] { accept_connections( listener, group, counts, stop ); } };
+	vector<thread> clients;
+	for ( size_t i = 0; i < loops; ++i ) {
+		const size_t share = connections / loops + ( i < connections % loops ? 1 : 0 );
+		clients.emplace_back( [&, share] { run_client( server, max<size_t>( share, 1 ), counts, stop ); } );
+	}
+
+	const auto start_time = steady_clock::now();
+	this_thread::sleep_for( duration<double> { seconds } );
+	stop = true;
+	const double elapsed = duration_cast<duration<double>>( steady_clock::now() - start_time ).count();
+	for ( auto& client : clients ) {
+		client.join();
+	}
+	acceptor.join();
+
+	const double accepts_per_second = static_cast<double>( counts.accepted ) / elapsed;
+	const double trips_per_second = static_cast<double>( counts.round_trips ) / elapsed;
+	cout << setw( 5 ) << loops << "  " << fixed << setprecision( 0 ) << setw( 12 ) << accepts_per_second << "  "
+		 << setw( 14 ) << trips_per_second << "  " << setprecision( 2 ) << setw( 7 )
+		 << ( baseline > 0 ? trips_per_second / baseline : 1.0 ) << "x\n";
+	return trips_per_second;
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+	try {
+		if ( argc <= 0 ) {
+			abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+		}
+
+		auto args = span( argv, argc );
+		if ( argc > 4 ) {
+			show_usage( args[0] );
+			return EXIT_FAILURE;
+		}
+
+		const size_t max_loops = argc > 1 ? stoul( args[1] ) : max( thread::hardware_concurrency(), 1U );
+		const size_t connections = argc > 2 ? stoul( args[2] ) : 64;
+		const double seconds = argc > 3 ? stod( args[3] ) : 2;
+
+		cout << "loops  accepted/s    round trips/s  speedup\n";
+		double baseline = 0;
+		for ( size_t loops = 1; loops <= max_loops; loops *= 2 ) {
+			const double trips = benchmark( loops, connections, seconds, baseline );
+			if ( baseline == 0 ) {
+				baseline = trips;
+			}
+			if ( loops < max_loops and loops * 2 > max_loops ) {
+				benchmark( max_loops, connections, seconds, baseline ); // a count of CPUs that is not a power of 2
+			}
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
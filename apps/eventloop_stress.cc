@@ -0,0 +1,131 @@
+#include "eventloop.hh"
+#include "exception.hh"
+#include "socket.hh"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+void show_usage( const char* argv0 )
+{
+	cerr << "Usage: " << argv0 << " [sockets] [messages]\n\n"
+		 << "  Sends `messages` 64-byte messages over each of `sockets` Unix socket pairs (default 128 and 500),\n"
+		 << "  with every combination of EventLoop backend and dispatch mode, and reports the system calls\n"
+		 << "  the EventLoop makes (waits, plus epoll_ctl) per callback it serves.\n";
+}
+
+struct Connection
+{
+	LocalStreamSocket sender;
+	LocalStreamSocket receiver;
+	size_t sent {};
+	size_t received {};
+};
+
+void stress( const EventLoop::Backend backend,
+			 const EventLoop::Dispatch dispatch,
+			 const size_t sockets, // NOLINT(bugprone-easily-swappable-parameters)
+			 const size_t messages )
+{
+	constexpr string_view message = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+	const size_t bytes_per_connection = messages * message.size();
+
+	EventLoop loop { backend, dispatch };
+	vector<Connection> connections;
+	connections.reserve( sockets );
+	const size_t send_category = loop.add_category( "send" );
+	const size_t receive_category = loop.add_category( "receive" );
+
+	for ( size_t i = 0; i < sockets; ++i ) {
+		array<int, 2> fds {};
+		CheckSystemCall( "socketpair",
+						 ::socketpair( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0, fds.data() ) );
+		connections.push_back(
+		  { LocalStreamSocket { FileDescriptor { fds[0] } }, LocalStreamSocket { FileDescriptor { fds[1] } } } );
+		Connection& c = connections.back();
+
+		loop.add_rule(
+		  send_category,
+		  c.sender,
+		  Direction::Out,
+		  [&c, message] { c.sent += c.sender.write( message ); },
+		  [&c, bytes_per_connection] { return c.sent < bytes_per_connection; } );
+		loop.add_rule(
+		  receive_category,
+		  c.receiver,
+		  Direction::In,
+		  [&c] {
+			  string buffer;
+			  c.receiver.read( buffer );
+			  c.received += buffer.size();
+		  },
+		  [&c, bytes_per_connection] { return c.received < bytes_per_connection; } );
+	}
+
+	const auto start_time = steady_clock::now();
+	while ( loop.wait_next_event( -1 ) != EventLoop::Result::Exit ) {}
+	const auto stop_time = steady_clock::now();
+
+	for ( const Connection& c : connections ) {
+		if ( c.received != bytes_per_connection ) {
+			throw runtime_error( "a connection received " + to_string( c.received ) + " bytes, not "
+								 + to_string( bytes_per_connection ) );
+		}
+	}
+
+	const EventLoop::Statistics& stats = loop.statistics();
+	const uint64_t syscalls = stats.waits + stats.registrations;
+	const double ms = duration_cast<duration<double, milli>>( stop_time - start_time ).count();
+	const double per_callback = static_cast<double>( syscalls ) / static_cast<double>( stats.callbacks );
+	cout << ( backend == EventLoop::Backend::Epoll ? "epoll" : "poll " ) << " / "
+		 << ( dispatch == EventLoop::Dispatch::Batch ? "batch" : "one  " ) << "     " << setw( 9 )
+		 << stats.callbacks << "  " << setw( 9 ) << stats.waits << "  " << setw( 9 ) << stats.registrations << "  "
+		 << fixed << setprecision( 3 ) << setw( 9 ) << per_callback << "  " << setprecision( 1 ) << setw( 9 ) << ms
+		 << "\n";
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+	try {
+		if ( argc <= 0 ) {
+			abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+		}
+
+		auto args = span( argv, argc );
+		if ( argc > 3 ) {
+			show_usage( args[0] );
+			return EXIT_FAILURE;
+		}
+
+		const size_t sockets = argc > 1 ? stoul( args[1] ) : 128;
+		const size_t messages = argc > 2 ? stoul( args[2] ) : 500;
+
+		cout << "backend/dispatch  " << setw( 9 ) << "callbacks" << "  " << setw( 9 ) << "waits" << "  "
+			 << setw( 9 ) << "epoll_ctl" << "  " << setw( 9 ) << "syscalls/" << "  " << setw( 9 ) << "ms" << "\n"
+			 << string( 51, ' ' ) << "callback\n";
+		for ( const auto backend : { EventLoop::Backend::Poll, EventLoop::Backend::Epoll } ) {
+			for ( const auto dispatch : { EventLoop::Dispatch::One, EventLoop::Dispatch::Batch } ) {
+				stress( backend, dispatch, sockets, messages );
+			}
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
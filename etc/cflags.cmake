@@ -1,6 +1,10 @@
 set (CMAKE_CXX_STANDARD 20)
 set (CMAKE_EXPORT_COMPILE_COMMANDS ON)
 
+# trace points to compile in: a bitmask of TraceCategory values (see util/debug.hh), none by default
+set (MINNOW_TRACE "0" CACHE STRING "Bitmask of trace categories to compile in")
+add_compile_definitions (MINNOW_TRACE=${MINNOW_TRACE})
+
 set(SANITIZING_FLAGS -fno-sanitize-recover=all -fsanitize=undefined -fsanitize=address)
 
 # ask for more warnings from the compiler
@@ -23,6 +23,14 @@ ttest(byte_stream_one_write)
 ttest(byte_stream_two_writes)
 ttest(byte_stream_many_writes)
 ttest(byte_stream_stress_test)
+ttest(byte_stream_reserve)
+ttest(byte_stream_regions)
+ttest(byte_stream_mirrored)
+ttest(byte_stream_resident)
+ttest(byte_stream_pooled)
+ttest(byte_stream_resize)
+ttest(byte_stream_rope)
+ttest(byte_stream_concurrent)
 
 ttest(reassembler_single)
 ttest(reassembler_cap)
@@ -31,12 +39,19 @@ ttest(reassembler_dup)
 ttest(reassembler_holes)
 ttest(reassembler_overlapping)
 ttest(reassembler_win)
+ttest(reassembler_staging)
+ttest(reassembler_batch)
+ttest(reassembler_fragments)
+ttest(reassembler_ranges)
+ttest(reassembler_resize)
 
 ttest(wrapping_integers_cmp)
 ttest(wrapping_integers_wrap)
 ttest(wrapping_integers_unwrap)
 ttest(wrapping_integers_roundtrip)
 ttest(wrapping_integers_extra)
+ttest(wrapping_integers_unwrap_many)
+ttest(wrapping_integers_constexpr)
 
 ttest(recv_connect)
 ttest(recv_transmit)
@@ -45,6 +60,11 @@ ttest(recv_reorder)
 ttest(recv_reorder_more)
 ttest(recv_close)
 ttest(recv_special)
+ttest(recv_batch)
+ttest(recv_sack)
+ttest(recv_window_scale)
+ttest(recv_delayed_ack)
+ttest(recv_autotune)
 
 ttest(send_connect)
 ttest(send_transmit)
@@ -58,6 +78,15 @@ ttest(net_interface)
 
 ttest(router)
 
+ttest(debug_trace)
+ttest(debug_trace_enabled)
+ttest(eventloop_backends)
+ttest(timer_wheel)
+ttest(eventloop_timers)
+ttest(slot_map)
+ttest(inplace_function)
+ttest(eventloop_group)
+
 ttest(no_skip)
 
 add_custom_target (check0 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --stop-on-failure --timeout 15 -R 'webget|^byte_stream_|^no_skip')
@@ -91,4 +120,15 @@ set_property(TEST ${compile_name_opt} PROPERTY TIMEOUT 0)
 set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
+stest(byte_stream_concurrent_speed_test)
+stest(byte_stream_idle_speed_test)
+stest(byte_stream_churn_speed_test)
 stest(reassembler_speed_test)
+stest(reassembler_memory_speed_test)
+stest(recv_sack_speed_test)
+stest(recv_window_scale_speed_test)
+stest(recv_ack_speed_test)
+stest(wrapping_integers_speed_test)
+stest(eventloop_speed_test)
+stest(timer_wheel_speed_test)
+stest(eventloop_rules_speed_test)
@@ -0,0 +1,61 @@
+#include "buffer_pool.hh"
+
+#include <bit>
+#include <stdexcept>
+
+using namespace std;
+
+BufferPool::~BufferPool()
+{
+	for ( auto& free_list : free_lists_ ) {
+		for ( char* slab : free_list ) {
+			delete[] slab; // NOLINT(*-owning-memory)
+		}
+	}
+}
+
+const shared_ptr<BufferPool>& BufferPool::this_thread()
+{
+	thread_local const shared_ptr<BufferPool> pool = make_shared<BufferPool>();
+	return pool;
+}
+
+/**
+ * @brief Hand out a slab, preferring one from the free list of its size class.
+ * @param size The slab size, a power of two.
+ * @return A slab of `size` bytes (its contents are unspecified).
+ */
+char* BufferPool::acquire( uint64_t size )
+{
+	if ( not has_single_bit( size ) ) {
+		throw runtime_error( "BufferPool::acquire() size must be a power of two" );
+	}
+
+	auto& free_list = free_lists_.at( countr_zero( size ) );
+	if ( free_list.empty() ) {
+		++slabs_allocated_;
+		return new char[size]; // NOLINT(*-owning-memory)
+	}
+
+	char* const slab = free_list.back();
+	free_list.pop_back();
+	idle_bytes_ -= size;
+	++slabs_reused_;
+	return slab;
+}
+
+/**
+ * @brief Take back a slab, keeping it for reuse unless the pool is already holding enough idle memory.
+ * @param slab A slab returned by acquire( size ).
+ * @param size The size it was acquired with.
+ */
+void BufferPool::release( char* slab, uint64_t size )
+{
+	if ( idle_bytes_ + size > max_idle_bytes_ ) {
+		delete[] slab; // NOLINT(*-owning-memory)
+		return;
+	}
+
+	free_lists_.at( countr_zero( size ) ).push_back( slab );
+	idle_bytes_ += size;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * A cache of buffers for ByteStreams (and anything else that wants power-of-two sized blocks).
+ *
+ * Each size class has its own free list of slabs. acquire() reuses a slab from the list when it can
+ * and only falls back to operator new when the list is empty; release() puts the slab back, unless
+ * the pool already holds `max_idle_bytes` of unused slabs. So a workload that keeps opening and
+ * closing connections stops allocating once the pool has warmed up.
+ *
+ * A BufferPool is not thread-safe: every slab must be acquired and released on the thread that
+ * owns the pool. BufferPool::this_thread() gives each thread a pool of its own.
+ */
+class BufferPool
+{
+  public:
+	static constexpr uint64_t kDefaultMaxIdleBytes = uint64_t { 64 } << 20;
+
+	explicit BufferPool( uint64_t max_idle_bytes = kDefaultMaxIdleBytes ) : max_idle_bytes_( max_idle_bytes ) {}
+	~BufferPool();
+
+	BufferPool( const BufferPool& other ) = delete;
+	BufferPool& operator=( const BufferPool& other ) = delete;
+	BufferPool( BufferPool&& other ) = delete;
+	BufferPool& operator=( BufferPool&& other ) = delete;
+
+	// The calling thread's pool (created on first use)
+	static const std::shared_ptr<BufferPool>& this_thread();
+
+	char* acquire( uint64_t size );			   // A slab of `size` bytes, which must be a power of two
+	void release( char* slab, uint64_t size ); // Return a slab from acquire( size ) to the pool
+
+	uint64_t slabs_allocated() const { return slabs_allocated_; } // Times acquire() had to call operator new
+	uint64_t slabs_reused() const { return slabs_reused_; }		  // Times acquire() found a free slab
+	uint64_t idle_bytes() const { return idle_bytes_; }			  // Bytes of free slabs held by the pool
+
+  private:
+	uint64_t max_idle_bytes_;
+	uint64_t idle_bytes_ {};
+	uint64_t slabs_allocated_ {};
+	uint64_t slabs_reused_ {};
+
+	std::array<std::vector<char*>, 64> free_lists_ {}; // Indexed by log2 of the slab size
+};
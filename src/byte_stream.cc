@@ -1,44 +1,252 @@
 #include "byte_stream.hh"
 #include <algorithm>
+#include <bit>
+#include <climits>
 #include <cstdint>
 #include <cstring>
+#include <stdexcept>
 #include <sys/types.h>
 
 using namespace std;
 
-ByteStream::ByteStream( uint64_t capacity ) : capacity_( capacity ), buffer_( capacity ) {}
+ByteStream::ByteStream( uint64_t capacity ) : ByteStream( capacity, Storage::Ring ) {}
+
+ByteStream::ByteStream( uint64_t capacity, Storage storage )
+  : capacity_( capacity )
+  , storage_( storage )
+  , buffer_( storage == Storage::MirroredRing ? RingBuffer::Kind::Mirrored : RingBuffer::Kind::Heap )
+{}
+
+ByteStream::ByteStream( uint64_t capacity, shared_ptr<BufferPool> pool )
+  : capacity_( capacity ), storage_( Storage::Ring ), buffer_( move( pool ) )
+{}
+
+uint64_t ByteStream::resident_capacity() const
+{
+	if ( storage_ == Storage::Rope ) {
+		return bytes_pushed_ - bytes_popped_ + chunk_offset_ + staging_.size();
+	}
+	return buffer_.size();
+}
+
+/**
+ * @brief Change how many bytes the stream may buffer.
+ *
+ * The buffered bytes stay where they are: the ring is sized for the capacity only as it grows, so
+ * a larger capacity just raises the limit on that growth, and a smaller one is clamped to what is
+ * buffered (and reserved) now.
+ *
+ * @param capacity The new capacity
+ */
+void ByteStream::set_capacity( uint64_t capacity )
+{
+	capacity_ = std::max( capacity, bytes_pushed_ - bytes_popped_ + reserved_ );
+}
+
+/**
+ * @brief Make sure the ring can hold `len` bytes, growing it if necessary.
+ *
+ * The ring at least doubles each time it grows (starting from kMinBufferSize),
+ * so a stream that fills up pays for O(log capacity) reallocations. Each one moves the buffered bytes,
+ * so it ends any views the Reader has peeked at.
+ *
+ * @param len The number of bytes (buffered plus about to be written) the ring must hold.
+ */
+void ByteStream::grow_buffer( uint64_t len )
+{
+	if ( len <= buffer_.size() ) {
+		return;
+	}
+
+	const uint64_t new_size
+	  = std::min( std::max( { len, 2 * buffer_.size(), kMinBufferSize } ), bit_ceil( capacity_ ) );
+	buffer_.resize( new_size, bytes_popped_, bytes_pushed_ );
+}
+
+/**
+ * @brief Release or shrink the buffer of an idle stream.
+ *
+ * An empty stream frees its buffer entirely (it will be allocated again by the next push);
+ * otherwise the buffer shrinks to the smallest size that holds what is buffered.
+ */
+void ByteStream::shrink_to_fit()
+{
+	reserved_ = 0;
+
+	if ( storage_ == Storage::Rope ) {
+		staging_ = {};
+		chunks_.erase( chunks_.begin(), chunks_.begin() + static_cast<ptrdiff_t>( first_chunk_ ) );
+		chunks_.shrink_to_fit();
+		first_chunk_ = 0;
+		return;
+	}
+
+	const uint64_t buffered = bytes_pushed_ - bytes_popped_;
+	const uint64_t new_size = buffered == 0 ? 0 : std::max( bit_ceil( buffered ), kMinBufferSize );
+	if ( new_size < buffer_.size() ) {
+		buffer_.resize( new_size, bytes_popped_, bytes_pushed_ );
+	}
+}
+
+/**
+ * @brief Append a small write to the last chunk of a Rope instead of starting a new chunk.
+ *
+ * This keeps a stream of tiny pushes from turning into a list of tiny strings: bytes are copied
+ * onto the last chunk as long as it stays within kMinBufferSize. The chunk may be reallocated, which ends any
+ * views the Reader has peeked at.
+ *
+ * @param data The bytes to append.
+ * @return Whether they were appended (if not, the caller should add a new chunk).
+ */
+bool ByteStream::append_to_last_chunk( string_view data )
+{
+	if ( chunks_.empty() or chunks_.back()->size() + data.size() > kMinBufferSize ) {
+		return false;
+	}
+
+	chunks_.back()->append( data );
+	return true;
+}
 
 /**
  * @brief Push data into the stream.
  *
- * This function writes the provided data into the ByteStream. If the data size
- * exceeds the available capacity, it will split the data into two parts:
- * - One part will be written starting from the current `tail_` position.
+ * This function writes the provided data into the ByteStream. If the data
+ * crosses the end of the ring, it will split the data into two parts:
+ * - One part will be written starting at position `bytes_pushed_`.
  * - The other part will be written at the beginning of the buffer if necessary.
- *
- * The `tail_` pointer is updated after the data is written.
+ * A mirrored ring never needs the second part. A Rope copies the data into a chunk of its own.
  *
  * @param data The data to be written into the ByteStream.
  */
-void Writer::push( string data )
+void Writer::push( string_view data )
 {
+	reserved_ = 0;
+
 	uint64_t size_of_write = std::min( data.size(), Writer::available_capacity() );
+	if ( size_of_write == 0 ) {
+		return;
+	}
+
+	if ( storage_ == Storage::Rope ) {
+		data = data.substr( 0, size_of_write );
+		if ( not append_to_last_chunk( data ) ) {
+			chunks_.emplace_back( string { data } );
+		}
+		bytes_pushed_ += size_of_write;
+		return;
+	}
+
+	grow_buffer( bytes_pushed_ - bytes_popped_ + size_of_write );
 
-	// Split the data into two segments if it exceeds the available capacity
-	uint64_t first_segment_size = std::min( size_of_write, capacity_ - tail_ );
-	std::memcpy( buffer_.data() + tail_, data.data(), first_segment_size );
+	// Split the data into two segments if it crosses the end of the ring
+	const span<char> first_segment = buffer_.region( bytes_pushed_, size_of_write );
+	std::memcpy( first_segment.data(), data.data(), first_segment.size() );
 
-	// If the data exceeds the available capacity, copy the remaining data to the beginning of the buffer
-	if ( size_of_write > first_segment_size ) {
-		uint64_t second_segment_size = size_of_write - first_segment_size;
-		std::memcpy( buffer_.data(), data.data() + first_segment_size, second_segment_size );
+	// If the data crosses the end of the ring, copy the remaining data to the beginning of the buffer
+	if ( size_of_write > first_segment.size() ) {
+		uint64_t second_segment_size = size_of_write - first_segment.size();
+		std::memcpy( buffer_.data(), data.data() + first_segment.size(), second_segment_size );
 	}
 
-	tail_ = ( tail_ + size_of_write ) % capacity_;
-	size_ += size_of_write;
 	bytes_pushed_ += size_of_write;
 }
 
+/**
+ * @brief Push an owned string into the stream.
+ *
+ * A Rope keeps the string itself as a chunk (truncated to the available capacity), so pushing
+ * costs O(1) no matter how long it is. Other storage copies it into the ring.
+ *
+ * @param data The data to be written into the ByteStream.
+ */
+void Writer::push( string&& data )
+{
+	if ( storage_ != Storage::Rope ) {
+		push( string_view { data } );
+		return;
+	}
+
+	reserved_ = 0;
+
+	data.resize( std::min( data.size(), Writer::available_capacity() ) );
+	if ( data.empty() ) {
+		return;
+	}
+
+	bytes_pushed_ += data.size();
+	if ( not append_to_last_chunk( data ) ) {
+		chunks_.emplace_back( move( data ) );
+	}
+}
+
+void Writer::push( const vector<Ref<string>>& buffers )
+{
+	for ( const auto& buffer : buffers ) {
+		if ( available_capacity() == 0 ) {
+			break;
+		}
+		push( string_view { buffer.get() } );
+	}
+}
+
+/**
+ * @brief Reserve writable space in the stream's buffer.
+ *
+ * The free part of the ring starts at position `bytes_pushed_` and may wrap around the end of
+ * the buffer, so up to two regions are returned (only one for a mirrored ring). Their total
+ * size is min( len, available_capacity() ). A Rope hands out a single staging string instead,
+ * which becomes a chunk when committed.
+ *
+ * @param len The number of bytes the caller would like to write.
+ * @return The writable regions, in stream order.
+ */
+vector<span<char>> Writer::reserve( uint64_t len )
+{
+	reserved_ = std::min( len, available_capacity() );
+
+	vector<span<char>> regions;
+	if ( reserved_ == 0 ) {
+		return regions;
+	}
+
+	if ( storage_ == Storage::Rope ) {
+		staging_.resize( reserved_ );
+		regions.emplace_back( staging_.data(), reserved_ );
+		return regions;
+	}
+
+	grow_buffer( bytes_pushed_ - bytes_popped_ + reserved_ );
+
+	regions.push_back( buffer_.region( bytes_pushed_, reserved_ ) );
+	if ( reserved_ > regions.front().size() ) {
+		regions.emplace_back( buffer_.data(), reserved_ - regions.front().size() );
+	}
+	return regions;
+}
+
+/**
+ * @brief Commit bytes that were written into the regions returned by reserve().
+ * @param len The number of bytes written, which must not exceed the reserved amount.
+ */
+void Writer::commit( uint64_t len )
+{
+	if ( len > reserved_ ) {
+		throw runtime_error( "Writer::commit() called with more bytes than were reserved" );
+	}
+
+	if ( storage_ == Storage::Rope and len > 0 ) {
+		staging_.resize( len );
+		if ( not append_to_last_chunk( staging_ ) ) {
+			chunks_.emplace_back( move( staging_ ) );
+		}
+		staging_.clear();
+	}
+
+	bytes_pushed_ += len;
+	reserved_ = 0;
+}
+
 void Writer::close()
 {
 	is_closed_ = true;
@@ -51,7 +259,7 @@ bool Writer::is_closed() const
 
 uint64_t Writer::available_capacity() const
 {
-	return capacity_ - size_;
+	return capacity_ - ( bytes_pushed_ - bytes_popped_ );
 }
 
 uint64_t Writer::bytes_pushed() const
@@ -63,47 +271,98 @@ uint64_t Writer::bytes_pushed() const
  * @brief Peek at the data in the Reader without removing it.
  *
  * This function allows the user to view (but not modify) the data in the
- * stream starting from the `head_` position. The size of the peeked data
- * is limited by either the available data size or the remaining capacity in the buffer.
+ * stream starting at position `bytes_popped_`. The size of the peeked data
+ * is limited by either the available data size or the end of the ring
+ * (for a mirrored ring, it is always everything buffered; for a Rope, it is the rest of the front chunk).
  *
- * @return A string_view of the data starting from the `head_` position.
+ * @return A string_view of the data starting at position `bytes_popped_`.
  */
 string_view Reader::peek() const
 {
-	if ( size_ == 0 ) {
-		return string_view();
+	if ( storage_ == Storage::Rope ) {
+		if ( chunks_.empty() ) {
+			return {};
+		}
+		return string_view { chunks_[first_chunk_].get() }.substr( chunk_offset_ );
 	}
+	return buffer_.region( bytes_popped_, bytes_buffered() );
+}
 
-	uint64_t peek_size = std::min( size_, capacity_ - head_ );
-	return string_view( buffer_.data() + head_, peek_size );
+/**
+ * @brief Peek at all of the buffered data without removing it.
+ *
+ * When the buffered bytes wrap around the end of the ring, they are returned as two
+ * regions: the one starting at `bytes_popped_`, followed by the one at the start of the buffer.
+ * A Rope returns each of its chunks, but no more than IOV_MAX of them, so that the list can always
+ * be passed to writev(); the caller pops what was written and peeks again for the rest.
+ *
+ * @return The regions holding the buffered data, in stream order (empty if nothing is buffered).
+ */
+vector<string_view> Reader::peek_regions() const
+{
+	vector<string_view> regions;
+	const uint64_t size = bytes_buffered();
+	if ( size == 0 ) {
+		return regions;
+	}
+
+	if ( storage_ == Storage::Rope ) {
+		const size_t end = std::min( chunks_.size(), first_chunk_ + IOV_MAX );
+		for ( size_t i = first_chunk_; i < end; ++i ) {
+			regions.emplace_back( chunks_[i].get() );
+		}
+		regions.front().remove_prefix( chunk_offset_ );
+		return regions;
+	}
+
+	regions.push_back( buffer_.region( bytes_popped_, size ) );
+	if ( size > regions.front().size() ) {
+		regions.emplace_back( buffer_.data(), size - regions.front().size() );
+	}
+	return regions;
 }
 
 /**
  * @brief Pop (remove) data from the Reader.
  *
- * This function removes up to `len` bytes from the stream starting from
- * the current `head_` position. The `head_` pointer is updated accordingly,
- * and the size of the stream is reduced.
+ * This function removes up to `len` bytes from the stream starting at
+ * position `bytes_popped_`, which is advanced accordingly. A Rope frees the chunks
+ * that have been popped completely.
  *
  * @param len The number of bytes to be removed from the stream.
  */
 void Reader::pop( uint64_t len )
 {
-	uint64_t pop_len = std::min( len, size_ );
+	len = std::min( len, bytes_buffered() );
+	bytes_popped_ += len;
+
+	if ( storage_ == Storage::Rope ) {
+		len += chunk_offset_;
+		while ( first_chunk_ < chunks_.size() and len >= chunks_[first_chunk_]->size() ) {
+			len -= chunks_[first_chunk_]->size();
+			chunks_[first_chunk_++] = {};
+		}
+		chunk_offset_ = len;
 
-	head_ = ( head_ + pop_len ) % capacity_;
-	size_ -= pop_len;
-	bytes_popped_ += pop_len;
+		// Reclaim the slots of popped chunks once the stream is empty, or once they are most of the vector
+		if ( first_chunk_ == chunks_.size() ) {
+			chunks_.clear();
+			first_chunk_ = 0;
+		} else if ( first_chunk_ >= kMinPoppedChunks and 2 * first_chunk_ >= chunks_.size() ) {
+			chunks_.erase( chunks_.begin(), chunks_.begin() + static_cast<ptrdiff_t>( first_chunk_ ) );
+			first_chunk_ = 0;
+		}
+	}
 }
 
 bool Reader::is_finished() const
 {
-	return is_closed_ && size_ == 0;
+	return is_closed_ && bytes_buffered() == 0;
 }
 
 uint64_t Reader::bytes_buffered() const
 {
-	return size_;
+	return bytes_pushed_ - bytes_popped_;
 }
 
 uint64_t Reader::bytes_popped() const
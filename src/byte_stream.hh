@@ -1,6 +1,12 @@
 #pragma once
 
+#include "buffer_pool.hh"
+#include "ref.hh"
+#include "ring_buffer.hh"
+
 #include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
 #include <string_view>
 #include <sys/types.h>
@@ -12,7 +18,20 @@ class Writer;
 class ByteStream
 {
   public:
+	// Where the buffered bytes are kept
+	enum class Storage : uint8_t
+	{
+		Ring,		  // A ring buffer on the heap (the default)
+		MirroredRing, // A ring mapped twice in a row, so peek() always returns everything buffered
+		Rope,		  // The pushed strings themselves, kept in a list, so push( std::string&& ) never copies
+	};
+
 	explicit ByteStream( uint64_t capacity );
+	ByteStream( uint64_t capacity, Storage storage );
+
+	// A Ring whose buffer comes from `pool` (e.g. BufferPool::this_thread()), and goes back to it when freed.
+	// The stream must then be used, and destroyed, on the pool's thread.
+	ByteStream( uint64_t capacity, std::shared_ptr<BufferPool> pool );
 
 	// Helper functions (provided) to access the ByteStream's Reader and Writer interfaces
 	Reader& reader();
@@ -23,27 +42,71 @@ class ByteStream
 	void set_error() { error_ = true; };	   // Signal that the stream suffered an error.
 	bool has_error() const { return error_; }; // Has the stream had an error?
 
+	uint64_t capacity() const { return capacity_; } // Most bytes the stream will ever buffer
+	uint64_t resident_capacity() const;				// Bytes of memory allocated for the buffer now
+
+	// Change the capacity, keeping everything buffered (so it never drops below what is buffered and reserved).
+	// A larger capacity lets the buffer grow further; a smaller one does not free memory (see shrink_to_fit).
+	void set_capacity( uint64_t capacity );
+
+	// Free the buffer if nothing is buffered, or shrink it to fit what is (cancelling any reservation).
+	// The buffer is allocated on first use and grows as needed, but it never shrinks on its own:
+	// the owner decides when a stream has been idle long enough for this to be worthwhile.
+	void shrink_to_fit();
+
   protected:
+	static constexpr uint64_t kMinBufferSize = 4096; // Smallest buffer allocated once the stream is in use
+	static constexpr size_t kMinPoppedChunks = 64;	 // Popped Rope chunks worth compacting away
+
 	uint64_t capacity_;
+	Storage storage_;
 	bool is_closed_ {};
 	bool error_ {};
 
 	uint64_t bytes_pushed_ {};
 	uint64_t bytes_popped_ {};
-	uint64_t bytes_buffered_ {};
+	uint64_t reserved_ {}; // Bytes handed out by the last Writer::reserve() and not yet committed
 
-	std::vector<char> buffer_ {};
+	// The buffered bytes sit at positions [bytes_popped_, bytes_pushed_) of a ring whose size is a power of
+	// two, so positions wrap with `& mask()` rather than `% capacity_`. The ring grows from nothing, by at least
+	// doubling, up to the smallest power of two that holds `capacity_` bytes.
+	RingBuffer buffer_;
 
-	uint64_t head_ {};
-	uint64_t tail_ {};
-	uint64_t size_ {};
+	// With Storage::Rope, the buffered bytes are instead the chunks from `first_chunk_` on, less the first
+	// `chunk_offset_` bytes of the front chunk (which were already popped). A reservation is filled in `staging_`.
+	// (A vector used as a queue, unlike a std::deque, costs nothing while the stream is empty.)
+	std::vector<Ref<std::string>> chunks_ {};
+	size_t first_chunk_ {};
+	uint64_t chunk_offset_ {};
+	std::string staging_ {};
+
+	void grow_buffer( uint64_t len ); // Make sure the ring can hold `len` bytes
+	bool append_to_last_chunk( std::string_view data ); // Copy a small write onto the end of a Rope's last chunk
 };
 
 class Writer : public ByteStream
 {
   public:
-	void push( std::string data ); // Push data to stream, but only as much as available capacity allows.
-	void close();				   // Signal that the stream has reached its ending. Nothing more will be written.
+	void push( std::string&& data );	// Push data to stream, but only as much as available capacity allows.
+	void push( std::string_view data ); // Same, but copy straight from a borrowed view of the caller's bytes.
+	void push( const char* data ) { push( std::string_view { data } ); }
+
+	template<std::size_t Extent>
+	void push( std::span<const char, Extent> data )
+	{
+		push( std::string_view { data.data(), data.size() } );
+	}
+
+	// Push a list of buffers in order (e.g. the output of Serializer::finish()), stopping when the stream is full.
+	void push( const std::vector<Ref<std::string>>& buffers );
+
+	// Hand out the free regions of the stream's own buffer for up to `len` bytes (never more than
+	// available_capacity()), so that a producer such as read(2) can fill them in place. The bytes
+	// become visible to the Reader only once commit() is called; any other push cancels the reservation.
+	std::vector<std::span<char>> reserve( uint64_t len );
+	void commit( uint64_t len ); // Publish the first `len` bytes written into the regions from reserve()
+
+	void close(); // Signal that the stream has reached its ending. Nothing more will be written.
 
 	bool is_closed() const;				 // Has the stream been closed?
 	uint64_t available_capacity() const; // How many bytes can be pushed to the stream right now?
@@ -53,9 +116,17 @@ class Writer : public ByteStream
 class Reader : public ByteStream
 {
   public:
+	// peek() and peek_regions() return views of the stream's buffer. They end with pop(), and with anything that
+	// moves the buffered bytes: a push() or reserve() that grows the ring (raising resident_capacity()), or
+	// shrink_to_fit(). Other writes leave them valid, except with a Rope: its push() and commit() may append to the
+	// last chunk, or move short chunks as the list of chunks grows. Peek again after any of these.
 	std::string_view peek() const; // Peek at the next bytes in the buffer
 	void pop( uint64_t len );	   // Remove `len` bytes from the buffer
 
+	// Peek at everything buffered, as the list of contiguous regions (in order) that hold it
+	// (e.g. to drain the stream with a single FileDescriptor::write). A Rope gives at most IOV_MAX of its chunks.
+	std::vector<std::string_view> peek_regions() const;
+
 	bool is_finished() const;		 // Is the stream finished (closed and fully popped)?
 	uint64_t bytes_buffered() const; // Number of bytes currently buffered (pushed and not popped)
 	uint64_t bytes_popped() const;	 // Total number of bytes cumulatively popped from stream
@@ -1,15 +1,16 @@
 #include "byte_stream.hh"
+#include "concurrent_byte_stream.hh"
 
 #include <cstdint>
 #include <stdexcept>
 
 using namespace std;
 
-/*
- * read: A helper function thats peeks and pops up to `max_len` bytes
- * from a ByteStream Reader into a string;
- */
-void read( Reader& reader, uint64_t max_len, string& out )
+namespace {
+
+// Peek and pop through any reader with the Reader interface (a ByteStream's or a ConcurrentByteStream's)
+template<class ReaderT>
+void read_from( ReaderT& reader, uint64_t max_len, string& out )
 {
 	out.clear();
 
@@ -26,6 +27,22 @@ void read( Reader& reader, uint64_t max_len, string& out )
 	}
 }
 
+} // namespace
+
+/*
+ * read: A helper function thats peeks and pops up to `max_len` bytes
+ * from a ByteStream Reader into a string;
+ */
+void read( Reader& reader, uint64_t max_len, string& out )
+{
+	read_from( reader, max_len, out );
+}
+
+void read( ConcurrentReader& reader, uint64_t max_len, string& out )
+{
+	read_from( reader, max_len, out );
+}
+
 Reader& ByteStream::reader()
 {
 	static_assert( sizeof( Reader ) == sizeof( ByteStream ),
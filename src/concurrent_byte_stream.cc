@@ -0,0 +1,161 @@
+#include "concurrent_byte_stream.hh"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+ConcurrentByteStream::ConcurrentByteStream( uint64_t capacity )
+  : capacity_( capacity ), buffer_( make_unique<char[]>( capacity ) )
+{}
+
+/**
+ * @brief Push data into the stream (producer thread only).
+ *
+ * The Reader's position is only re-read when the cached copy says there is not enough room.
+ * The bytes are copied in (in up to two pieces, if they wrap around the end of the ring)
+ * before the new `bytes_pushed_` is published with a release store.
+ *
+ * @param data The data to be written into the stream.
+ */
+void ConcurrentWriter::push( string_view data )
+{
+	const uint64_t pushed = bytes_pushed_.load( memory_order_relaxed );
+	if ( capacity_ - ( pushed - popped_seen_by_writer_ ) < data.size() ) {
+		popped_seen_by_writer_ = bytes_popped_.load( memory_order_acquire );
+	}
+
+	const uint64_t size_of_write = std::min( data.size(), capacity_ - ( pushed - popped_seen_by_writer_ ) );
+	if ( size_of_write == 0 ) {
+		return;
+	}
+
+	const uint64_t tail = pushed % capacity_;
+	const uint64_t first_segment_size = std::min( size_of_write, capacity_ - tail );
+	std::memcpy( buffer_.get() + tail, data.data(), first_segment_size );
+	std::memcpy( buffer_.get(), data.data() + first_segment_size, size_of_write - first_segment_size );
+
+	bytes_pushed_.store( pushed + size_of_write, memory_order_release );
+}
+
+void ConcurrentWriter::close()
+{
+	is_closed_.store( true, memory_order_release );
+}
+
+bool ConcurrentWriter::is_closed() const
+{
+	return is_closed_.load( memory_order_relaxed );
+}
+
+uint64_t ConcurrentWriter::available_capacity() const
+{
+	popped_seen_by_writer_ = bytes_popped_.load( memory_order_acquire );
+	return capacity_ - ( bytes_pushed_.load( memory_order_relaxed ) - popped_seen_by_writer_ );
+}
+
+uint64_t ConcurrentWriter::bytes_pushed() const
+{
+	return bytes_pushed_.load( memory_order_relaxed );
+}
+
+/**
+ * @brief Peek at the next bytes in the stream (consumer thread only).
+ *
+ * The Writer's position is only re-read when everything the Reader last saw has been popped.
+ *
+ * @return A string_view of the contiguous data starting at the Reader's position.
+ */
+string_view ConcurrentReader::peek() const
+{
+	const uint64_t popped = bytes_popped_.load( memory_order_relaxed );
+	if ( pushed_seen_by_reader_ == popped ) {
+		pushed_seen_by_reader_ = bytes_pushed_.load( memory_order_acquire );
+		if ( pushed_seen_by_reader_ == popped ) {
+			return {}; // (also keeps a stream of capacity 0 from dividing by zero)
+		}
+	}
+
+	const uint64_t head = popped % capacity_;
+	return { buffer_.get() + head, std::min( pushed_seen_by_reader_ - popped, capacity_ - head ) };
+}
+
+vector<string_view> ConcurrentReader::peek_regions() const
+{
+	const uint64_t popped = bytes_popped_.load( memory_order_relaxed );
+	const uint64_t size = bytes_buffered();
+
+	vector<string_view> regions;
+	if ( size == 0 ) {
+		return regions;
+	}
+
+	const uint64_t head = popped % capacity_;
+	const uint64_t first_segment_size = std::min( size, capacity_ - head );
+	regions.emplace_back( buffer_.get() + head, first_segment_size );
+	if ( size > first_segment_size ) {
+		regions.emplace_back( buffer_.get(), size - first_segment_size );
+	}
+	return regions;
+}
+
+/**
+ * @brief Pop data from the stream (consumer thread only).
+ *
+ * The new `bytes_popped_` is published with a release store, which tells the Writer that
+ * the Reader is done with those bytes and they may be overwritten.
+ *
+ * @param len The number of bytes to be removed from the stream.
+ */
+void ConcurrentReader::pop( uint64_t len )
+{
+	const uint64_t popped = bytes_popped_.load( memory_order_relaxed );
+	if ( pushed_seen_by_reader_ - popped < len ) {
+		pushed_seen_by_reader_ = bytes_pushed_.load( memory_order_acquire );
+	}
+
+	bytes_popped_.store( popped + std::min( len, pushed_seen_by_reader_ - popped ), memory_order_release );
+}
+
+bool ConcurrentReader::is_finished() const
+{
+	// Load the closed flag first: once it is seen, the Writer's final position is visible too.
+	return is_closed_.load( memory_order_acquire ) and bytes_buffered() == 0;
+}
+
+uint64_t ConcurrentReader::bytes_buffered() const
+{
+	pushed_seen_by_reader_ = bytes_pushed_.load( memory_order_acquire );
+	return pushed_seen_by_reader_ - bytes_popped_.load( memory_order_relaxed );
+}
+
+uint64_t ConcurrentReader::bytes_popped() const
+{
+	return bytes_popped_.load( memory_order_relaxed );
+}
+
+ConcurrentReader& ConcurrentByteStream::reader()
+{
+	static_assert( sizeof( ConcurrentReader ) == sizeof( ConcurrentByteStream ),
+				   "Please add member variables to the ConcurrentByteStream base, not the Reader." );
+
+	return static_cast<ConcurrentReader&>( *this ); // NOLINT(*-downcast)
+}
+
+const ConcurrentReader& ConcurrentByteStream::reader() const
+{
+	return static_cast<const ConcurrentReader&>( *this ); // NOLINT(*-downcast)
+}
+
+ConcurrentWriter& ConcurrentByteStream::writer()
+{
+	static_assert( sizeof( ConcurrentWriter ) == sizeof( ConcurrentByteStream ),
+				   "Please add member variables to the ConcurrentByteStream base, not the Writer." );
+
+	return static_cast<ConcurrentWriter&>( *this ); // NOLINT(*-downcast)
+}
+
+const ConcurrentWriter& ConcurrentByteStream::writer() const
+{
+	return static_cast<const ConcurrentWriter&>( *this ); // NOLINT(*-downcast)
+}
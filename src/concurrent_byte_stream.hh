@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ConcurrentReader;
+class ConcurrentWriter;
+
+/*
+ * A ByteStream that one thread can write while another thread reads it, without a lock.
+ *
+ * The Writer interface may only be used by a single producer thread, and the Reader interface
+ * by a single consumer thread. Each side publishes its position with a release store and reads
+ * the other side's position with an acquire load, so the bytes written before a push() are
+ * visible to the Reader that observes it. The two positions live on separate cache lines, and
+ * each side caches the last position it saw from the other, so the line is only transferred
+ * when the cached value no longer says there is room (or data).
+ */
+class ConcurrentByteStream
+{
+  public:
+	explicit ConcurrentByteStream( uint64_t capacity );
+
+	// Helper functions to access the ConcurrentByteStream's Reader and Writer interfaces
+	ConcurrentReader& reader();
+	const ConcurrentReader& reader() const;
+	ConcurrentWriter& writer();
+	const ConcurrentWriter& writer() const;
+
+	// Signal that the stream suffered an error.
+	void set_error() { error_.store( true, std::memory_order_release ); }
+
+	// Has the stream had an error?
+	bool has_error() const { return error_.load( std::memory_order_acquire ); }
+
+  protected:
+	static constexpr size_t kCacheLineSize = 64;
+
+	// Fixed at construction
+	uint64_t capacity_;
+	std::unique_ptr<char[]> buffer_;
+
+	// Either side may set the error flag
+	std::atomic<bool> error_ {};
+
+	// Producer side: written only by the Writer
+	alignas( kCacheLineSize ) std::atomic<uint64_t> bytes_pushed_ {};
+	std::atomic<bool> is_closed_ {};
+	mutable uint64_t popped_seen_by_writer_ {};
+
+	// Consumer side: written only by the Reader
+	alignas( kCacheLineSize ) std::atomic<uint64_t> bytes_popped_ {};
+	mutable uint64_t pushed_seen_by_reader_ {};
+};
+
+class ConcurrentWriter : public ConcurrentByteStream
+{
+  public:
+	void push( std::string_view data ); // Push data to stream, but only as much as available capacity allows.
+	void push( std::string&& data ) { push( std::string_view { data } ); }
+	void push( const char* data ) { push( std::string_view { data } ); }
+	void close(); // Signal that the stream has reached its ending. Nothing more will be written.
+
+	bool is_closed() const;				 // Has the stream been closed?
+	uint64_t available_capacity() const; // How many bytes can be pushed to the stream right now?
+	uint64_t bytes_pushed() const;		 // Total number of bytes cumulatively pushed to the stream
+};
+
+class ConcurrentReader : public ConcurrentByteStream
+{
+  public:
+	std::string_view peek() const;						// Peek at the next bytes in the buffer
+	std::vector<std::string_view> peek_regions() const; // Peek at everything buffered, as contiguous regions
+	void pop( uint64_t len );							// Remove `len` bytes from the buffer
+
+	bool is_finished() const;		 // Is the stream finished (closed and fully popped)?
+	uint64_t bytes_buffered() const; // Number of bytes currently buffered (pushed and not popped)
+	uint64_t bytes_popped() const;	 // Total number of bytes cumulatively popped from stream
+};
+
+/*
+ * read: The same helper as for a ByteStream Reader: peeks and pops up to `max_len` bytes
+ * from a ConcurrentByteStream Reader into a string (on the consumer thread).
+ */
+void read( ConcurrentReader& reader, uint64_t max_len, std::string& out );
@@ -2,27 +2,42 @@
 #include "debug.hh"
 #include <algorithm>
 #include <cstdint>
-#include <iterator>
 #include <string>
 #include <sys/types.h>
 #include <utility>
+#include <variant>
+#include <vector>
 
 using namespace std;
 
+Reassembler::Reassembler( ByteStream&& output, Storage storage )
+  : output_( std::move( output ) )
+  , buffered_data_( storage == Storage::StagingRing
+					  ? decltype( buffered_data_ ) { in_place_type<StagingRing>, output_.capacity() }
+					  : decltype( buffered_data_ ) { in_place_type<SegmentStore> } )
+{}
+
 /**
  * @brief Insert a new substring to be reassembled into a ByteStream.
- * There are five cases to handle:
+ *
+ * The common case comes first: a substring that starts exactly where the stream ends, fits in the
+ * available capacity, and arrives while nothing is buffered. It is moved straight into the stream.
+ *
+ * Otherwise, there are five cases to handle:
  * 1. The stream has been closed.
  * 2. The data to be written has been overwritten by the data already written.
  * 3. The data that has been written overlaps with the data to be inserted.
  * 4. Some data exceeds capacity.
  * 5. The data before the substring has not been completely written.
  *
- * Among them, cases 2, 3, and 4 are in function handle_substring.
- * The fifth case is handled in the merge_into_buffered_data function, this function complete the merge operation
- * when data inserted into the buffered_data_.
+ * Among them, cases 2, 3, and 4 are in function handle_substring, which trims a view of the data
+ * rather than the string itself.
+ * In the fifth case the data is handed to buffered_data_, which keeps only the bytes it does not have yet
+ * (as ranges of the substrings, or copied into a staging ring, depending on the Storage).
  *
  * Finally, call write_to_output to write the data to the output stream and address the buffered data.
+ * The end of the stream is remembered as an index, so the stream is closed once every byte before it is written,
+ * whichever substring supplied them.
  *
  * @param first_index The index of the first byte of the substring
  * @param data The substring itself
@@ -35,18 +50,149 @@ void Reassembler::insert( uint64_t first_index, string data, bool is_last_substr
 		return;
 	}
 
+	const uint64_t end_index = first_index + data.size();
+
+	/// Fast path: the next bytes of the stream, all of which fit, with nothing buffered to merge them with
+	if ( first_index == output_.writer().bytes_pushed() and data.size() <= output_.writer().available_capacity()
+		 and count_bytes_pending() == 0 ) {
+		output_.writer().push( std::move( data ) );
+		if ( is_last_substring ) {
+			end_index_ = end_index;
+		}
+		if ( end_index_.has_value() and end_index >= *end_index_ ) {
+			output_.writer().close();
+		}
+		return;
+	}
+
+	/// Retransmissions of bytes that were already written need nothing more (unless they also end the stream)
+	if ( end_index <= output_.writer().bytes_pushed() and not is_last_substring ) {
+		return;
+	}
+
 	/// second, third, fourth cases: The data need to be handled, detailed in handle_substring
-	handle_substring( first_index, data, is_last_substring );
+	string_view view { data };
+	handle_substring( first_index, view, is_last_substring );
+
+	if ( is_last_substring ) {
+		end_index_ = end_index;
+	}
 
 	uint64_t bytes_pushed = output_.writer().bytes_pushed();
 
 	/// fifth case: The data before the substring has not been completely written
 	if ( first_index > bytes_pushed ) {
-		merge_into_buffered_data( first_index, data, is_last_substring );
+		trace<TraceCategory::Reassembler>( "buffer", first_index, view.size() );
+		visit( [&]( auto& store ) { buffer( store, first_index, view, std::move( data ) ); }, buffered_data_ );
 		return; /// Data not yet written
 	}
 
-	write_to_output( first_index, std::move( data ), is_last_substring );
+	write_to_output( first_index, std::move( data ), view );
+}
+
+/**
+ * @brief Insert a batch of substrings, such as every segment read from a socket at once.
+ *
+ * The batch is sorted by index, and the state of the stream is looked up once: nothing reads from the
+ * stream during the batch, so the end of the window does not move. Then:
+ * 1. The end of the stream is remembered if a last substring fits in the window.
+ * 2. The run of substrings that continues the stream is written straight to it, each trimmed to what
+ *    has not been written yet (and moved into the stream whole, when none of it has).
+ * 3. The rest, trimmed to the window, is handed to buffered_data_ together, in order.
+ * Finally, the buffered data the stream has caught up with is written out, and the stream is closed
+ * if its last byte has been written.
+ *
+ * @param segments The substrings (sorted in place, and moved from)
+ */
+void Reassembler::insert_batch( span<Segment> segments )
+{
+	if ( output_.writer().is_closed() ) {
+		return;
+	}
+
+	ranges::stable_sort( segments, {}, &Segment::first_index );
+	trace<TraceCategory::Reassembler>( "batch", segments.size(), output_.writer().bytes_pushed() );
+
+	uint64_t next = output_.writer().bytes_pushed();
+	const uint64_t window_end = next + output_.writer().available_capacity();
+
+	for ( const Segment& segment : segments ) {
+		if ( segment.is_last_substring and segment.first_index <= window_end
+			 and segment.data.size() <= window_end - segment.first_index ) {
+			end_index_ = segment.first_index + segment.data.size();
+		}
+	}
+
+	auto it = segments.begin();
+	for ( ; it != segments.end() and it->first_index <= next; ++it ) {
+		if ( it->data.size() <= next - it->first_index ) {
+			continue; /// Already written
+		}
+
+		const string_view view = string_view { it->data }.substr( next - it->first_index, window_end - next );
+		next += view.size();
+		if ( view.size() == it->data.size() ) {
+			output_.writer().push( std::move( it->data ) );
+		} else {
+			output_.writer().push( view );
+		}
+	}
+
+	vector<SegmentStore::Substring> substrings;
+	for ( ; it != segments.end() and it->first_index < window_end; ++it ) {
+		const string_view view = string_view { it->data }.substr( 0, window_end - it->first_index );
+		if ( not view.empty() ) {
+			substrings.push_back( { it->first_index, view, &it->data } );
+		}
+	}
+
+	if ( not substrings.empty() ) {
+		visit( [&]( auto& store ) { buffer( store, substrings ); }, buffered_data_ );
+	}
+
+	visit( [this]( auto& store ) { write_buffered( store ); }, buffered_data_ );
+
+	if ( end_index_.has_value() and output_.writer().bytes_pushed() >= *end_index_ ) {
+		output_.writer().close();
+	}
+}
+
+/**
+ * @brief Keep bytes that arrived early: the parts of `data` that are not stored yet become segments of `payload`.
+ */
+void Reassembler::buffer( SegmentStore& store, uint64_t first_index, string_view data, string&& payload )
+{
+	store.insert( first_index, data, std::move( payload ) );
+}
+
+/**
+ * @brief Keep bytes that arrived early, copied into the staging ring.
+ *
+ * The ring may not have seen bytes that took the fast path, so it catches up with the stream first.
+ */
+void Reassembler::buffer( StagingRing& ring, uint64_t first_index, string_view data, string&& /* payload */ )
+{
+	ring.advance_to( output_.writer().bytes_pushed() );
+	ring.insert( first_index, data );
+}
+
+/**
+ * @brief Keep a batch of substrings that arrived early, merged into the store in a single pass.
+ */
+void Reassembler::buffer( SegmentStore& store, span<const SegmentStore::Substring> substrings )
+{
+	store.insert_sorted( substrings );
+}
+
+/**
+ * @brief Keep a batch of substrings that arrived early, copied into the staging ring one after another.
+ */
+void Reassembler::buffer( StagingRing& ring, span<const SegmentStore::Substring> substrings )
+{
+	ring.advance_to( output_.writer().bytes_pushed() );
+	for ( const auto& substring : substrings ) {
+		ring.insert( substring.first_index, substring.data );
+	}
 }
 
 /**
@@ -54,77 +200,124 @@ void Reassembler::insert( uint64_t first_index, string data, bool is_last_substr
  */
 uint64_t Reassembler::count_bytes_pending() const
 {
-	uint64_t count = 0;
+	return visit( []( const auto& store ) { return store.bytes_stored(); }, buffered_data_ );
+}
+
+/**
+ * @brief List the ranges of pending bytes, for reporting them to the sender as selective acknowledgments.
+ */
+vector<pair<uint64_t, uint64_t>> Reassembler::pending_ranges( size_t max_ranges ) const
+{
+	return visit( [&]( const auto& store ) { return store.ranges( max_ranges ); }, buffered_data_ );
+}
+
+/**
+ * @brief Count the memory used to hold the pending bytes: what the store has allocated, not just what it stores.
+ */
+uint64_t Reassembler::memory_used() const
+{
+	return visit( []( const auto& store ) { return store.memory_used(); }, buffered_data_ );
+}
 
-	for ( const auto& entry : buffered_data_ ) {
-		count += entry.second.first.size();
+void Reassembler::set_max_fragments( size_t max_fragments )
+{
+	if ( auto* store = get_if<SegmentStore>( &buffered_data_ ) ) {
+		store->set_max_segments( max_fragments );
 	}
+}
 
-	return count;
+/**
+ * @brief Resize the output stream, and the staging ring with it.
+ *
+ * Pending bytes past the new end of the window (which can only happen when the capacity shrinks)
+ * are dropped, as they would have been had they arrived now.
+ *
+ * @param capacity The new capacity of the output stream
+ */
+void Reassembler::set_capacity( uint64_t capacity )
+{
+	output_.set_capacity( capacity );
+	const uint64_t window_end = output_.writer().bytes_pushed() + output_.writer().available_capacity();
+
+	if ( auto* store = get_if<SegmentStore>( &buffered_data_ ) ) {
+		store->truncate( window_end );
+	} else {
+		auto& ring = get<StagingRing>( buffered_data_ );
+		ring.advance_to( output_.writer().bytes_pushed() );
+		ring.truncate( window_end );
+		ring.resize( output_.capacity() );
+	}
 }
 
 /**
  * @brief Write the data to the output stream and handle buffered data.
  *
  * At first, write the data to the output stream.
- * Then, check the buffered data and write it to the output stream if possible.
- *
- * For buffer data write operations, there are the following situations:
- * 1. The data before it not completely wriiten, break the loop because map is ordered.
- * 2. The data before it has been completely written and no overlapping, write the data to the output stream and
- * erase it from the buffered_data_.
- * 3. The data before it has been completely written and overlapping, write the data to the output stream and erase
- * it from the buffered_data_. In the third case, there are two another situations: 3.1 The data has been
- * overridden, write the data to the output stream and erase it from the buffered_data_. 3.2 The data has not been
- * overridden, write the data to the output stream and erase it from the buffered_data_.
+ * Then, write out whatever buffered data the stream has caught up with (see write_buffered).
+ * Finally, close the stream if its last byte has been written.
  *
  * @param first_index The index of the first byte of the substring
  * @param data The substring itself
- * @param is_last_substring This substring represents the end of the stream
+ * @param view The part of it to write (the whole string is moved into the stream if that is all of it)
  */
-void Reassembler::write_to_output( uint64_t first_index, string&& data, bool is_last_substring )
+void Reassembler::write_to_output( uint64_t first_index, string&& data, string_view view )
 {
-	static int debug_count = 0;
-	if ( debug_count++ < 10 ) {
-		debug( "write_to_output({}, size={}, {})", first_index, data.size(), is_last_substring );
+	trace<TraceCategory::Reassembler>( "write", first_index, view.size() );
+
+	if ( view.size() == data.size() ) {
+		output_.writer().push( std::move( data ) );
+	} else {
+		output_.writer().push( view );
 	}
 
-	output_.writer().push( std::move( data ) );
+	visit( [this]( auto& store ) { write_buffered( store ); }, buffered_data_ );
 
-	if ( is_last_substring ) {
+	if ( end_index_.has_value() and output_.writer().bytes_pushed() >= *end_index_ ) {
 		output_.writer().close();
 	}
+}
 
-	while ( !buffered_data_.empty() ) {
-		auto it = buffered_data_.begin();
-		uint64_t it_first_index = it->first;
-		uint64_t it_last_index = it_first_index + it->second.first.size() - 1;
+/**
+ * @brief Write out the buffered segments that the stream has caught up with, in order.
+ *
+ * 1. The segment starts after the end of the stream, stop because the segments are ordered.
+ * 2. The segment has been completely written already, drop it.
+ * 3. Otherwise, write the part of it that has not been written yet, and drop it.
+ * Buffered segments are written from views of their payloads, without copying them first.
+ */
+void Reassembler::write_buffered( SegmentStore& store )
+{
+	while ( not store.empty() ) {
+		const uint64_t segment_index = store.front_index();
+		const uint64_t bytes_pushed = output_.writer().bytes_pushed();
 
-		if ( it_first_index > output_.writer().bytes_pushed() ) {
+		if ( segment_index > bytes_pushed ) {
 			break; /// No more data to write
 		}
 
-		if ( it_first_index == output_.writer().bytes_pushed() ) {
-			output_.writer().push( std::move( it->second.first ) );
-			if ( it->second.second ) {
-				output_.writer().close();
-			}
-			buffered_data_.erase( it );
-			continue; /// Data has been written
-		}
-
-		if ( it_last_index < output_.writer().bytes_pushed() ) {
-			buffered_data_.erase( it );
-			continue; /// Data has already been written
+		const string_view segment = store.front();
+		if ( segment_index + segment.size() > bytes_pushed ) {
+			output_.writer().push( segment.substr( bytes_pushed - segment_index ) );
 		}
+		store.pop_front();
+	}
+}
 
-		std::string new_data = it->second.first.substr( output_.writer().bytes_pushed() - it_first_index );
+/**
+ * @brief Write out the run of staged bytes that now continues the stream.
+ *
+ * Staged bytes the stream already has (because they just arrived again in order) are forgotten first.
+ * The run is then pushed straight from the ring, in one piece (two if it wraps around the end of the ring).
+ */
+void Reassembler::write_buffered( StagingRing& ring )
+{
+	ring.advance_to( output_.writer().bytes_pushed() );
 
-		output_.writer().push( std::move( new_data ) );
-		if ( it->second.second ) {
-			output_.writer().close();
-		}
-		buffered_data_.erase( it );
+	for ( uint64_t run = ring.contiguous_bytes(); run > 0; ) {
+		const string_view region = ring.front( run );
+		output_.writer().push( region );
+		ring.advance_to( ring.next_index() + region.size() );
+		run -= region.size();
 	}
 }
 
@@ -135,14 +328,14 @@ void Reassembler::write_to_output( uint64_t first_index, string&& data, bool is_
  * @param data The substring itself
  * @param is_last_substring This substring represents the end of the stream
  */
-void Reassembler::handle_substring( uint64_t& first_index, string& data, bool& is_last_substring )
+void Reassembler::handle_substring( uint64_t& first_index, string_view& data, bool& is_last_substring )
 {
 	uint64_t bytes_pushed = output_.writer().bytes_pushed();
 	uint64_t available_capacity = output_.writer().available_capacity();
 
 	// second case: The data to be written has been overwritten by the data already written
 	if ( bytes_pushed >= first_index + data.size() ) {
-		data.clear(); // Data has already been written, so clear the string.
+		data = {}; // Data has already been written, so clear the view.
 		return;
 	}
 
@@ -150,84 +343,21 @@ void Reassembler::handle_substring( uint64_t& first_index, string& data, bool& i
 	if ( first_index < bytes_pushed ) {
 		size_t offset = bytes_pushed - first_index;
 		if ( offset >= data.size() ) {
-			data.clear();
+			data = {};
 			return;
 		}
-		data = data.substr( offset );
+		data.remove_prefix( offset );
 		first_index = bytes_pushed;
 	}
 
 	/// fourth case: Some data exceeds capacity
-	if ( first_index + data.size() > available_capacity + bytes_pushed ) {
-		data = data.substr( 0,
-							std::max( static_cast<size_t>( 0 ),
-									  available_capacity + bytes_pushed
-										- first_index ) ); /// Trim data to fit within the available capacity.
+	const uint64_t window_end = available_capacity + bytes_pushed;
+	if ( first_index + data.size() > window_end ) {
+		/// Trim data to fit within the available capacity.
+		data = data.substr( 0, first_index < window_end ? window_end - first_index : 0 );
 
 		// If this substring is the last one, we keep the part that can be accommodated, and this part is not the
 		// last one.
 		is_last_substring = false;
 	}
 }
-
-/**
- * @brief Merge the new substring into the buffered data.
- * First, find the lower bound of the first index in the buffered data, and check if the previous data overlaps with
- * the new substring, if so, merge them. Then merge the new substring with later buffered data, if there is any
- * overlap, merge and erase the buffered data. Finally, insert the merged data into the buffered_data_.
- * @param first_index The index of the first byte of the substring
- * @param data The substring itself
- * @param is_last_substring This substring represents the end of the stream
- */
-void Reassembler::merge_into_buffered_data( uint64_t first_index, std::string data, bool is_last_substring )
-{
-	uint64_t current_last_index = first_index + data.size() - 1;
-	uint64_t current_first_index = first_index;
-	auto it = buffered_data_.lower_bound( first_index );
-
-	if ( it != buffered_data_.begin() ) {
-		auto prev_it = std::prev( it );
-		uint64_t prev_end = prev_it->first + prev_it->second.first.size() - 1;
-
-		if ( prev_end >= first_index - 1 ) {
-			first_index = prev_it->first;
-
-			if ( current_last_index <= prev_end ) {
-				return; /// The new data is completely covered by the previous data
-			}
-
-			std::string merged_data;
-
-			merged_data = prev_it->second.first.substr( 0, current_first_index - prev_it->first ) + data;
-
-			/// Update loop variables
-			data = std::move( merged_data );
-			current_first_index = prev_it->first;
-			// current_last_index not changed
-			is_last_substring |= prev_it->second.second;
-
-			buffered_data_.erase( prev_it );
-		}
-	}
-
-	while ( ( it = buffered_data_.lower_bound( current_first_index ) ) != buffered_data_.end()
-			&& it->first <= current_last_index ) {
-		uint64_t it_first_index = it->first;
-		uint64_t it_last_index = it_first_index + it->second.first.size() - 1;
-
-		if ( current_last_index >= it_last_index ) {
-			/// current_last_index not changed
-			is_last_substring |= it->second.second;
-			buffered_data_.erase( it );
-			continue;
-		}
-
-		data = data.substr( 0, it_first_index - current_first_index ) + it->second.first;
-		/// current_first_index not changed
-		current_last_index = it_last_index;
-		is_last_substring |= it->second.second;
-		buffered_data_.erase( it );
-	}
-
-	buffered_data_[current_first_index] = std::make_pair( std::move( data ), is_last_substring );
-}
@@ -1,16 +1,37 @@
 #pragma once
 
 #include "byte_stream.hh"
+#include "segment_store.hh"
+#include "staging_ring.hh"
 #include <cstdint>
-#include <map>
+#include <optional>
+#include <span>
 #include <string>
 #include <utility>
+#include <variant>
+#include <vector>
 
 class Reassembler
 {
   public:
+	// How the Reassembler keeps bytes that arrive before the bytes preceding them
+	enum class Storage : uint8_t
+	{
+		Segments,	 // Ranges of the substrings themselves (the default), so memory follows what arrives
+		StagingRing, // Copies in a window-sized ring with a presence bitmap, so memory is fixed however they arrive
+	};
+
+	// A substring, as passed to insert()
+	struct Segment
+	{
+		uint64_t first_index;
+		std::string data;
+		bool is_last_substring;
+	};
+
 	// Construct Reassembler to write into given ByteStream.
-	explicit Reassembler( ByteStream&& output ) : output_( std::move( output ) ), buffered_data_() {}
+	explicit Reassembler( ByteStream&& output ) : Reassembler( std::move( output ), Storage::Segments ) {}
+	Reassembler( ByteStream&& output, Storage storage );
 
 	/*
 	 * Insert a new substring to be reassembled into a ByteStream.
@@ -34,10 +55,33 @@ class Reassembler
 	 */
 	void insert( uint64_t first_index, std::string data, bool is_last_substring );
 
+	/*
+	 * Insert a batch of substrings, with the same result as inserting each of them in turn.
+	 * The batch is sorted by first_index in place, and the data is moved out of the segments.
+	 */
+	void insert_batch( std::span<Segment> segments );
+
 	// How many bytes are stored in the Reassembler itself?
 	// This function is for testing only; don't add extra state to support it.
 	uint64_t count_bytes_pending() const;
 
+	// Which ranges of bytes is it holding? Up to `max_ranges` of them, each as [first_index, end_index),
+	// the most recently received first.
+	std::vector<std::pair<uint64_t, uint64_t>> pending_ranges( size_t max_ranges ) const;
+
+	// How much memory is the Reassembler using to hold those bytes, counting its bookkeeping?
+	uint64_t memory_used() const;
+
+	// Hold at most `max_fragments` separate runs of pending bytes (by default, there is no limit), and copy out
+	// the bytes a substring adds rather than keeping all of it, when they are a small part of it. Past the limit,
+	// adjacent runs are coalesced, and then the runs furthest ahead in the stream are dropped.
+	// A StagingRing uses the same memory however the bytes arrive, so this only applies to Segments.
+	void set_max_fragments( size_t max_fragments );
+
+	// Change the capacity of the output stream (see ByteStream::set_capacity), dropping any pending bytes that
+	// no longer fit in its available capacity
+	void set_capacity( uint64_t capacity );
+
 	// Access output stream reader
 	Reader& reader() { return output_.reader(); }
 	const Reader& reader() const { return output_.reader(); }
@@ -49,9 +93,15 @@ class Reassembler
 
   private:
 	ByteStream output_;
-	std::map<uint64_t, std::pair<std::string, bool>> buffered_data_;
+	std::variant<SegmentStore, StagingRing> buffered_data_; // Bytes that arrived before the bytes preceding them
+	std::optional<uint64_t> end_index_ {}; // Index just past the last byte of the stream, once known
 
-	void write_to_output( uint64_t first_index, std::string&& data, bool is_last_substring );
-	void handle_substring( uint64_t& first_index, std::string& data, bool& is_last_substring );
-	void merge_into_buffered_data( uint64_t first_index, std::string data, bool is_last_substring );
+	void write_to_output( uint64_t first_index, std::string&& data, std::string_view view );
+	void write_buffered( SegmentStore& store );
+	void write_buffered( StagingRing& ring );
+	void buffer( SegmentStore& store, uint64_t first_index, std::string_view data, std::string&& payload );
+	void buffer( StagingRing& ring, uint64_t first_index, std::string_view data, std::string&& payload );
+	void buffer( SegmentStore& store, std::span<const SegmentStore::Substring> substrings );
+	void buffer( StagingRing& ring, std::span<const SegmentStore::Substring> substrings );
+	void handle_substring( uint64_t& first_index, std::string_view& data, bool& is_last_substring );
 };
@@ -0,0 +1,167 @@
+#include "ring_buffer.hh"
+
+#include "exception.hh"
+#include "file_descriptor.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+RingBuffer::RingBuffer( uint64_t min_size, Kind kind ) : kind_( kind )
+{
+	allocate( min_size );
+}
+
+RingBuffer::RingBuffer( const RingBuffer& other ) : kind_( other.kind_ ), pool_( other.pool_ )
+{
+	if ( other.data_ ) {
+		allocate( other.size_ );
+		memcpy( data_, other.data_, size_ );
+	}
+}
+
+RingBuffer& RingBuffer::operator=( const RingBuffer& other )
+{
+	if ( this != &other ) {
+		RingBuffer copy { other };
+		*this = move( copy );
+	}
+	return *this;
+}
+
+RingBuffer::RingBuffer( RingBuffer&& other ) noexcept
+  : kind_( other.kind_ )
+  , size_( exchange( other.size_, 0 ) )
+  , data_( exchange( other.data_, nullptr ) )
+  , pool_( other.pool_ )
+{}
+
+RingBuffer& RingBuffer::operator=( RingBuffer&& other ) noexcept
+{
+	if ( this != &other ) {
+		release();
+		kind_ = other.kind_;
+		size_ = exchange( other.size_, 0 );
+		data_ = exchange( other.data_, nullptr );
+		pool_ = other.pool_;
+	}
+	return *this;
+}
+
+span<char> RingBuffer::region( uint64_t pos, uint64_t len )
+{
+	if ( not data_ ) {
+		return {};
+	}
+
+	const uint64_t offset = pos & mask();
+	const uint64_t limit = kind_ == Kind::Mirrored ? size_ : size_ - offset;
+	return { data_ + offset, std::min( len, limit ) };
+}
+
+string_view RingBuffer::region( uint64_t pos, uint64_t len ) const
+{
+	if ( not data_ ) {
+		return {};
+	}
+
+	const uint64_t offset = pos & mask();
+	const uint64_t limit = kind_ == Kind::Mirrored ? size_ : size_ - offset;
+	return { data_ + offset, std::min( len, limit ) };
+}
+
+/**
+ * @brief Move the ring to a new allocation of a different size.
+ *
+ * Each byte keeps its stream position, so it may land at a different offset in the new ring;
+ * the bytes are copied in pieces that are contiguous in both the old and the new ring.
+ *
+ * @param min_size The smallest acceptable size of the new ring, or zero to free it.
+ * @param begin The stream position of the first byte to keep.
+ * @param end The stream position one past the last byte to keep.
+ */
+void RingBuffer::resize( uint64_t min_size, uint64_t begin, uint64_t end )
+{
+	RingBuffer resized { kind_ };
+	resized.pool_ = pool_;
+	if ( min_size > 0 ) {
+		resized.allocate( min_size );
+	}
+
+	while ( begin < end ) {
+		const string_view from = std::as_const( *this ).region( begin, end - begin );
+		const span<char> to = resized.region( begin, from.size() );
+		if ( to.empty() ) {
+			throw runtime_error( "RingBuffer::resize() to a ring that is too small" );
+		}
+		memcpy( to.data(), from.data(), to.size() );
+		begin += to.size();
+	}
+
+	*this = move( resized );
+}
+
+/**
+ * @brief Allocate the ring.
+ *
+ * A Heap ring comes from the pool, if it has one, or else from operator new.
+ * A Mirrored ring reserves twice its size of address space, then maps a memfd of `size_` bytes
+ * over both halves. The memfd itself can be closed once mapped; the mappings keep the pages alive.
+ *
+ * @param min_size The smallest acceptable ring size.
+ */
+void RingBuffer::allocate( uint64_t min_size )
+{
+	size_ = bit_ceil( std::max( min_size, uint64_t { 1 } ) );
+
+	if ( kind_ == Kind::Heap ) {
+		data_ = pool_ ? pool_->acquire( size_ ) : new char[size_]; // NOLINT(*-owning-memory)
+		return;
+	}
+
+	size_ = std::max( size_, static_cast<uint64_t>( sysconf( _SC_PAGESIZE ) ) );
+
+	const FileDescriptor memfd { CheckSystemCall( "memfd_create", memfd_create( "ByteStream", MFD_CLOEXEC ) ) };
+	CheckSystemCall( "ftruncate", ftruncate( memfd.fd_num(), static_cast<off_t>( size_ ) ) );
+
+	void* const base = mmap( nullptr, 2 * size_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if ( base == MAP_FAILED ) {
+		throw unix_error { "mmap" };
+	}
+
+	for ( const uint64_t half : { uint64_t { 0 }, size_ } ) {
+		void* const address = static_cast<char*>( base ) + half;
+		if ( mmap( address, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memfd.fd_num(), 0 )
+			 == MAP_FAILED ) {
+			const unix_error error { "mmap" };
+			munmap( base, 2 * size_ );
+			throw error; // NOLINT(*-exception-copy-constructor-throws)
+		}
+	}
+
+	data_ = static_cast<char*>( base );
+}
+
+void RingBuffer::release()
+{
+	if ( not data_ ) {
+		return;
+	}
+
+	if ( kind_ == Kind::Heap and pool_ ) {
+		pool_->release( data_, size_ );
+	} else if ( kind_ == Kind::Heap ) {
+		delete[] data_; // NOLINT(*-owning-memory)
+	} else {
+		munmap( data_, 2 * size_ );
+	}
+
+	data_ = nullptr;
+	size_ = 0;
+}
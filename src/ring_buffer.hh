@@ -0,0 +1,72 @@
+#pragma once
+
+#include "buffer_pool.hh"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+
+/*
+ * The storage behind a ByteStream: a ring of bytes whose size is a power of two, so that
+ * a position in the stream maps to an offset in the ring with `position & mask()`.
+ *
+ * A Heap ring is a plain allocation; a run of bytes that crosses the end of the ring continues
+ * at the beginning. A Mirrored ring maps the same (memfd-backed) pages twice, back to back, so
+ * data()[i] and data()[i + size()] are the same byte and any run of up to size() bytes starting
+ * inside the ring is contiguous in memory.
+ *
+ * A Heap ring may take its memory from a BufferPool instead of operator new; the ring keeps the
+ * pool alive and gives the memory back to it when the ring is freed or resized.
+ */
+class RingBuffer
+{
+  public:
+	enum class Kind : uint8_t
+	{
+		Heap,
+		Mirrored
+	};
+
+	RingBuffer() = default;
+	explicit RingBuffer( Kind kind ) : kind_( kind ) {} // An empty ring (nothing allocated yet)
+
+	// An empty Heap ring that will allocate from `pool` (or from operator new, if null)
+	explicit RingBuffer( std::shared_ptr<BufferPool> pool ) : pool_( std::move( pool ) ) {}
+
+	// Allocate a ring of at least `min_size` bytes (rounded up to a power of two, and to whole pages if mirrored)
+	RingBuffer( uint64_t min_size, Kind kind );
+
+	// Copies allocate a new ring of the same size and kind (from the same pool) and copy its contents.
+	RingBuffer( const RingBuffer& other );
+	RingBuffer& operator=( const RingBuffer& other );
+	RingBuffer( RingBuffer&& other ) noexcept;
+	RingBuffer& operator=( RingBuffer&& other ) noexcept;
+	~RingBuffer() { release(); }
+
+	Kind kind() const { return kind_; }
+	const std::shared_ptr<BufferPool>& pool() const { return pool_; }
+	uint64_t size() const { return size_; }
+	uint64_t mask() const { return size_ - 1; }
+
+	char* data() { return data_; }
+	const char* data() const { return data_; }
+
+	// The longest contiguous run, of at most `len` bytes, that starts at stream position `pos`.
+	// For a Mirrored ring (and len <= size()) this is always all `len` bytes. Empty if nothing is allocated.
+	std::span<char> region( uint64_t pos, uint64_t len );
+	std::string_view region( uint64_t pos, uint64_t len ) const;
+
+	// Reallocate the ring with at least `min_size` bytes (or free it, if zero), keeping the bytes
+	// at stream positions [begin, end) at the same positions in the new ring.
+	void resize( uint64_t min_size, uint64_t begin, uint64_t end );
+
+  private:
+	Kind kind_ {};
+	uint64_t size_ {};
+	char* data_ {};
+	std::shared_ptr<BufferPool> pool_ {};
+
+	void allocate( uint64_t min_size );
+	void release();
+};
@@ -0,0 +1,517 @@
+#include "segment_store.hh"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+// Bytes of heap memory a string holds (none, if it is short enough to be kept inside the string itself)
+uint64_t heap_bytes( const string& data )
+{
+	return data.capacity() > string {}.capacity() ? data.capacity() + 1 : 0;
+}
+
+} // namespace
+
+/**
+ * @brief Store the parts of a substring that are not already stored.
+ *
+ * The stored segments that overlap [first_index, first_index + data.size()) are found with a binary
+ * search. The gaps between them become new segments of the substring's payload, and are merged into
+ * place in a single pass from the back, so the segments after them move only once. If the store has
+ * a limit and the gaps are only a small part of the payload, they are copied out of it instead.
+ *
+ * @param first_index The index of the first byte of the substring
+ * @param data The substring itself
+ * @param payload The string that `data` is part of
+ */
+void SegmentStore::insert( uint64_t first_index, string_view data, string&& payload )
+{
+	if ( data.empty() ) {
+		return;
+	}
+
+	// Where `data` starts in the payload (found before the payload is moved, which can move short strings)
+	const uint64_t base = data.data() - payload.data();
+
+	const uint64_t last_index = first_index + data.size();
+	const auto by_end = []( const Segment& segment, uint64_t index ) { return segment.end_index() <= index; };
+	const auto by_start = []( const Segment& segment, uint64_t index ) { return segment.first_index < index; };
+
+	// The stored segments overlapping the substring are [lo, hi)
+	const auto begin = segments_.begin() + static_cast<ptrdiff_t>( head_ );
+	const auto lo = lower_bound( begin, segments_.end(), first_index, by_end );
+	const auto hi = lower_bound( lo, segments_.end(), last_index, by_start );
+
+	// Carve the gaps out of the substring
+	gaps_.clear();
+	uint64_t next = first_index;
+	for ( auto it = lo; it != hi; ++it ) {
+		if ( it->first_index > next ) {
+			gaps_.push_back( { next, it->first_index - next, base + next - first_index, 0, 0 } );
+		}
+		next = max( next, it->end_index() );
+	}
+	if ( next < last_index ) {
+		gaps_.push_back( { next, last_index - next, base + next - first_index, 0, 0 } );
+	}
+
+	if ( gaps_.empty() ) {
+		return;
+	}
+
+	const uint32_t slot = add_payload( move( payload ) );
+	payloads_[slot].refs = gaps_.size();
+	const uint32_t arrival = ++arrivals_;
+	uint64_t gap_bytes = 0;
+	for ( auto& gap : gaps_ ) {
+		gap.payload = slot;
+		gap.arrival = arrival;
+		gap_bytes += gap.length;
+	}
+	bytes_stored_ += gap_bytes;
+	trim_payload( slot, gap_bytes, gaps_ );
+	add_run( first_index, last_index, arrival );
+
+	// Make room after the overlapping segments, then merge the gaps in from the back
+	const auto lo_pos = distance( segments_.begin(), lo );
+	auto hi_pos = distance( segments_.begin(), hi );
+	segments_.insert( segments_.begin() + hi_pos, gaps_.size(), Segment {} );
+
+	auto out = segments_.begin() + hi_pos + static_cast<ptrdiff_t>( gaps_.size() );
+	auto gap = gaps_.rbegin();
+	while ( gap != gaps_.rend() ) {
+		if ( hi_pos > lo_pos and segments_[hi_pos - 1].first_index > gap->first_index ) {
+			*--out = segments_[--hi_pos];
+		} else {
+			*--out = *gap++;
+		}
+	}
+
+	enforce_limit();
+}
+
+/**
+ * @brief Store the parts of a batch of substrings that are not already stored, in a single pass.
+ *
+ * The stored segments from the first one that reaches the batch onwards are set aside, and the list is
+ * rebuilt from there by merging them with the batch: each substring contributes the gaps that neither a
+ * stored segment nor an earlier substring of the batch has covered. A substring's payload is only kept
+ * if at least one of its gaps is (and trimmed to them, as in insert(), if the store has a limit).
+ *
+ * @param substrings The substrings, sorted by first_index
+ */
+void SegmentStore::insert_sorted( span<const Substring> substrings )
+{
+	if ( substrings.empty() ) {
+		return;
+	}
+
+	const auto by_end = []( const Segment& segment, uint64_t index ) { return segment.end_index() <= index; };
+	const auto begin = segments_.begin() + static_cast<ptrdiff_t>( head_ );
+	const auto lo = lower_bound( begin, segments_.end(), substrings.front().first_index, by_end );
+
+	// The stored segments the batch may interleave with: gaps_[0, existing.size()) in order
+	gaps_.assign( lo, segments_.end() );
+	segments_.erase( lo, segments_.end() );
+	auto existing = gaps_.begin();
+
+	uint64_t covered = 0; // Index just past the last byte of the rebuilt list
+	for ( const Substring& substring : substrings ) {
+		const uint32_t arrival = ++arrivals_; // (each substring counts as its own arrival)
+		const uint64_t last_index = substring.first_index + substring.data.size();
+		const uint64_t base = substring.data.data() - substring.payload->data();
+		uint64_t next = max( covered, substring.first_index );
+		optional<uint32_t> slot;
+		size_t first_gap = 0;
+		uint64_t gap_bytes = 0;
+
+		while ( next < last_index ) {
+			if ( existing != gaps_.end() and existing->first_index <= next ) {
+				covered = existing->end_index();
+				next = max( next, covered );
+				segments_.push_back( *existing++ );
+				continue;
+			}
+
+			const uint64_t gap_end
+			  = existing == gaps_.end() ? last_index : min( last_index, existing->first_index );
+			if ( not slot.has_value() ) {
+				slot = add_payload( move( *substring.payload ) );
+				first_gap = segments_.size();
+			}
+			++payloads_[*slot].refs;
+			segments_.push_back( { next, gap_end - next, base + next - substring.first_index, *slot, arrival } );
+			gap_bytes += gap_end - next;
+			covered = next = gap_end;
+		}
+
+		if ( slot.has_value() ) {
+			bytes_stored_ += gap_bytes;
+			trim_payload( *slot, gap_bytes, span { segments_ }.subspan( first_gap ) );
+			add_run( substring.first_index, last_index, arrival );
+		}
+	}
+
+	segments_.insert( segments_.end(), existing, gaps_.end() );
+	enforce_limit();
+}
+
+/**
+ * @brief List the runs of stored bytes, most recently added first.
+ *
+ * A run is as recent as the latest insert that stored bytes in it, so the most recent runs are found by
+ * looking up the latest few inserts, with a binary search each, in order: the run holding an insert's bytes
+ * is next if that insert is what makes it recent. Only if the inserts remembered do not account for as many
+ * runs as were asked for are all the runs sorted by recency instead.
+ *
+ * @param max_ranges The most runs to list
+ * @return The runs, each as [first_index, end_index)
+ */
+vector<pair<uint64_t, uint64_t>> SegmentStore::ranges( size_t max_ranges ) const
+{
+	const auto begin = runs_.begin() + static_cast<ptrdiff_t>( runs_head_ );
+	const size_t run_count = runs_.size() - runs_head_;
+	const size_t count = min( max_ranges, run_count );
+
+	vector<pair<uint64_t, uint64_t>> ret;
+	ret.reserve( count );
+	for ( size_t i = 0; i < recent_count_ and ret.size() < count; ++i ) {
+		const Run& insert = recent_[i];
+		const auto run = lower_bound( begin, runs_.end(), insert.first_index, []( const Run& r, uint64_t index ) {
+			return r.end_index <= index;
+		} );
+		if ( run != runs_.end() and run->first_index < insert.end_index and run->arrival == insert.arrival ) {
+			ret.emplace_back( run->first_index, run->end_index );
+		}
+	}
+	if ( ret.size() == count ) {
+		return ret;
+	}
+
+	vector<Run> runs { begin, runs_.end() };
+	const auto by_recency = []( const Run& a, const Run& b ) {
+		return tie( a.arrival, a.first_index ) > tie( b.arrival, b.first_index );
+	};
+	partial_sort( runs.begin(), runs.begin() + static_cast<ptrdiff_t>( count ), runs.end(), by_recency );
+
+	ret.clear();
+	for ( size_t i = 0; i < count; ++i ) {
+		ret.emplace_back( runs[i].first_index, runs[i].end_index );
+	}
+	return ret;
+}
+
+string_view SegmentStore::front() const
+{
+	const Segment& segment = segments_[head_];
+	return string_view { payloads_[segment.payload].data }.substr( segment.offset, segment.length );
+}
+
+/**
+ * @brief Forget the front segment, compacting the list once most of it has been popped.
+ */
+void SegmentStore::pop_front()
+{
+	bytes_stored_ -= segments_[head_].length;
+	release_payload( segments_[head_].payload );
+	++head_;
+
+	if ( head_ == segments_.size() ) {
+		segments_.clear();
+		head_ = 0;
+	} else if ( head_ >= kMinPoppedSegments and 2 * head_ >= segments_.size() ) {
+		segments_.erase( segments_.begin(), segments_.begin() + static_cast<ptrdiff_t>( head_ ) );
+		head_ = 0;
+	}
+
+	// The front run loses the same bytes (and goes, if that was all of it)
+	const uint64_t front_index = empty() ? numeric_limits<uint64_t>::max() : segments_[head_].first_index;
+	while ( runs_head_ < runs_.size() and runs_[runs_head_].end_index <= front_index ) {
+		++runs_head_;
+	}
+	if ( runs_head_ == runs_.size() ) {
+		runs_.clear();
+		runs_head_ = 0;
+	} else {
+		Run& run = runs_[runs_head_];
+		if ( run.first_index < front_index ) {
+			run.first_index = front_index;
+			run.arrival = trimmed_arrival( run );
+		}
+		if ( runs_head_ >= kMinPoppedSegments and 2 * runs_head_ >= runs_.size() ) {
+			runs_.erase( runs_.begin(), runs_.begin() + static_cast<ptrdiff_t>( runs_head_ ) );
+			runs_head_ = 0;
+		}
+	}
+}
+
+/**
+ * @brief Replace a new payload with just the bytes its segments use, if that is less than half of it.
+ *
+ * Only a store with a limit does this; without one, storing a substring never copies it.
+ *
+ * @param slot The payload
+ * @param bytes_used The total length of the segments that use it
+ * @param segments A range of segments that includes all of them (others are left alone)
+ */
+void SegmentStore::trim_payload( uint32_t slot, uint64_t bytes_used, span<Segment> segments )
+{
+	string& data = payloads_[slot].data;
+	if ( max_segments_ == numeric_limits<size_t>::max() or 2 * bytes_used >= heap_bytes( data ) ) {
+		return;
+	}
+
+	string trimmed;
+	trimmed.reserve( bytes_used );
+	for ( Segment& segment : segments ) {
+		if ( segment.payload == slot ) {
+			trimmed.append( string_view { data }.substr( segment.offset, segment.length ) );
+			segment.offset = trimmed.size() - segment.length;
+		}
+	}
+
+	// Swapped rather than assigned: a short string assigned into a long one would keep the long one's allocation
+	payload_bytes_ -= heap_bytes( data );
+	data.swap( trimmed );
+	payload_bytes_ += heap_bytes( data );
+}
+
+/**
+ * @brief Count the memory the store holds, not just the bytes it stores.
+ *
+ * That is the heap memory of every payload a segment still uses (all of it, however little of it the
+ * segments cover), plus the capacity of the lists of segments and payloads.
+ */
+uint64_t SegmentStore::memory_used() const
+{
+	return payload_bytes_ + ( segments_.capacity() + gaps_.capacity() ) * sizeof( Segment )
+		   + runs_.capacity() * sizeof( Run )
+		   + payloads_.capacity() * sizeof( Payload ) + free_payloads_.capacity() * sizeof( uint32_t );
+}
+
+void SegmentStore::set_max_segments( size_t max_segments )
+{
+	max_segments_ = max( max_segments, size_t { 1 } );
+	enforce_limit();
+}
+
+/**
+ * @brief Drop the stored bytes from `end_index` on, trimming the segment that straddles it.
+ */
+void SegmentStore::truncate( uint64_t end_index )
+{
+	while ( not empty() and segments_.back().first_index >= end_index ) {
+		bytes_stored_ -= segments_.back().length;
+		release_payload( segments_.back().payload );
+		segments_.pop_back();
+	}
+
+	if ( not empty() and segments_.back().end_index() > end_index ) {
+		bytes_stored_ -= segments_.back().end_index() - end_index;
+		segments_.back().length = end_index - segments_.back().first_index;
+	}
+
+	if ( empty() ) {
+		segments_.clear();
+		head_ = 0;
+	}
+	trim_runs();
+}
+
+/**
+ * @brief Bring the store back under its limit on segments, if it has gone over.
+ *
+ * Coalescing comes first, since it keeps every byte. Whatever is still over the limit is dropped from
+ * the back. Either way the store ends up an eighth below the limit, so that the next few inserts do
+ * not have to do this again.
+ */
+void SegmentStore::enforce_limit()
+{
+	if ( segment_count() <= max_segments_ ) {
+		return;
+	}
+
+	const size_t target = max_segments_ - max_segments_ / 8;
+	coalesce();
+
+	while ( segment_count() > target ) {
+		bytes_stored_ -= segments_.back().length;
+		release_payload( segments_.back().payload );
+		segments_.pop_back();
+	}
+	trim_runs();
+}
+
+/**
+ * @brief Merge the bytes [first_index, end_index), which the store now holds all of, into the runs.
+ *
+ * The runs it overlaps or touches become one, as recent as this arrival, which is also remembered as
+ * the newest of the recent arrivals.
+ */
+void SegmentStore::add_run( uint64_t first_index, uint64_t end_index, uint32_t arrival )
+{
+	const auto begin = runs_.begin() + static_cast<ptrdiff_t>( runs_head_ );
+	const auto lo
+	  = lower_bound( begin, runs_.end(), first_index, []( const Run& r, uint64_t i ) { return r.end_index < i; } );
+	const auto hi
+	  = upper_bound( lo, runs_.end(), end_index, []( uint64_t i, const Run& r ) { return i < r.first_index; } );
+
+	const uint64_t run_first = lo == hi ? first_index : min( lo->first_index, first_index );
+	const uint64_t run_end = lo == hi ? end_index : max( prev( hi )->end_index, end_index );
+	if ( lo == hi ) {
+		runs_.insert( lo, { first_index, end_index, arrival } );
+	} else {
+		*lo = { run_first, run_end, arrival };
+		runs_.erase( next( lo ), hi );
+	}
+
+	// The arrivals in the runs it merged are no longer needed to find them, which leaves room for older ones
+	const auto recent_end = remove_if(
+	  recent_.begin(), recent_.begin() + static_cast<ptrdiff_t>( recent_count_ ), [&]( const Run& insert ) {
+		  return insert.first_index < run_end and run_first < insert.end_index;
+	  } );
+	recent_count_ = min<size_t>( recent_end - recent_.begin() + 1, kRecentArrivals );
+	copy_backward( recent_.begin(), recent_.begin() + static_cast<ptrdiff_t>( recent_count_ - 1 ),
+				   recent_.begin() + static_cast<ptrdiff_t>( recent_count_ ) );
+	recent_[0] = { first_index, end_index, arrival };
+}
+
+/**
+ * @brief Cut the runs back to the stored segments, after segments were dropped from the back.
+ */
+void SegmentStore::trim_runs()
+{
+	if ( empty() ) {
+		runs_.clear();
+		runs_head_ = 0;
+		recent_count_ = 0;
+		return;
+	}
+
+	const uint64_t end_index = segments_.back().end_index();
+	while ( runs_.back().first_index >= end_index ) {
+		runs_.pop_back();
+	}
+
+	// So do the recent arrivals (which would otherwise overlap whatever is stored there next)
+	size_t kept = 0;
+	for ( size_t i = 0; i < recent_count_; ++i ) {
+		if ( recent_[i].first_index < end_index ) {
+			recent_[kept] = recent_[i];
+			recent_[kept].end_index = min( recent_[kept].end_index, end_index );
+			++kept;
+		}
+	}
+	recent_count_ = kept;
+
+	// The last run may have lost its latest bytes
+	Run& run = runs_.back();
+	if ( run.end_index > end_index ) {
+		run.end_index = end_index;
+		run.arrival = trimmed_arrival( run );
+	}
+}
+
+/**
+ * @brief How recent a run is once it has been trimmed: the newest recent insert still in it.
+ *
+ * The segments cannot say (coalescing gives a merged segment the latest arrival of its parts, which
+ * may be bytes that have since been trimmed). A run no recent insert overlaps is older than all of
+ * them.
+ */
+uint32_t SegmentStore::trimmed_arrival( const Run& run ) const
+{
+	for ( size_t i = 0; i < recent_count_; ++i ) {
+		if ( recent_[i].first_index < run.end_index and run.first_index < recent_[i].end_index ) {
+			return recent_[i].arrival;
+		}
+	}
+
+	const auto begin = segments_.begin() + static_cast<ptrdiff_t>( head_ );
+	auto it = lower_bound( begin, segments_.end(), run.first_index, []( const Segment& s, uint64_t index ) {
+		return s.first_index < index;
+	} );
+
+	uint32_t arrival = 0;
+	for ( ; it != segments_.end() and it->first_index < run.end_index; ++it ) {
+		arrival = max( arrival, it->arrival );
+	}
+	return recent_count_ == 0 ? arrival : min( arrival, recent_[recent_count_ - 1].arrival - 1 );
+}
+
+/**
+ * @brief Copy each run of adjacent segments into a payload of its own, and free what they used.
+ *
+ * A segment on its own is copied too if its payload is all its own and mostly bytes it does not
+ * cover (which can happen once the segments that shared the payload have been written out).
+ */
+void SegmentStore::coalesce()
+{
+	auto out = segments_.begin() + static_cast<ptrdiff_t>( head_ );
+	for ( auto run = out; run != segments_.end(); ) {
+		auto run_end = next( run );
+		uint64_t length = run->length;
+		while ( run_end != segments_.end() and run_end->first_index == prev( run_end )->end_index() ) {
+			length += run_end->length;
+			++run_end;
+		}
+
+		const Payload& payload = payloads_[run->payload];
+		if ( run_end == next( run ) and ( payload.refs > 1 or heap_bytes( payload.data ) <= 2 * length ) ) {
+			*out++ = *run;
+			run = run_end;
+			continue;
+		}
+
+		string data;
+		data.reserve( length );
+		for ( auto it = run; it != run_end; ++it ) {
+			data.append( string_view { payloads_[it->payload].data }.substr( it->offset, it->length ) );
+		}
+		for ( auto it = run; it != run_end; ++it ) {
+			release_payload( it->payload );
+		}
+
+		const uint64_t first_index = run->first_index;
+		uint32_t arrival = 0;
+		for ( auto it = run; it != run_end; ++it ) {
+			arrival = max( arrival, it->arrival );
+		}
+		const uint32_t slot = add_payload( move( data ) );
+		payloads_[slot].refs = 1;
+		*out++ = { first_index, length, 0, slot, arrival };
+		run = run_end;
+	}
+
+	segments_.erase( out, segments_.end() );
+}
+
+uint32_t SegmentStore::add_payload( string&& data )
+{
+	payload_bytes_ += heap_bytes( data );
+	if ( free_payloads_.empty() ) {
+		payloads_.push_back( { move( data ), 0 } );
+		return payloads_.size() - 1;
+	}
+
+	const uint32_t payload = free_payloads_.back();
+	free_payloads_.pop_back();
+	payloads_[payload].data = move( data );
+	return payload;
+}
+
+void SegmentStore::release_payload( uint32_t payload )
+{
+	if ( --payloads_[payload].refs == 0 ) {
+		payload_bytes_ -= heap_bytes( payloads_[payload].data );
+		string {}.swap( payloads_[payload].data );
+		free_payloads_.push_back( payload );
+	}
+}
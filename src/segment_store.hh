@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ * The bytes a Reassembler is holding until the gap before them is filled.
+ *
+ * The store is a sorted, flat list of non-overlapping segments. Each segment is a range of the
+ * payload of the substring that supplied it, and payloads are reference-counted by the segments
+ * that use them, so substrings are not concatenated: inserting a substring only adds segments
+ * for the parts of it that fill gaps between what is already stored (and drops the rest). Finding
+ * where a substring goes is a binary search. Segments are small and trivially copyable, so making
+ * room for new ones is a single memmove.
+ *
+ * That makes the common case fast, but a substring that fills a small gap keeps its whole payload
+ * alive, and each segment costs its metadata, so many small fragments can take far more memory than
+ * the bytes they hold. The store can be given a limit on its segments, which bounds that: a payload
+ * whose segments use less than half of it is trimmed to those bytes as it is stored, and once an
+ * insert goes over the limit, runs of adjacent segments are copied into one compact payload each,
+ * and if that is not enough, the segments furthest from the front are dropped (they are the last
+ * ones the stream will need, and the sender will retransmit them).
+ *
+ * The runs of adjacent segments are kept alongside, merged as substrings arrive, so listing the most
+ * recent runs (for SACK blocks) looks up the last few arrivals instead of walking every segment.
+ */
+class SegmentStore
+{
+  public:
+	// A substring to store: `data` starts at `first_index` and is a view of `*payload`
+	struct Substring
+	{
+		uint64_t first_index;
+		std::string_view data;
+		std::string* payload;
+	};
+
+	// Store whichever bytes of `data` (which starts at `first_index`) are not stored already.
+	// `data` is a view of `payload`, which the store keeps if it needs any of those bytes.
+	void insert( uint64_t first_index, std::string_view data, std::string&& payload );
+
+	// Store whichever bytes of the substrings, sorted by first_index (and possibly overlapping each other),
+	// are not stored already. The store moves from the payloads whose bytes it keeps.
+	void insert_sorted( std::span<const Substring> substrings );
+
+	bool empty() const { return head_ == segments_.size(); }
+	uint64_t front_index() const { return segments_[head_].first_index; } // Index of the lowest stored byte
+	std::string_view front() const;										  // The segment starting there
+	void pop_front();													  // Forget the front segment
+
+	uint64_t bytes_stored() const { return bytes_stored_; } // Total length of the stored segments
+	size_t segment_count() const { return segments_.size() - head_; }
+	uint64_t memory_used() const; // Bytes of memory the store holds: segments, payloads, and bookkeeping
+
+	// Up to `max_ranges` runs of stored bytes, as [first_index, end_index), the most recently added first
+	std::vector<std::pair<uint64_t, uint64_t>> ranges( size_t max_ranges ) const;
+
+	// Keep at most `max_segments` segments (by default, there is no limit)
+	void set_max_segments( size_t max_segments );
+
+	// Forget every stored byte at or after `end_index`
+	void truncate( uint64_t end_index );
+
+  private:
+	static constexpr size_t kMinPoppedSegments = 64; // Popped segments worth compacting away
+
+	struct Segment
+	{
+		uint64_t first_index;
+		uint64_t length;
+		uint64_t offset;  // Where the segment starts in its payload
+		uint32_t payload; // Index into payloads_
+		uint32_t arrival; // When the segment was added (a count of inserts)
+
+		uint64_t end_index() const { return first_index + length; }
+	};
+
+	struct Payload
+	{
+		std::string data {};
+		uint32_t refs {}; // Number of segments using it
+	};
+
+	// Adjacent stored bytes, [first_index, end_index), as recent as the latest insert that stored some of them.
+	// (Also a recent insert: the bytes it covered, all of which it or an earlier one stored, and its arrival.)
+	struct Run
+	{
+		uint64_t first_index;
+		uint64_t end_index;
+		uint32_t arrival;
+	};
+
+	// Arrivals remembered to find the most recent runs by (enough for a SACK block per queued ack, and more)
+	static constexpr size_t kRecentArrivals = 32;
+
+	// The stored segments are segments_[head_] onwards, sorted by index
+	std::vector<Segment> segments_ {};
+	size_t head_ {};
+	uint64_t bytes_stored_ {};
+	size_t max_segments_ { std::numeric_limits<size_t>::max() };
+	uint32_t arrivals_ {}; // Number of inserts so far
+
+	// The runs are runs_[runs_head_] onwards, sorted by index
+	std::vector<Run> runs_ {};
+	size_t runs_head_ {};
+	std::array<Run, kRecentArrivals> recent_ {}; // The latest inserts that stored bytes (one per run), newest first
+	size_t recent_count_ {};
+
+	std::vector<Payload> payloads_ {};
+	std::vector<uint32_t> free_payloads_ {}; // Slots of payloads_ no segment uses
+	uint64_t payload_bytes_ {};				 // Heap memory held by the payloads in use
+
+	std::vector<Segment> gaps_ {}; // Scratch space for insert() and insert_sorted()
+
+	uint32_t add_payload( std::string&& data );
+	void release_payload( uint32_t payload );
+	void trim_payload( uint32_t slot, uint64_t bytes_used, std::span<Segment> segments );
+	void enforce_limit();
+	void coalesce();
+	void add_run( uint64_t first_index, uint64_t end_index, uint32_t arrival );
+	void trim_runs();
+	uint32_t trimmed_arrival( const Run& run ) const;
+};
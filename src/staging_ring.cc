@@ -0,0 +1,235 @@
+#include "staging_ring.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+constexpr uint64_t kWordBits = 64;
+
+// `count` one bits starting at bit `first` (count <= 64 - first)
+uint64_t bit_run( uint64_t first, uint64_t count )
+{
+	return ( count == kWordBits ? ~uint64_t {} : ( uint64_t { 1 } << count ) - 1 ) << first;
+}
+
+} // namespace
+
+/**
+ * @brief Copy a substring into the ring at its place in the stream, and mark its bytes present.
+ *
+ * Bytes that were already present are overwritten with the same values (a retransmission carries
+ * the same bytes), so only the bits that were newly set count towards bytes_stored().
+ *
+ * @param first_index The index of the first byte of the substring
+ * @param data The substring itself
+ */
+void StagingRing::insert( uint64_t first_index, string_view data )
+{
+	if ( data.empty() ) {
+		return;
+	}
+
+	if ( buffer_.size() == 0 ) {
+		buffer_ = RingBuffer { window_size_, RingBuffer::Kind::Heap };
+		present_.assign( std::max( buffer_.size() / kWordBits, uint64_t { 1 } ), 0 );
+	}
+
+	uint64_t index = first_index;
+	while ( not data.empty() ) {
+		const span<char> region = buffer_.region( index, data.size() );
+		memcpy( region.data(), data.data(), region.size() );
+		data.remove_prefix( region.size() );
+		index += region.size();
+	}
+
+	bytes_stored_ += set_present( first_index, index - first_index );
+	last_insert_index_ = first_index;
+}
+
+/**
+ * @brief Measure the run of present bytes starting at next_index().
+ *
+ * Each step looks at one word of the bitmap: the run continues through the word only if all of its
+ * remaining bits are set, so the scan stops at the first word with a hole in it.
+ */
+uint64_t StagingRing::contiguous_bytes() const
+{
+	if ( bytes_stored_ == 0 ) {
+		return 0;
+	}
+
+	const uint64_t mask = buffer_.mask();
+	uint64_t run = 0;
+	while ( run < bytes_stored_ ) {
+		const uint64_t pos = ( next_index_ + run ) & mask;
+		const uint64_t bit = pos % kWordBits;
+		const uint64_t limit = std::min( kWordBits - bit, buffer_.size() - pos );
+		const uint64_t present = present_[pos / kWordBits] >> bit;
+		const uint64_t ones = std::min( static_cast<uint64_t>( countr_one( present ) ), limit );
+		run += ones;
+		if ( ones < limit ) {
+			break;
+		}
+	}
+	return std::min( run, bytes_stored_ );
+}
+
+/**
+ * @brief List the runs of present bytes.
+ *
+ * The bitmap is scanned from next_index() a word at a time, counting ones or zeros with a single
+ * instruction, until every stored byte has been found.
+ *
+ * @param max_ranges The most runs to list
+ * @return The runs, each as [first_index, end_index)
+ */
+vector<pair<uint64_t, uint64_t>> StagingRing::ranges( size_t max_ranges ) const
+{
+	vector<pair<uint64_t, uint64_t>> runs;
+	const uint64_t mask = buffer_.mask();
+	uint64_t index = next_index_;
+	uint64_t found = 0;
+	while ( found < bytes_stored_ ) {
+		const uint64_t pos = index & mask;
+		const uint64_t bit = pos % kWordBits;
+		const uint64_t limit = std::min( kWordBits - bit, buffer_.size() - pos );
+		const uint64_t word = present_[pos / kWordBits] >> bit;
+
+		if ( word & 1U ) {
+			const uint64_t ones = std::min( static_cast<uint64_t>( countr_one( word ) ), limit );
+			if ( not runs.empty() and runs.back().second == index ) {
+				runs.back().second += ones;
+			} else {
+				runs.emplace_back( index, index + ones );
+			}
+			found += ones;
+			index += ones;
+		} else {
+			index += word == 0 ? limit : std::min( static_cast<uint64_t>( countr_zero( word ) ), limit );
+		}
+	}
+
+	// The run with the most recent insert goes first
+	const auto recent = ranges::find_if( runs, [&]( const auto& run ) {
+		return run.first <= last_insert_index_ and last_insert_index_ < run.second;
+	} );
+	if ( recent != runs.end() ) {
+		rotate( runs.begin(), recent, next( recent ) );
+	}
+
+	runs.resize( std::min( runs.size(), max_ranges ) );
+	return runs;
+}
+
+/**
+ * @brief Clear the presence of every byte from `end_index` to the end of the window.
+ */
+void StagingRing::truncate( uint64_t end_index )
+{
+	const uint64_t first = std::max( end_index, next_index_ );
+	const uint64_t ring_end = next_index_ + buffer_.size();
+	if ( bytes_stored_ > 0 and first < ring_end ) {
+		bytes_stored_ -= clear_present( first, ring_end - first );
+	}
+}
+
+/**
+ * @brief Change the window size, moving the stored bytes into a ring of the new size.
+ *
+ * A ring that holds nothing is freed (the next insert allocates one of the new size). Otherwise, if
+ * the ring's size has to change, the runs of present bytes that fit in the new window are copied
+ * into a new ring, at the same indices.
+ *
+ * @param window_size The new window size
+ */
+void StagingRing::resize( uint64_t window_size )
+{
+	window_size_ = window_size;
+	if ( bytes_stored_ == 0 ) {
+		buffer_ = RingBuffer { RingBuffer::Kind::Heap };
+		vector<uint64_t> {}.swap( present_ );
+		return;
+	}
+
+	if ( bit_ceil( std::max( window_size, uint64_t { 1 } ) ) == buffer_.size() ) {
+		return;
+	}
+
+	StagingRing resized { window_size };
+	resized.next_index_ = next_index_;
+	const uint64_t window_end = next_index_ + window_size;
+	for ( auto [index, end_index] : ranges( numeric_limits<size_t>::max() ) ) {
+		end_index = std::min( end_index, window_end );
+		while ( index < end_index ) {
+			const string_view region = as_const( buffer_ ).region( index, end_index - index );
+			resized.insert( index, region );
+			index += region.size();
+		}
+	}
+	resized.last_insert_index_ = last_insert_index_;
+	*this = std::move( resized );
+}
+
+string_view StagingRing::front( uint64_t len ) const
+{
+	return buffer_.region( next_index_, len );
+}
+
+/**
+ * @brief Move next_index() forward, clearing the presence of the bytes it passes over.
+ * @param index The new next_index() (ignored if it is not ahead of the current one)
+ */
+void StagingRing::advance_to( uint64_t index )
+{
+	if ( index <= next_index_ ) {
+		return;
+	}
+
+	if ( bytes_stored_ > 0 ) {
+		bytes_stored_ -= clear_present( next_index_, std::min( index - next_index_, buffer_.size() ) );
+	}
+	next_index_ = index;
+}
+
+uint64_t StagingRing::set_present( uint64_t index, uint64_t len )
+{
+	const uint64_t mask = buffer_.mask();
+	uint64_t newly_set = 0;
+	while ( len > 0 ) {
+		const uint64_t pos = index & mask;
+		const uint64_t bit = pos % kWordBits;
+		const uint64_t count = std::min( { len, kWordBits - bit, buffer_.size() - pos } );
+		const uint64_t run = bit_run( bit, count );
+		uint64_t& word = present_[pos / kWordBits];
+		newly_set += popcount( run & ~word );
+		word |= run;
+		index += count;
+		len -= count;
+	}
+	return newly_set;
+}
+
+uint64_t StagingRing::clear_present( uint64_t index, uint64_t len )
+{
+	const uint64_t mask = buffer_.mask();
+	uint64_t cleared = 0;
+	while ( len > 0 ) {
+		const uint64_t pos = index & mask;
+		const uint64_t bit = pos % kWordBits;
+		const uint64_t count = std::min( { len, kWordBits - bit, buffer_.size() - pos } );
+		const uint64_t run = bit_run( bit, count );
+		uint64_t& word = present_[pos / kWordBits];
+		cleared += popcount( run & word );
+		word &= ~run;
+		index += count;
+		len -= count;
+	}
+	return cleared;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ring_buffer.hh"
+
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ * The bytes a Reassembler is holding until the gap before them is filled, kept at their place in
+ * the stream: byte `i` lives at offset `i & mask` of a ring with room for the whole window, and a
+ * bitmap (one bit per byte of the ring) says which bytes are present.
+ *
+ * Storing a substring is a memcpy and setting a run of bits; finding how much can be written out is
+ * a scan of the bitmap a word (64 bytes of the stream) at a time. Memory is fixed at the window size
+ * plus an eighth, no matter how the bytes arrive. Nothing is allocated until the first byte is stored.
+ */
+class StagingRing
+{
+  public:
+	explicit StagingRing( uint64_t window_size ) : window_size_( window_size ) {}
+
+	// Store `data`, which starts at `first_index` and must lie within [next_index(), next_index() + window_size)
+	void insert( uint64_t first_index, std::string_view data );
+
+	uint64_t next_index() const { return next_index_; } // Index of the first byte not yet written out
+	uint64_t contiguous_bytes() const;					// Number of bytes present from next_index() on
+	std::string_view front( uint64_t len ) const;		// Up to `len` of them, as far as the end of the ring
+	void advance_to( uint64_t index );					// Forget every byte before `index`
+
+	void truncate( uint64_t end_index ); // Forget every byte at or after `end_index`
+	void resize( uint64_t window_size ); // Change the window size, keeping the bytes that still fit in it
+
+	uint64_t bytes_stored() const { return bytes_stored_; } // Number of bytes present
+	uint64_t memory_used() const { return buffer_.size() + present_.capacity() * sizeof( uint64_t ); }
+
+	// Up to `max_ranges` runs of present bytes, as [first_index, end_index): the run holding the most
+	// recently inserted byte first, then the others in order
+	std::vector<std::pair<uint64_t, uint64_t>> ranges( size_t max_ranges ) const;
+
+  private:
+	uint64_t window_size_;
+	uint64_t next_index_ {};
+	uint64_t bytes_stored_ {};
+	uint64_t last_insert_index_ {}; // Index of the first byte of the most recent insert
+
+	RingBuffer buffer_ { RingBuffer::Kind::Heap };
+	std::vector<uint64_t> present_ {}; // Bit (i & mask) is set when byte i is stored
+
+	uint64_t set_present( uint64_t index, uint64_t len );	// Returns how many bits were newly set
+	uint64_t clear_present( uint64_t index, uint64_t len ); // Returns how many bits were cleared
+};
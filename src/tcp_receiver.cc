@@ -1,13 +1,36 @@
 #include "tcp_receiver.hh"
+#include "debug.hh"
 #include "tcp_receiver_message.hh"
 #include "wrapping_integers.hh"
 #include <algorithm>
 #include <cstdint>
 #include <limits>
+#include <optional>
+#include <span>
 #include <sys/types.h>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
+TCPReceiver::TCPReceiver( Reassembler&& reassembler, const TCPConfig& config )
+  : reassembler_( std::move( reassembler ) )
+  , offered_window_scale_( std::min( config.recv_window_scale, TCPConfig::MAX_WINDOW_SCALE ) )
+  , ack_delay_ms_( config.ack_delay )
+  , min_capacity_( reassembler_.writer().capacity() )
+  , max_capacity_( config.recv_capacity_max )
+{}
+
+/**
+ * @brief Decide on window scaling (RFC 7323) from the SYN: windows are scaled only if both sides support it.
+ */
+void TCPReceiver::negotiate_window_scale( const TCPSenderMessage& syn )
+{
+	if ( syn.window_scale.has_value() ) {
+		window_scale_ = offered_window_scale_;
+	}
+}
+
 void TCPReceiver::receive( TCPSenderMessage message )
 {
 	if ( message.RST ) {
@@ -18,6 +41,7 @@ void TCPReceiver::receive( TCPSenderMessage message )
 	if ( message.SYN && !ISN_.has_value() ) {
 		ISN_ = message.seqno;
 		FIN_ = false;
+		negotiate_window_scale( message );
 	}
 
 	if ( message.FIN ) {
@@ -27,18 +51,10 @@ void TCPReceiver::receive( TCPSenderMessage message )
 	if ( !ISN_.has_value() ) {
 		return;
 	}
+	syn_acked_ |= not message.SYN;
 
-	/*debug( "reassembler_.writer().bytes_pushed()={}\n,reassembler_.get_FIN={}\n,reassembler_.get_SYN={}\n,
-	 * ISN_={}",*/
-	/*	   reassembler_.writer().bytes_pushed(),*/
-	/*	   reassembler_.get_FIN(),*/
-	/*	   reassembler_.get_SYN(),*/
-	/*	   ISN_->raw_value() );*/
-	/*uint64_t first_index = ISN_->unwrap(*/
-	/*  *ISN_, reassembler_.writer().bytes_pushed() + reassembler_.get_FIN() + reassembler_.get_SYN() );*/
-	/**/
-	/*reassembler_.insert( first_index, message.payload, message.FIN );*/
 	uint64_t abs_seqno = message.seqno.unwrap( *ISN_, checkpoint_ );
+	trace<TraceCategory::Receiver>( "receive", abs_seqno, message.payload.size() );
 
 	uint64_t stream_index;
 
@@ -48,11 +64,142 @@ void TCPReceiver::receive( TCPSenderMessage message )
 		stream_index = abs_seqno - 1;
 	}
 
-	reassembler_.insert( stream_index, message.payload, message.FIN );
-	checkpoint_ = abs_seqno + message.payload.size();
+	const uint64_t next_index = reassembler_.writer().bytes_pushed();
+	const bool had_gap = reassembler_.count_bytes_pending() > 0;
+	const uint64_t payload_size = message.payload.size();
+	const uint64_t sequence_length = message.sequence_length();
+	const bool full_segment = payload_size >= TCPConfig::MAX_PAYLOAD_SIZE;
+
+	reassembler_.insert( stream_index, std::move( message.payload ), message.FIN );
+	checkpoint_ = abs_seqno + payload_size;
+
+	if ( payload_size > 0 ) {
+		note_arrival();
+	}
+
+	// A segment that occupies no sequence numbers is owed an ack only if it is out of place
+	if ( sequence_length > 0 or stream_index != next_index ) {
+		owe_ack( stream_index != next_index or had_gap,
+				 message.SYN or message.FIN,
+				 full_segment ? 1 : 0,
+				 stream_index,
+				 stream_index + payload_size );
+	}
+}
+
+/**
+ * @brief Receive a batch of messages, such as everything read from a socket at once.
+ *
+ * Each message is handled as receive() would (a reset sets the error, a SYN sets the ISN, and the
+ * sequence number is unwrapped against the end of the message before it), but the payloads are
+ * inserted into the Reassembler together, with a single insert_batch(). The batch is acknowledged
+ * as one arrival (of its last message): it owes at most one ack, which is immediate if any of it was
+ * out of order.
+ *
+ * @param messages The messages, in the order they arrived (their payloads are moved from)
+ */
+void TCPReceiver::receive_batch( span<TCPSenderMessage> messages )
+{
+	vector<Reassembler::Segment> segments;
+	segments.reserve( messages.size() );
+
+	const uint64_t next_index = reassembler_.writer().bytes_pushed();
+	uint64_t expected_index = next_index;
+	bool out_of_order = reassembler_.count_bytes_pending() > 0;
+	bool control = false;
+	bool ack_owed = false;
+	uint64_t full_segments = 0;
+	uint64_t arrival_first = 0;
+	uint64_t arrival_end = 0;
+
+	for ( TCPSenderMessage& message : messages ) {
+		if ( message.RST ) {
+			reassembler_.set_error();
+			continue;
+		}
+
+		if ( message.SYN && !ISN_.has_value() ) {
+			ISN_ = message.seqno;
+			FIN_ = false;
+			negotiate_window_scale( message );
+		}
+
+		if ( message.FIN ) {
+			FIN_ = true;
+		}
+
+		if ( !ISN_.has_value() ) {
+			continue;
+		}
+		syn_acked_ |= not message.SYN;
+
+		const uint64_t abs_seqno = message.seqno.unwrap( *ISN_, checkpoint_ );
+		trace<TraceCategory::Receiver>( "receive", abs_seqno, message.payload.size() );
+		const uint64_t stream_index = message.SYN ? 0 : abs_seqno - 1;
+		checkpoint_ = abs_seqno + message.payload.size();
+
+		ack_owed |= message.sequence_length() > 0 or stream_index != expected_index;
+		out_of_order |= stream_index != expected_index;
+		control |= message.SYN or message.FIN;
+		full_segments += message.payload.size() >= TCPConfig::MAX_PAYLOAD_SIZE ? 1 : 0;
+		if ( stream_index == expected_index ) {
+			expected_index += message.payload.size();
+		}
+		arrival_first = stream_index;
+		arrival_end = stream_index + message.payload.size();
+
+		segments.push_back( { stream_index, std::move( message.payload ), message.FIN } );
+	}
+
+	const bool data_arrived = ranges::any_of( segments, []( const auto& s ) { return not s.data.empty(); } );
+	reassembler_.insert_batch( segments );
+
+	if ( data_arrived ) {
+		note_arrival();
+	}
+
+	if ( ack_owed ) {
+		owe_ack( out_of_order, control, full_segments, arrival_first, arrival_end );
+	}
+}
+
+/**
+ * @brief Build an ack to send now, recording the window it advertises so that shrinking the capacity never
+ * takes it back.
+ */
+TCPReceiverMessage TCPReceiver::send()
+{
+	advertised_right_edge_ = std::max( advertised_right_edge_, window_right_edge() );
+	return std::as_const( *this ).send();
 }
 
 TCPReceiverMessage TCPReceiver::send() const
+{
+	if ( not ISN_.has_value() ) {
+		return make_ack( nullopt, {} );
+	}
+	return make_ack( OwedAck { absolute_ackno(), 0, 0 },
+					 reassembler_.pending_ranges( TCPReceiverMessage::MAX_SACK_BLOCKS ) );
+}
+
+/**
+ * @brief The absolute sequence number of the next byte the receiver needs (counting the SYN, and the FIN once
+ * the stream is closed).
+ */
+uint64_t TCPReceiver::absolute_ackno() const
+{
+	return reassembler_.writer().bytes_pushed() + 1 + ( FIN_ and reassembler_.writer().is_closed() ? 1 : 0 );
+}
+
+/**
+ * @brief Build an ack from what it acknowledges and the receiver's state now.
+ *
+ * @param ack The ackno and the arrival acknowledged (or none, before the SYN)
+ * @param pending The pending ranges, most recent first: the SACK blocks are chosen from these. The one with
+ * the bytes whose arrival this acknowledges goes first (RFC 2018), followed by the most recent others.
+ */
+TCPReceiverMessage TCPReceiver::make_ack( const optional<OwedAck>& ack,
+										  span<const pair<uint64_t, uint64_t>> pending ) const
 {
 	TCPReceiverMessage message;
 
@@ -60,15 +207,267 @@ TCPReceiverMessage TCPReceiver::send() const
 		message.RST = true;
 	}
 
-	if ( ISN_.has_value() ) {
-		uint64_t ackno = reassembler_.writer().bytes_pushed() + 1;
-		if ( FIN_ && reassembler_.writer().is_closed() ) {
-			ackno += 1;
+	if ( ack.has_value() ) {
+		message.ackno = Wrap32::wrap( ack->ackno, *ISN_ );
+
+		// Stream index i is absolute sequence number i + 1 (after the SYN)
+		const auto add_block = [&]( const pair<uint64_t, uint64_t>& range ) {
+			message.sack_blocks.push_back(
+			  { Wrap32::wrap( range.first + 1, *ISN_ ), Wrap32::wrap( range.second + 1, *ISN_ ) } );
+		};
+		const auto arrived = std::ranges::find_if( pending, [&]( const auto& range ) {
+			return range.first < ack->end_index and ack->first_index < range.second;
+		} );
+		if ( arrived != pending.end() ) {
+			add_block( *arrived );
+		}
+		for ( auto it = pending.begin();
+			  it != pending.end() and message.sack_blocks.size() < TCPReceiverMessage::MAX_SACK_BLOCKS;
+			  ++it ) {
+			if ( it != arrived ) {
+				add_block( *it );
+			}
 		}
-		message.ackno = Wrap32::wrap( ackno, *ISN_ );
 	}
 
-	message.window_size = std::min( reassembler_.writer().available_capacity(),
+	// With window scaling, the window is advertised in units of 2^shift bytes (rounded down), except on the
+	// SYN-ACK (RFC 7323 section 2.2): until the peer's next segment shows it has that, the window is unscaled
+	const uint8_t shift = window_shift();
+	message.window_size = std::min( reassembler_.writer().available_capacity() >> shift,
 									static_cast<uint64_t>( std::numeric_limits<uint16_t>::max() ) );
+	message.window_scale = window_scale_;
+	message.syn_ack = window_scale_.has_value() and not syn_acked_;
 	return message;
 }
+
+/**
+ * @brief The end of the window that send() would advertise, as a stream index.
+ */
+uint64_t TCPReceiver::window_right_edge() const
+{
+	const uint8_t shift = window_shift();
+	const uint64_t window_size = std::min( reassembler_.writer().available_capacity() >> shift,
+										   static_cast<uint64_t>( std::numeric_limits<uint16_t>::max() ) );
+	return reassembler_.writer().bytes_pushed() + ( window_size << shift );
+}
+
+/**
+ * @brief Record that an ack is owed for the receiver's state now, and stop holding back the delayed ack.
+ *
+ * Only the ackno and the arrival are recorded; drain_acks() builds the message. An ack that only
+ * advances the ackno is superseded by a later one, so it is replaced rather than followed by the next
+ * such ack. Other acks (for out-of-order data, whose duplicates the sender counts) are each kept, up to
+ * MAX_QUEUED_ACKS.
+ *
+ * @param coalescible Whether this ack may be replaced by a later one
+ * @param first_index The start of the arrival it acknowledges
+ * @param end_index The end of the arrival (the same as first_index if there is none)
+ */
+void TCPReceiver::queue_ack( bool coalescible, uint64_t first_index, uint64_t end_index )
+{
+	const OwedAck ack { absolute_ackno(), first_index, end_index };
+
+	if ( not acks_queued_.empty()
+		 and ( ( coalescible and last_ack_coalescible_ ) or acks_queued_.size() >= MAX_QUEUED_ACKS ) ) {
+		acks_queued_.back() = ack;
+	} else {
+		acks_queued_.push_back( ack );
+	}
+	trace<TraceCategory::Receiver>( "ack", reassembler_.writer().bytes_pushed(), acks_queued_.size() );
+
+	last_ack_coalescible_ = coalescible;
+	ack_delayed_ = false;
+	ms_ack_delayed_ = 0;
+	full_segments_unacked_ = 0;
+}
+
+/**
+ * @brief Apply the ack policy to an arrival: ack now, or hold the ack back.
+ *
+ * @param out_of_order Whether the arrival was not the next data expected, or there was a gap to fill
+ * @param control Whether the arrival carried a SYN or FIN
+ * @param full_segments How many full-sized segments arrived
+ * @param first_index The stream index the arrival started at
+ * @param end_index The end of the arrival
+ */
+void TCPReceiver::owe_ack(
+  bool out_of_order, bool control, uint64_t full_segments, uint64_t first_index, uint64_t end_index )
+{
+	full_segments_unacked_ += full_segments;
+
+	if ( out_of_order or control or full_segments_unacked_ >= 2 or ack_delay_ms_ == 0 ) {
+		queue_ack( not out_of_order, first_index, end_index );
+	} else if ( not ack_delayed_ ) {
+		ack_delayed_ = true;
+		ms_ack_delayed_ = 0;
+	}
+}
+
+/**
+ * @brief Build and transmit every ack owed now, oldest first.
+ *
+ * The newest ack, if it only advances the ackno, is brought up to date first (covering any delayed
+ * ack), since more data may have arrived since it was queued. If no ack is owed but the window has
+ * opened by two full-sized segments (or half the capacity, if that is less) since the last ack, a
+ * window update is owed instead. Each ack carries the window as it is now, and SACK blocks from a
+ * single look at the pending ranges.
+ *
+ * @param transmit Called with each ack
+ */
+void TCPReceiver::drain_acks( const TransmitFunction& transmit )
+{
+	if ( shrinking_ ) {
+		shrink_capacity();
+	}
+
+	if ( not acks_queued_.empty() and last_ack_coalescible_ ) {
+		const OwedAck newest = acks_queued_.back();
+		queue_ack( true, newest.first_index, newest.end_index );
+	}
+
+	if ( acks_queued_.empty() and ISN_.has_value() ) {
+		const uint64_t threshold = std::max<uint64_t>(
+		  1, std::min<uint64_t>( 2 * TCPConfig::MAX_PAYLOAD_SIZE, reassembler_.writer().capacity() / 2 ) );
+		if ( window_right_edge() >= advertised_right_edge_ + threshold ) {
+			queue_ack( true, 0, 0 );
+		}
+	}
+
+	if ( acks_queued_.empty() ) {
+		return;
+	}
+
+	// Each ack's own arrival is among the most recent ranges, unless later acks' arrivals are more recent
+	const auto pending
+	  = reassembler_.pending_ranges( TCPReceiverMessage::MAX_SACK_BLOCKS - 1 + acks_queued_.size() );
+	for ( const OwedAck& ack : acks_queued_ ) {
+		transmit( make_ack( ack, pending ) );
+	}
+	acks_queued_.clear();
+	advertised_right_edge_ = window_right_edge();
+
+	// Time how long the sender takes to fill the window these acks open
+	if ( max_capacity_ > min_capacity_ and not rtt_mark_index_.has_value()
+		 and advertised_right_edge_ > reassembler_.writer().bytes_pushed() ) {
+		rtt_mark_index_ = advertised_right_edge_;
+		rtt_mark_ms_ = now_ms_;
+	}
+}
+
+/**
+ * @brief Advance the delayed-ack timer, then transmit every ack owed.
+ *
+ * @param ms_since_last_tick Milliseconds since the last call to tick()
+ * @param transmit Called with each ack
+ */
+void TCPReceiver::tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit )
+{
+	autotune( ms_since_last_tick );
+
+	if ( ack_delayed_ ) {
+		ms_ack_delayed_ += ms_since_last_tick;
+		if ( ms_ack_delayed_ >= ack_delay_ms_ ) {
+			queue_ack( true, 0, 0 );
+		}
+	}
+
+	drain_acks( transmit );
+}
+
+/**
+ * @brief Take an RTT sample if data has reached the end of the window an earlier ack opened.
+ *
+ * A sender limited by the window sends the next window's worth one round trip after hearing of it, so
+ * the time from the ack to the arrival of the byte at its window's end approximates the RTT (as in
+ * Linux's receiver-side RTT estimate). Samples shorter than the tick resolution are discarded.
+ */
+void TCPReceiver::note_arrival()
+{
+	ms_idle_ = 0;
+	if ( not rtt_mark_index_.has_value() or reassembler_.writer().bytes_pushed() < *rtt_mark_index_ ) {
+		return;
+	}
+
+	const uint64_t sample = now_ms_ - rtt_mark_ms_;
+	if ( sample > 0 ) {
+		rtt_ms_ = rtt_ms_ == 0 ? sample : ( 7 * rtt_ms_ + sample ) / 8;
+		trace<TraceCategory::Receiver>( "rtt", sample, rtt_ms_ );
+	}
+	rtt_mark_index_.reset();
+}
+
+/**
+ * @brief Grow the stream's capacity if the window is what limits throughput, or start shrinking it when idle.
+ *
+ * Once per estimated RTT, measure how much the application read during it. If that is more than half
+ * the capacity, the sender is probably waiting on the window, so the capacity grows to twice the
+ * amount (so the window is not the limit even if the rate doubles), capped by recv_capacity_max and
+ * by the largest window the negotiated scale can advertise. Growing stops any shrinking under way.
+ *
+ * @param ms_since_last_tick Milliseconds since the last call to tick()
+ */
+void TCPReceiver::autotune( uint64_t ms_since_last_tick )
+{
+	now_ms_ += ms_since_last_tick;
+	ms_idle_ += ms_since_last_tick;
+	if ( max_capacity_ <= min_capacity_ ) {
+		return;
+	}
+
+	const uint64_t capacity = reassembler_.writer().capacity();
+	const uint64_t popped = reassembler_.reader().bytes_popped();
+
+	if ( ms_idle_ >= IDLE_SHRINK_MS and capacity > min_capacity_ and not shrinking_ ) {
+		shrinking_ = true;
+		rtt_mark_index_.reset();
+		space_start_ms_ = now_ms_;
+		space_start_popped_ = popped;
+		return;
+	}
+
+	const uint64_t elapsed = now_ms_ - space_start_ms_;
+	if ( rtt_ms_ == 0 or elapsed < rtt_ms_ ) {
+		return;
+	}
+
+	const uint64_t read_per_rtt = ( popped - space_start_popped_ ) * rtt_ms_ / elapsed;
+	space_start_ms_ = now_ms_;
+	space_start_popped_ = popped;
+
+	const uint64_t largest_window = uint64_t { numeric_limits<uint16_t>::max() } << window_scale_.value_or( 0 );
+	const uint64_t target = std::min( { 2 * read_per_rtt, max_capacity_, std::max( largest_window, capacity ) } );
+	if ( 2 * read_per_rtt > capacity and target > capacity ) {
+		reassembler_.set_capacity( target );
+		shrinking_ = false;
+		trace<TraceCategory::Receiver>( "grow", capacity, target );
+	}
+}
+
+/**
+ * @brief Shrink the stream's capacity toward min_capacity_, as far as the window already advertised allows.
+ *
+ * The right edge of the window (bytes read plus the capacity) must not move back, so the capacity only
+ * goes down as the application reads. Nothing happens while the Reassembler holds pending data, which
+ * a smaller capacity could discard. Once the capacity is back to min_capacity_, the stream's memory is
+ * released and shrinking is done.
+ */
+void TCPReceiver::shrink_capacity()
+{
+	if ( reassembler_.count_bytes_pending() > 0 ) {
+		return;
+	}
+
+	const uint64_t capacity = reassembler_.writer().capacity();
+	const uint64_t popped = reassembler_.reader().bytes_popped();
+	const uint64_t advertised = advertised_right_edge_ > popped ? advertised_right_edge_ - popped : 0;
+	const uint64_t target = std::max( min_capacity_, advertised );
+	if ( target < capacity ) {
+		reassembler_.set_capacity( target );
+		trace<TraceCategory::Receiver>( "shrink", capacity, target );
+	}
+
+	if ( target <= min_capacity_ ) {
+		reassembler_.reader().shrink_to_fit();
+		shrinking_ = false;
+	}
+}
@@ -1,11 +1,16 @@
 #pragma once
 
 #include "reassembler.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 #include "wrapping_integers.hh"
+#include <functional>
 #include <optional>
+#include <span>
 #include <sys/types.h>
+#include <utility>
+#include <vector>
 
 class TCPReceiver
 {
@@ -13,15 +18,51 @@ class TCPReceiver
 	// Construct with given Reassembler
 	explicit TCPReceiver( Reassembler&& reassembler ) : reassembler_( std::move( reassembler ) ) {}
 
+	// Construct with given Reassembler, using the window scale in `config` if the peer supports it
+	TCPReceiver( Reassembler&& reassembler, const TCPConfig& config );
+
 	/*
 	 * The TCPReceiver receives TCPSenderMessages, inserting their payload into the Reassembler
 	 * at the correct stream index.
 	 */
 	void receive( TCPSenderMessage message );
 
-	// The TCPReceiver sends TCPReceiverMessages to the peer's TCPSender.
+	// Receive several messages at once, with the same result as receiving each of them in turn.
+	// The payloads are moved out of the messages.
+	void receive_batch( std::span<TCPSenderMessage> messages );
+
+	// The TCPReceiver sends TCPReceiverMessages to the peer's TCPSender. Sending records the window the
+	// message advertises, which auto-tuning must not take back; the const overload only inspects the receiver.
+	TCPReceiverMessage send();
 	TCPReceiverMessage send() const;
 
+	/*
+	 * Instead of calling send() after every receive(), a caller can let the TCPReceiver decide when an
+	 * ack is owed (delayed acks, as in RFC 1122 and RFC 5681). It acks every second full-sized segment,
+	 * acks at once on out-of-order data, a SYN or FIN, or a window update, and otherwise holds the ack
+	 * back for at most the configured ack delay.
+	 */
+	using TransmitFunction = std::function<void( const TCPReceiverMessage& )>;
+
+	// Send every ack owed now, in one batch.
+	void drain_acks( const TransmitFunction& transmit );
+
+	// Time has passed: send the delayed ack if it has waited for the ack delay, along with any owed now.
+	void tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit );
+
+	// Is an ack being held back, waiting for another segment or the timer?
+	bool ack_delayed() const { return ack_delayed_; }
+
+	/*
+	 * Receive-buffer auto-tuning (when TCPConfig::recv_capacity_max is more than recv_capacity): tick()
+	 * also estimates the round-trip time from how long the sender takes to fill each window, and how fast
+	 * the application reads. When the application reads most of a window every round trip, the window is
+	 * what limits throughput, so the stream's capacity grows to twice that (up to recv_capacity_max).
+	 * After the connection has been idle for a while, it shrinks back to recv_capacity, but without taking
+	 * back any window already advertised: the window closes as the data it allows for arrives and is read.
+	 */
+	uint64_t rtt_estimate_ms() const { return rtt_ms_; } // Zero until measured
+
 	// Access the output
 	const Reassembler& reassembler() const { return reassembler_; }
 	Reader& reader() { return reassembler_.reader(); }
@@ -34,4 +75,54 @@ class TCPReceiver
 	std::optional<Wrap32> ISN_ {};
 	uint64_t checkpoint_ {};
 	bool FIN_ {};
+
+	uint8_t offered_window_scale_ {};		 // The shift to use, if the peer's SYN asks for scaling
+	std::optional<uint8_t> window_scale_ {}; // The shift in use, once negotiated
+	bool syn_acked_ {};						 // Has the peer sent anything after its SYN (so it has our SYN-ACK)?
+
+	void negotiate_window_scale( const TCPSenderMessage& syn );
+	uint8_t window_shift() const { return syn_acked_ ? window_scale_.value_or( 0 ) : 0; }
+
+	static constexpr size_t MAX_QUEUED_ACKS = 16; // Beyond this, a new ack replaces the newest one queued
+
+	// An ack owed: its ackno (an absolute sequence number) and the stream indices [first_index, end_index)
+	// whose arrival it acknowledges. The rest (window and SACK blocks) is filled in when it is sent.
+	struct OwedAck
+	{
+		uint64_t ackno;
+		uint64_t first_index;
+		uint64_t end_index;
+	};
+
+	uint64_t ack_delay_ms_ { TCPConfig::ACK_DELAY_DFLT };
+	std::vector<OwedAck> acks_queued_ {}; // Acks owed now, oldest first
+	bool last_ack_coalescible_ {};		  // Does the newest queued ack only advance the ackno?
+	bool ack_delayed_ {};
+	uint64_t ms_ack_delayed_ {};		  // How long the delayed ack has waited
+	uint64_t full_segments_unacked_ {};	  // Full-sized segments received since the last ack
+	uint64_t advertised_right_edge_ {};	  // The end of the furthest window advertised (a stream index)
+
+	static constexpr uint64_t IDLE_SHRINK_MS = 1000; // Idle time after which an auto-tuned capacity shrinks
+
+	uint64_t min_capacity_ {};					// The configured capacity, which auto-tuning starts from
+	uint64_t max_capacity_ {};					// The most auto-tuning may grow it to
+	uint64_t now_ms_ {};						// Time, as advanced by tick()
+	uint64_t ms_idle_ {};						// Time since data last arrived
+	bool shrinking_ {};							// Is the capacity going back to min_capacity_ after idling?
+	uint64_t rtt_ms_ {};						// Smoothed round-trip time estimate
+	std::optional<uint64_t> rtt_mark_index_ {}; // The RTT sample ends when the stream reaches this index
+	uint64_t rtt_mark_ms_ {};					// ... and began at this time
+	uint64_t space_start_ms_ {};				// When the current measurement of the read rate began
+	uint64_t space_start_popped_ {};			// ... and how much the application had read then
+
+	void note_arrival();
+	void autotune( uint64_t ms_since_last_tick );
+	void shrink_capacity();
+	void queue_ack( bool coalescible, uint64_t first_index, uint64_t end_index );
+	void owe_ack(
+	  bool out_of_order, bool control, uint64_t full_segments, uint64_t first_index, uint64_t end_index );
+	uint64_t absolute_ackno() const;
+	TCPReceiverMessage make_ack( const std::optional<OwedAck>& ack,
+								 std::span<const std::pair<uint64_t, uint64_t>> ranges ) const;
+	uint64_t window_right_edge() const;
 };
@@ -1,20 +1,27 @@
 #pragma once
 
+#include <compare>
 #include <cstdint>
+#include <span>
 
 /*
  * The Wrap32 type represents a 32-bit unsigned integer that:
  *    - starts at an arbitrary "zero point" (initial value), and
  *    - wraps back to zero when it reaches 2^32 - 1.
+ *
+ * Everything except unwrap_many() is constexpr, so sequence numbers can be computed and checked at compile time.
  */
 
 class Wrap32
 {
   public:
-	explicit Wrap32( uint32_t raw_value ) : raw_value_( raw_value ) {}
+	constexpr explicit Wrap32( uint32_t raw_value ) : raw_value_( raw_value ) {}
 
 	/* Construct a Wrap32 given an absolute sequence number n and the zero point. */
-	static Wrap32 wrap( uint64_t n, Wrap32 zero_point );
+	static constexpr Wrap32 wrap( uint64_t n, Wrap32 zero_point )
+	{
+		return zero_point + static_cast<uint32_t>( n );
+	}
 
 	/*
 	 * The unwrap method returns an absolute sequence number that wraps to this Wrap32, given the zero point
@@ -23,10 +30,59 @@ class Wrap32
 	 * There are many possible absolute sequence numbers that all wrap to the same Wrap32.
 	 * The unwrap method should return the one that is closest to the checkpoint.
 	 */
-	uint64_t unwrap( Wrap32 zero_point, uint64_t checkpoint ) const;
+	constexpr uint64_t unwrap( Wrap32 zero_point, uint64_t checkpoint ) const
+	{
+		// Fold the distance from the checkpoint's low bits into [-2^31, 2^31] without branching. A distance of
+		// exactly 2^31 stays on whichever side it started, and an answer below zero moves up a wrap instead.
+		constexpr int64_t half_wrap = int64_t { 1 } << 31;
+		constexpr int64_t wrap = int64_t { 1 } << 32;
+		const uint32_t offset = raw_value_ - zero_point.raw_value_;
 
-	Wrap32 operator+( uint32_t n ) const { return Wrap32 { raw_value_ + n }; }
-	bool operator==( const Wrap32& other ) const { return raw_value_ == other.raw_value_; }
+		int64_t distance = int64_t { offset } - int64_t { static_cast<uint32_t>( checkpoint ) };
+		distance -= static_cast<int64_t>( distance > half_wrap ) * wrap;
+		distance += static_cast<int64_t>( distance < -half_wrap ) * wrap;
+
+		uint64_t result = checkpoint + static_cast<uint64_t>( distance );
+		result += static_cast<uint64_t>( distance < 0 && result > checkpoint ) * wrap;
+		return result;
+	}
+
+	/*
+	 * Unwrap many sequence numbers against the same zero point and checkpoint, writing the unwrapped value of
+	 * seqnos[i] to out[i]. Uses AVX2 where the CPU supports it. `out` must be at least as long as `seqnos`.
+	 */
+	static void unwrap_many( std::span<const Wrap32> seqnos,
+							 Wrap32 zero_point,
+							 uint64_t checkpoint,
+							 std::span<uint64_t> out );
+
+	constexpr Wrap32 operator+( uint32_t n ) const { return Wrap32 { raw_value_ + n }; }
+	constexpr bool operator==( const Wrap32& other ) const { return raw_value_ == other.raw_value_; }
+
+	/*
+	 * The signed distance from `other` to this Wrap32, going whichever way around is shorter
+	 * (so `other + ( *this - other ) == *this`). Two Wrap32s exactly 2^31 apart are INT32_MIN apart.
+	 */
+	constexpr int32_t operator-( const Wrap32& other ) const
+	{
+		return static_cast<int32_t>( raw_value_ - other.raw_value_ );
+	}
+
+	/*
+	 * Serial number ordering (RFC 1982): a < b if b is less than 2^31 ahead of a. This is only meaningful for
+	 * sequence numbers within a window of each other; two that are exactly 2^31 apart are unordered.
+	 */
+	constexpr std::partial_ordering operator<=>( const Wrap32& other ) const
+	{
+		const int32_t distance = *this - other;
+		if ( distance == INT32_MIN ) {
+			return std::partial_ordering::unordered;
+		}
+		return distance <=> 0;
+	}
+
+	/* Whether this Wrap32 lies in the `size` sequence numbers starting at `start`, such as a receive window. */
+	constexpr bool in_window( Wrap32 start, uint32_t size ) const { return raw_value_ - start.raw_value_ < size; }
 
   protected:
 	uint32_t raw_value_ {};
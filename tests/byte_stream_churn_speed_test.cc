@@ -0,0 +1,123 @@
+#include "buffer_pool.hh"
+#include "byte_stream.hh"
+#include "tcp_config.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Count every trip to the global allocator (ByteStream buffers come from new char[])
+static uint64_t allocations = 0; // NOLINT(*-avoid-non-const-global-variables)
+
+void* operator new( size_t size )
+{
+	++allocations;
+	if ( void* const ptr = malloc( size ) ) { // NOLINT(*-no-malloc, *-owning-memory)
+		return ptr;
+	}
+	throw bad_alloc {};
+}
+
+void* operator new[]( size_t size )
+{
+	return operator new( size );
+}
+
+void operator delete( void* ptr ) noexcept
+{
+	free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+void operator delete[]( void* ptr ) noexcept
+{
+	free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+void operator delete( void* ptr, size_t /* size */ ) noexcept
+{
+	free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+void operator delete[]( void* ptr, size_t /* size */ ) noexcept
+{
+	free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+// Open and close `streams` connections, keeping `live` of them open at a time; each one carries `bytes_per_stream`
+void churn_test( fstream& debug_output,
+				 const shared_ptr<BufferPool>& pool,
+				 const size_t streams,
+				 const size_t live,
+				 const size_t bytes_per_stream )
+{
+	const uint64_t capacity = TCPConfig::DEFAULT_CAPACITY;
+	const string segment( TCPConfig::MAX_PAYLOAD_SIZE, 'x' );
+
+	vector<optional<ByteStream>> open( live );
+
+	const uint64_t allocations_before = allocations;
+	const auto start_time = steady_clock::now();
+
+	for ( size_t i = 0; i < streams; ++i ) {
+		auto& slot = open[i % live];
+		if ( pool ) {
+			slot.emplace( capacity, pool );
+		} else {
+			slot.emplace( capacity );
+		}
+
+		for ( size_t sent = 0; sent < bytes_per_stream; sent += segment.size() ) {
+			slot->writer().push( segment );
+		}
+		slot->reader().pop( bytes_per_stream );
+	}
+	open.clear();
+
+	const double seconds = duration_cast<duration<double>>( steady_clock::now() - start_time ).count();
+	const double allocations_per_stream = static_cast<double>( allocations - allocations_before ) / streams;
+	const double ns_per_stream = seconds * 1e9 / static_cast<double>( streams );
+
+	cout << ( pool ? "Pooled" : "Per-instance" ) << " ByteStream buffers, " << streams << " streams (" << live
+		 << " open at a time) of " << bytes_per_stream << " bytes: " << fixed << setprecision( 2 )
+		 << allocations_per_stream << " allocations and " << setprecision( 0 ) << ns_per_stream
+		 << " ns per stream.\n";
+	debug_output << "        ByteStream churn (" << ( pool ? "pooled" : "per-instance" ) << ", " << bytes_per_stream
+				 << " bytes): " << fixed << setprecision( 0 ) << setw( 6 ) << ns_per_stream << " ns/stream\n";
+
+	if ( pool and allocations_per_stream > 0.1 ) {
+		throw runtime_error( "pooled ByteStreams are still allocating" );
+	}
+}
+
+void program_body()
+{
+	fstream debug_output;
+	debug_output.open( "/dev/tty" );
+
+	for ( const size_t bytes_per_stream : { size_t { 1500 }, size_t { 63000 } } ) {
+		churn_test( debug_output, nullptr, 100'000, 64, bytes_per_stream );
+		churn_test( debug_output, make_shared<BufferPool>(), 100'000, 64, bytes_per_stream );
+	}
+}
+
+int main()
+{
+	try {
+		program_body();
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+#include "common.hh"
+#include "concurrent_byte_stream.hh"
+#include "test_should_be.hh"
+
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+void single_thread_test()
+{
+	ConcurrentByteStream bs { 8 };
+
+	bs.writer().push( "abcdef" );
+	test_should_be( bs.writer().bytes_pushed(), 6UL );
+	test_should_be( bs.writer().available_capacity(), 2UL );
+	expect( bs.reader().peek() == "abcdef", "peek() to return \"abcdef\"" );
+
+	bs.reader().pop( 5 );
+	bs.writer().push( "ghijklmn" );
+	test_should_be( bs.writer().bytes_pushed(), 13UL );
+	test_should_be( bs.reader().bytes_buffered(), 8UL );
+	expect( bs.reader().peek() == "fgh", "peek() to stop at the end of the ring" );
+
+	const auto regions = bs.reader().peek_regions();
+	expect( regions.size() == 2 and regions[0] == "fgh" and regions[1] == "ijklm", "two regions" );
+
+	string out;
+	read( bs.reader(), 6, out );
+	expect( out == "fghijk", "read() to peek and pop across the end of the ring" );
+	test_should_be( bs.reader().bytes_buffered(), 2UL );
+
+	bs.reader().pop( 100 );
+	test_should_be( bs.reader().bytes_popped(), 13UL );
+	expect( not bs.reader().is_finished(), "not finished before close" );
+	bs.writer().close();
+	expect( bs.reader().is_finished(), "finished after close" );
+}
+
+void zero_capacity_test()
+{
+	ConcurrentByteStream bs { 0 };
+
+	bs.writer().push( "abc" );
+	expect( bs.writer().bytes_pushed() == 0 and bs.writer().available_capacity() == 0, "nothing pushed" );
+	expect( bs.reader().peek().empty() and bs.reader().peek_regions().empty(), "nothing to peek" );
+	bs.reader().pop( 1 );
+	bs.writer().close();
+	expect( bs.reader().is_finished(), "finished after close" );
+}
+
+void two_thread_test( const size_t input_len, const size_t capacity, const size_t random_seed )
+{
+	const string data = [&] {
+		default_random_engine rd { random_seed };
+		uniform_int_distribution<char> ud;
+		string ret;
+		for ( size_t i = 0; i < input_len; ++i ) {
+			ret += ud( rd );
+		}
+		return ret;
+	}();
+
+	ConcurrentByteStream bs { capacity };
+
+	thread producer { [&] {
+		default_random_engine rd { random_seed };
+		uniform_int_distribution<size_t> write_size { 1, capacity };
+		size_t written = 0;
+		while ( written < data.size() ) {
+			const auto before = bs.writer().bytes_pushed();
+			bs.writer().push( string_view { data }.substr( written, write_size( rd ) ) );
+			written += bs.writer().bytes_pushed() - before;
+			if ( bs.writer().bytes_pushed() == before ) {
+				this_thread::yield();
+			}
+		}
+		bs.writer().close();
+	} };
+
+	string output_data;
+	while ( not bs.reader().is_finished() ) {
+		const auto peeked = bs.reader().peek();
+		if ( peeked.empty() ) {
+			this_thread::yield();
+			continue;
+		}
+		output_data += peeked;
+		bs.reader().pop( peeked.size() );
+	}
+
+	producer.join();
+
+	expect( output_data == data,
+			"the data read to match the data written (capacity=" + to_string( capacity ) + ")" );
+}
+
+int main()
+{
+	try {
+		single_thread_test();
+		zero_capacity_test();
+		two_thread_test( 1 << 16, 1, 1 );
+		two_thread_test( 1 << 16, 7, 2 );
+		two_thread_test( 1 << 20, 4096, 3 );
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
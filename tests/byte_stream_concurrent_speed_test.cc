@@ -0,0 +1,117 @@
+#include "concurrent_byte_stream.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+// Move `input_len` bytes from a producer thread to a consumer thread through a ConcurrentByteStream.
+// Small capacities stay in the L1/L2 cache and stress the index hand-off between the two cores;
+// large ones stream through the last-level cache and memory.
+double speed_test( fstream& debug_output,
+				   const size_t input_len,	 // NOLINT(bugprone-easily-swappable-parameters)
+				   const size_t capacity,	 // NOLINT(bugprone-easily-swappable-parameters)
+				   const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
+				   const size_t write_size,	 // NOLINT(bugprone-easily-swappable-parameters)
+				   const size_t read_size )	 // NOLINT(bugprone-easily-swappable-parameters)
+{
+	// Generate the data to be written
+	const string data = [&random_seed, &input_len] {
+		default_random_engine rd { random_seed };
+		uniform_int_distribution<char> ud;
+		string ret;
+		for ( size_t i = 0; i < input_len; ++i ) {
+			ret += ud( rd );
+		}
+		return ret;
+	}();
+
+	ConcurrentByteStream bs { capacity };
+	string output_data;
+	output_data.reserve( data.size() );
+	size_t writer_stalls = 0;
+	size_t reader_stalls = 0;
+
+	const auto start_time = steady_clock::now();
+
+	thread producer { [&] {
+		size_t written = 0;
+		while ( written < data.size() ) {
+			const auto before = bs.writer().bytes_pushed();
+			bs.writer().push( string_view { data }.substr( written, write_size ) );
+			const auto pushed = bs.writer().bytes_pushed() - before;
+			if ( pushed == 0 ) {
+				++writer_stalls;
+				this_thread::yield();
+			}
+			written += pushed;
+		}
+		bs.writer().close();
+	} };
+
+	while ( not bs.reader().is_finished() ) {
+		auto peeked = bs.reader().peek().substr( 0, read_size );
+		if ( peeked.empty() ) {
+			++reader_stalls;
+			this_thread::yield();
+			continue;
+		}
+		output_data += peeked;
+		bs.reader().pop( peeked.size() );
+	}
+
+	producer.join();
+
+	const auto stop_time = steady_clock::now();
+
+	if ( data != output_data ) {
+		throw runtime_error( "Mismatch between data written and read" );
+	}
+
+	auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+	auto gigabits_per_second = 8 * static_cast<double>( input_len ) / test_duration.count() / 1e9;
+
+	cout << "ConcurrentByteStream with capacity=" << capacity << ", write_size=" << write_size
+		 << ", read_size=" << read_size << " reached " << fixed << setprecision( 2 ) << gigabits_per_second
+		 << " Gbit/s (writer stalls=" << writer_stalls << ", reader stalls=" << reader_stalls << ").\n";
+
+	auto capacity_s = to_string( capacity );
+	string fill( 9 - capacity_s.size(), ' ' );
+	debug_output << "        ConcurrentByteStream throughput (capacity " << capacity_s << "):" << fill << fixed
+				 << setprecision( 2 ) << setw( 5 ) << gigabits_per_second << " Gbit/s\n";
+
+	if ( gigabits_per_second < 0.1 ) {
+		throw runtime_error( "ConcurrentByteStream did not meet minimum speed of 0.1 Gbit/s" );
+	}
+
+	return gigabits_per_second;
+}
+
+void program_body()
+{
+	fstream debug_output;
+	debug_output.open( "/dev/tty" );
+
+	speed_test( debug_output, 1e8, 4096, 789, 1500, 4096 );
+	speed_test( debug_output, 1e8, 32768, 789, 1500, 4096 );
+	speed_test( debug_output, 1e8, 1048576, 789, 1500, 4096 );
+	speed_test( debug_output, 1e8, 33554432, 789, 1500, 4096 );
+}
+
+int main()
+{
+	try {
+		program_body();
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+#include "byte_stream.hh"
+#include "tcp_config.hh"
+
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <malloc.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// Resident set size of this process, in bytes
+static uint64_t resident_bytes()
+{
+	ifstream statm { "/proc/self/statm" };
+	uint64_t total_pages {};
+	uint64_t resident_pages {};
+	statm >> total_pages >> resident_pages;
+	if ( not statm ) {
+		throw runtime_error( "could not read /proc/self/statm" );
+	}
+	return resident_pages * static_cast<uint64_t>( sysconf( _SC_PAGESIZE ) );
+}
+
+// Memory held by many mostly-idle connections, each with an inbound and an outbound ByteStream
+void idle_test( fstream& debug_output, const size_t connections, const size_t active_connections )
+{
+	const uint64_t capacity = TCPConfig::DEFAULT_CAPACITY;
+	const string segment( TCPConfig::MAX_PAYLOAD_SIZE, 'x' );
+	const string full( capacity, 'x' );
+
+	const uint64_t baseline = resident_bytes();
+	vector<ByteStream> streams( 2 * connections, ByteStream { capacity } );
+
+	auto report = [&]( string_view stage ) {
+		uint64_t resident_capacity = 0;
+		for ( const auto& bs : streams ) {
+			resident_capacity += bs.resident_capacity();
+		}
+		const double rss_mb = static_cast<double>( resident_bytes() - baseline ) / 1e6;
+		const double logical_mb = static_cast<double>( streams.size() * capacity ) / 1e6;
+
+		cout << connections << " connections, " << stage << ": RSS +" << fixed << setprecision( 1 ) << rss_mb
+			 << " MB, stream buffers " << static_cast<double>( resident_capacity ) / 1e6 << " MB of " << logical_mb
+			 << " MB logical capacity.\n";
+		debug_output << "        ByteStream memory (" << stage << "): " << fixed << setprecision( 1 ) << setw( 6 )
+					 << rss_mb << " MB\n";
+		return rss_mb;
+	};
+
+	const double idle_mb = report( "all idle" );
+
+	for ( size_t i = 0; i < 2 * active_connections; ++i ) {
+		streams[i].writer().push( segment );
+		streams[i].reader().pop( segment.size() );
+	}
+	const double active_mb = report( "some active" );
+
+	// What every connection used to cost: the whole buffer allocated and touched
+	for ( auto& bs : streams ) {
+		bs.writer().push( full );
+		bs.reader().pop( full.size() );
+	}
+	const double full_mb = report( "all filled once" );
+
+	for ( auto& bs : streams ) {
+		bs.shrink_to_fit();
+	}
+	malloc_trim( 0 );
+	report( "after shrink_to_fit" );
+
+	if ( idle_mb > full_mb / 10 or active_mb > full_mb / 4 ) {
+		throw runtime_error( "idle ByteStreams are holding on to too much memory" );
+	}
+}
+
+void program_body()
+{
+	fstream debug_output;
+	debug_output.open( "/dev/tty" );
+
+	idle_test( debug_output, 1000, 50 );
+}
+
+int main()
+{
+	try {
+		program_body();
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
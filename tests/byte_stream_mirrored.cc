@@ -0,0 +1,68 @@
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+	try {
+		const string page( 4096, 'x' );
+
+		{
+			ByteStreamTestHarness test { "mirrored-basic", 15, ByteStream::Storage::MirroredRing };
+
+			test.execute( Push { "cat" } );
+			test.execute( AvailableCapacity { 12 } );
+			test.execute( PeekOnce { "cat" } );
+			test.execute( Pop { 3 } );
+			test.execute( BufferEmpty { true } );
+			test.execute( Close {} );
+			test.execute( IsFinished { true } );
+		}
+
+		{
+			// The capacity never exceeds what was asked for, even though the ring is a whole page
+			ByteStreamTestHarness test { "mirrored-capacity", 2, ByteStream::Storage::MirroredRing };
+
+			test.execute( Push { "cat" } );
+			test.execute( BytesPushed { 2 } );
+			test.execute( AvailableCapacity { 0 } );
+			test.execute( Peek { "ca" } );
+		}
+
+		{
+			ByteStreamTestHarness test { "mirrored-wrap", 4096, ByteStream::Storage::MirroredRing };
+
+			test.execute( Push { page.substr( 0, 4000 ) } );
+			test.execute( Pop { 4000 } );
+			test.execute( Push { "0123456789" + page.substr( 0, 1000 ) } );
+
+			// the buffered bytes cross the end of the ring, but peek() still sees all of them
+			test.execute( BytesBuffered { 1010 } );
+			test.execute( PeekOnce { "0123456789" + page.substr( 0, 1000 ) } );
+			test.execute( PeekRegions { { "0123456789" + page.substr( 0, 1000 ) } } );
+
+			test.execute( Pop { 10 } );
+			test.execute( ReserveAndCommit { "abc", 3, 1 } );
+			test.execute( PeekOnce { page.substr( 0, 1000 ) + "abc" } );
+			test.execute( Peek { page.substr( 0, 1000 ) + "abc" } );
+		}
+
+		{
+			ByteStreamTestHarness test { "mirrored-full", 4096, ByteStream::Storage::MirroredRing };
+
+			test.execute( Push { "abc" } );
+			test.execute( Pop { 3 } );
+			test.execute( Push { page } );
+			test.execute( AvailableCapacity { 0 } );
+			test.execute( PeekOnce { page } );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+using namespace std;
+
+static void expect_pool( const BufferPool& pool, uint64_t allocated, uint64_t reused, uint64_t idle )
+{
+	if ( pool.slabs_allocated() != allocated or pool.slabs_reused() != reused or pool.idle_bytes() != idle ) {
+		throw runtime_error( "BufferPool: expected " + to_string( allocated ) + " allocated, " + to_string( reused )
+							 + " reused, " + to_string( idle ) + " idle bytes, but got "
+							 + to_string( pool.slabs_allocated() ) + ", " + to_string( pool.slabs_reused() ) + ", "
+							 + to_string( pool.idle_bytes() ) );
+	}
+}
+
+int main()
+{
+	try {
+		auto pool = make_shared<BufferPool>();
+
+		{
+			ByteStreamTestHarness test { "pooled-basics", 64000, pool };
+
+			test.execute( ResidentCapacity { 0 } );
+			test.execute( Push { "hello" } );
+			test.execute( ResidentCapacity { 4096 } );
+			test.execute( Push { string( 6000, 'x' ) } );
+			test.execute( ResidentCapacity { 8192 } );
+			test.execute( ReadAll( "hello" + string( 6000, 'x' ) ) );
+			expect_pool( *pool, 2, 0, 4096 );
+
+			test.execute( ShrinkToFit {} );
+			test.execute( ResidentCapacity { 0 } );
+			expect_pool( *pool, 2, 0, 4096 + 8192 );
+		}
+
+		{
+			ByteStreamTestHarness test { "pooled-reuse", 64000, pool };
+
+			test.execute( Push { string( 5000, 'y' ) } );
+			test.execute( ResidentCapacity { 8192 } );
+			expect_pool( *pool, 2, 1, 4096 );
+
+			test.execute( Push { string( 10000, 'z' ) } );
+			test.execute( ResidentCapacity { 16384 } );
+			test.execute( ReadAll( string( 5000, 'y' ) + string( 10000, 'z' ) ) );
+			test.execute( Close {} );
+			test.execute( IsFinished { true } );
+			expect_pool( *pool, 3, 1, 4096 + 8192 );
+		}
+
+		// the harness's stream (and its slab) is gone
+		expect_pool( *pool, 3, 1, 4096 + 8192 + 16384 );
+
+		{
+			auto small_pool = make_shared<BufferPool>( 4096 );
+			{
+				ByteStreamTestHarness test { "pooled-idle-limit", 64000, small_pool };
+
+				test.execute( Push { "abc" } );
+				test.execute( ResidentCapacity { 4096 } );
+				test.execute( Push { string( 5000, 'x' ) } );
+				test.execute( ResidentCapacity { 8192 } );
+			}
+			// the 4096-byte slab was kept, but the 8192-byte slab would exceed the limit
+			expect_pool( *small_pool, 2, 0, 4096 );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
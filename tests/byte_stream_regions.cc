@@ -0,0 +1,60 @@
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+	try {
+		{
+			ByteStreamTestHarness test { "regions-empty", 8 };
+
+			test.execute( PeekRegions { {} } );
+			test.execute( Push { "abc" } );
+			test.execute( Pop { 3 } );
+			test.execute( PeekRegions { {} } );
+		}
+
+		{
+			ByteStreamTestHarness test { "regions-contiguous", 8 };
+
+			test.execute( Push { "abc" } );
+			test.execute( PeekRegions { { "abc" } } );
+			test.execute( Pop { 1 } );
+			test.execute( PeekRegions { { "bc" } } );
+		}
+
+		{
+			ByteStreamTestHarness test { "regions-wrapped", 8 };
+
+			test.execute( Push { "abcdef" } );
+			test.execute( Pop { 5 } );
+			test.execute( Push { "ghijk" } );
+
+			test.execute( BytesBuffered { 6 } );
+			test.execute( PeekOnce { "fgh" } );
+			test.execute( PeekRegions { { "fgh", "ijk" } } );
+
+			test.execute( Pop { 3 } );
+			test.execute( PeekRegions { { "ijk" } } );
+		}
+
+		{
+			ByteStreamTestHarness test { "regions-full", 4 };
+
+			test.execute( Push { "ab" } );
+			test.execute( Pop { 2 } );
+			test.execute( Push { "cdef" } );
+
+			test.execute( AvailableCapacity { 0 } );
+			test.execute( PeekRegions { { "cd", "ef" } } );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
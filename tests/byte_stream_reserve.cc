@@ -0,0 +1,64 @@
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+	try {
+		{
+			ByteStreamTestHarness test { "reserve-commit", 8 };
+
+			test.execute( ReserveAndCommit { "abc", 3, 1 } );
+
+			test.execute( BytesPushed { 3 } );
+			test.execute( AvailableCapacity { 5 } );
+			test.execute( BytesBuffered { 3 } );
+			test.execute( Peek { "abc" } );
+		}
+
+		{
+			ByteStreamTestHarness test { "reserve-partial-commit", 8 };
+
+			test.execute( ReserveAndCommit { "ab", 100, 1 } );
+
+			test.execute( BytesPushed { 2 } );
+			test.execute( AvailableCapacity { 6 } );
+			test.execute( Peek { "ab" } );
+		}
+
+		{
+			ByteStreamTestHarness test { "reserve-wrapped", 8 };
+
+			test.execute( Push { "abcdef" } );
+			test.execute( Pop { 4 } );
+			test.execute( ReserveAndCommit { "ghijkl", 6, 2 } );
+
+			test.execute( BytesPushed { 12 } );
+			test.execute( BytesPopped { 4 } );
+			test.execute( AvailableCapacity { 0 } );
+			test.execute( Peek { "efghijkl" } );
+		}
+
+		{
+			ByteStreamTestHarness test { "reserve-after-push", 4 };
+
+			test.execute( Push { "ab" } );
+			test.execute( ReserveAndCommit { "cd", 4, 1 } );
+			test.execute( Push { "e" } );
+
+			test.execute( BytesPushed { 4 } );
+			test.execute( AvailableCapacity { 0 } );
+			test.execute( ReadAll( "abcd" ) );
+			test.execute( Close {} );
+			test.execute( IsFinished { true } );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "byte_stream_test_harness.hh"
+#include "test_should_be.hh"
+
+#include <exception>
+#include <iostream>
+#include <string_view>
+
+using namespace std;
+
+int main()
+{
+	try {
+		{
+			ByteStreamTestHarness test { "lazy-allocation", 64000 };
+
+			test.execute( ResidentCapacity { 0 } );
+			test.execute( AvailableCapacity { 64000 } );
+			test.execute( Push { "" } );
+			test.execute( ResidentCapacity { 0 } );
+
+			test.execute( Push { "abc" } );
+			test.execute( ResidentCapacity { 4096 } );
+			test.execute( Peek { "abc" } );
+		}
+
+		{
+			ByteStreamTestHarness test { "grow-to-capacity", 64000 };
+
+			const string big( 5000, 'x' );
+			test.execute( Push { "abc" } );
+			test.execute( Pop { 2 } );
+			test.execute( Push { big } );
+			test.execute( ResidentCapacity { 8192 } );
+			test.execute( Peek { "c" + big } );
+
+			test.execute( Push { string( 64000, 'y' ) } );
+			test.execute( ResidentCapacity { 65536 } );
+			test.execute( AvailableCapacity { 0 } );
+			test.execute( Peek { "c" + big + string( 64000 - 5001, 'y' ) } );
+		}
+
+		{
+			ByteStreamTestHarness test { "small-capacity", 100 };
+
+			test.execute( Push { "abc" } );
+			test.execute( ResidentCapacity { 128 } );
+		}
+
+		{
+			ByteStreamTestHarness test { "shrink-when-idle", 64000 };
+
+			test.execute( Push { string( 20000, 'x' ) } );
+			test.execute( ResidentCapacity { 32768 } );
+			test.execute( Pop { 19990 } );
+
+			test.execute( ShrinkToFit {} );
+			test.execute( ResidentCapacity { 4096 } );
+			test.execute( Peek { string( 10, 'x' ) } );
+
+			test.execute( Pop { 10 } );
+			test.execute( ShrinkToFit {} );
+			test.execute( ResidentCapacity { 0 } );
+			test.execute( BytesPushed { 20000 } );
+			test.execute( BytesPopped { 20000 } );
+
+			test.execute( Push { "abc" } );
+			test.execute( ResidentCapacity { 4096 } );
+			test.execute( ReadAll( "abc" ) );
+		}
+
+		{
+			ByteStreamTestHarness test { "shrink-mirrored", 64000, ByteStream::Storage::MirroredRing };
+
+			test.execute( Push { string( 10000, 'x' ) } );
+			test.execute( Pop { 9000 } );
+			test.execute( ShrinkToFit {} );
+			test.execute( ResidentCapacity { 4096 } );
+			test.execute( Push { "abc" } );
+			test.execute( PeekOnce { string( 1000, 'x' ) + "abc" } );
+		}
+
+		{
+			// A view from peek() survives a push that fits in the ring, but not one that grows it
+			ByteStream stream { 64000 };
+			stream.writer().push( "abc" );
+			const string_view view = stream.reader().peek();
+			stream.writer().push( "def" );
+			test_should_be( stream.resident_capacity(), 4096UL );
+			expect( view == "abc", "the view to still show \"abc\"" );
+
+			stream.writer().push( string( 5000, 'x' ) );
+			test_should_be( stream.resident_capacity(), 8192UL );
+			expect( stream.reader().peek().starts_with( "abcdef" ), "peeking again to find the moved bytes" );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
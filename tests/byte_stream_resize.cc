@@ -0,0 +1,61 @@
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+	try {
+		for ( const auto storage :
+			  { ByteStream::Storage::Ring, ByteStream::Storage::MirroredRing, ByteStream::Storage::Rope } ) {
+			{
+				ByteStreamTestHarness test { "grow keeps buffered bytes", 4, storage };
+				test.execute( Push { "abcdef" } );
+				test.execute( Peek { "abcd" } );
+				test.execute( AvailableCapacity { 0 } );
+				test.execute( SetCapacity { 10 } );
+				test.execute( Capacity { 10 } );
+				test.execute( AvailableCapacity { 6 } );
+				test.execute( Push { "efghijklmn" } );
+				test.execute( BytesBuffered { 10 } );
+				test.execute( ReadAll { "abcdefghij" } );
+				test.execute( AvailableCapacity { 10 } );
+			}
+
+			{
+				ByteStreamTestHarness test { "grow past the ring", 4096, storage };
+				test.execute( Push { string( 4000, 'x' ) } );
+				test.execute( Pop { 3000 } );
+				test.execute( Push { string( 3000, 'y' ) } );
+				test.execute( SetCapacity { 100000 } );
+				test.execute( Push { string( 50000, 'z' ) } );
+				test.execute( BytesBuffered { 54000 } );
+				test.execute( ReadAll { string( 1000, 'x' ) + string( 3000, 'y' ) + string( 50000, 'z' ) } );
+			}
+
+			{
+				ByteStreamTestHarness test { "shrink clamped to what is buffered", 16, storage };
+				test.execute( Push { "hello" } );
+				test.execute( SetCapacity { 2 } );
+				test.execute( Capacity { 5 } );
+				test.execute( AvailableCapacity { 0 } );
+				test.execute( Push { "!" } );
+				test.execute( Pop { 2 } );
+				test.execute( AvailableCapacity { 2 } );
+				test.execute( SetCapacity { 3 } );
+				test.execute( Capacity { 3 } );
+				test.execute( AvailableCapacity { 0 } );
+				test.execute( ReadAll { "llo" } );
+				test.execute( Push { "abcd" } );
+				test.execute( ReadAll { "abc" } );
+			}
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
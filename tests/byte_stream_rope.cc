@@ -0,0 +1,125 @@
+#include "byte_stream_test_harness.hh"
+
+#include <climits>
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+	try {
+		const string big( 10000, 'x' );
+		const string other( 6000, 'y' );
+
+		{
+			ByteStreamTestHarness test { "rope-basic", 15, ByteStream::Storage::Rope };
+
+			test.execute( PushOwned { "cat" } );
+			test.execute( AvailableCapacity { 12 } );
+			test.execute( PeekOnce { "cat" } );
+			test.execute( Pop { 2 } );
+			test.execute( PeekOnce { "t" } );
+			test.execute( Pop { 1 } );
+			test.execute( BufferEmpty { true } );
+			test.execute( PeekOnce { "" } );
+			test.execute( Close {} );
+			test.execute( IsFinished { true } );
+		}
+
+		{
+			ByteStreamTestHarness test { "rope-capacity", 20000, ByteStream::Storage::Rope };
+
+			test.execute( PushOwned { big } );
+			test.execute( PushOwned { big } );
+			test.execute( BytesPushed { 20000 } );
+			test.execute( AvailableCapacity { 0 } );
+			test.execute( PushOwned { "more" } );
+			test.execute( BytesPushed { 20000 } );
+
+			// each large push stays a chunk of its own
+			test.execute( PeekOnce { big } );
+			test.execute( PeekRegions { { big, big } } );
+			test.execute( Pop { 15000 } );
+			test.execute( PeekOnce { big.substr( 0, 5000 ) } );
+			test.execute( AvailableCapacity { 15000 } );
+			test.execute( ReadAll( big.substr( 0, 5000 ) ) );
+		}
+
+		{
+			ByteStreamTestHarness test { "rope-pop-across-chunks", 100000, ByteStream::Storage::Rope };
+
+			test.execute( PushOwned { big } );
+			test.execute( Push { other } );
+			test.execute( PushOwned { big } );
+			test.execute( Pop { 12000 } );
+			test.execute( PeekOnce { other.substr( 2000 ) } );
+			test.execute( PeekRegions { { other.substr( 2000 ), big } } );
+			test.execute( BytesBuffered { 14000 } );
+			test.execute( Pop { 4000 } );
+			test.execute( PeekOnce { big } );
+			test.execute( Peek { big } );
+		}
+
+		{
+			ByteStreamTestHarness test { "rope-small-writes", 100000, ByteStream::Storage::Rope };
+
+			// small writes are gathered into a chunk of up to 4096 bytes
+			test.execute( PushOwned { "abc" } );
+			test.execute( Push { "def" } );
+			test.execute( PushOwned { string( 4090, 'z' ) } );
+			test.execute( PushOwned { "ghi" } );
+			test.execute( PeekRegions { { "abcdef" + string( 4090, 'z' ), "ghi" } } );
+			test.execute( Pop { 1 } );
+			test.execute( PeekOnce { "bcdef" + string( 4090, 'z' ) } );
+			test.execute( Peek { "bcdef" + string( 4090, 'z' ) + "ghi" } );
+		}
+
+		{
+			ByteStreamTestHarness test { "rope-many-chunks", 10'000'000, ByteStream::Storage::Rope };
+
+			// too big to share a chunk, so each push is a chunk of its own; writev() takes at most IOV_MAX of them
+			string all;
+			for ( size_t i = 0; i < 1500; ++i ) {
+				const string chunk( 2049, static_cast<char>( 'a' + i % 26 ) );
+				test.execute( PushOwned { chunk } );
+				all += chunk;
+			}
+			test.execute( PeekRegionCount { IOV_MAX } );
+			test.execute( Pop { 2049 * 1000 } );
+			test.execute( PeekRegionCount { 500 } );
+			test.execute( Peek { all.substr( 2049 * 1000 ) } );
+		}
+
+		{
+			ByteStreamTestHarness test { "rope-peek-after-push", 100, ByteStream::Storage::Rope };
+
+			// a small write is appended to the chunk that peek() showed, so peeking again is the only way to see it
+			test.execute( PushOwned { "abc" } );
+			test.execute( PeekOnce { "abc" } );
+			test.execute( Push { "def" } );
+			test.execute( PeekOnce { "abcdef" } );
+			test.execute( ReserveAndCommit { "ghi", 3, 1 } );
+			test.execute( PeekOnce { "abcdefghi" } );
+			test.execute( PeekRegionCount { 1 } );
+		}
+
+		{
+			ByteStreamTestHarness test { "rope-reserve", 20, ByteStream::Storage::Rope };
+
+			test.execute( ReserveAndCommit { "hello", 30, 1 } );
+			test.execute( BytesPushed { 5 } );
+			test.execute( PushOwned { " world" } );
+			test.execute( ReserveAndCommit { "", 4, 1 } );
+			test.execute( PeekOnce { "hello world" } );
+			test.execute( ReadAll( "hello world" ) );
+			test.execute( ShrinkToFit {} );
+			test.execute( ResidentCapacity { 0 } );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
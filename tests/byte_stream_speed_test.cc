@@ -1,12 +1,16 @@
 #include "byte_stream.hh"
 
+#include <bit>
 #include <chrono>
 #include <cstddef>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <queue>
 #include <random>
+#include <string_view>
 
 using namespace std;
 using namespace std::chrono;
@@ -16,7 +20,8 @@ double speed_test( fstream& debug_output,
 				   const size_t capacity,	 // NOLINT(bugprone-easily-swappable-parameters)
 				   const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
 				   const size_t write_size,	 // NOLINT(bugprone-easily-swappable-parameters)
-				   const size_t read_size )	 // NOLINT(bugprone-easily-swappable-parameters)
+				   const size_t read_size,	 // NOLINT(bugprone-easily-swappable-parameters)
+				   const ByteStream::Storage storage = ByteStream::Storage::Ring )
 {
 	// Generate the data to be written
 	const string data = [&random_seed, &input_len] {
@@ -35,7 +40,7 @@ double speed_test( fstream& debug_output,
 		split_data.emplace( data.substr( i, write_size ) );
 	}
 
-	ByteStream bs { capacity };
+	ByteStream bs { capacity, storage };
 	string output_data;
 	output_data.reserve( data.size() );
 
@@ -73,12 +78,16 @@ double speed_test( fstream& debug_output,
 	auto bits_per_second = 8 * bytes_per_second;
 	auto gigabits_per_second = bits_per_second / 1e9;
 
-	cout << "ByteStream with capacity=" << capacity << ", write_size=" << write_size << ", read_size=" << read_size
-		 << " reached " << fixed << setprecision( 2 ) << gigabits_per_second << " Gbit/s.\n";
+	const string_view label = storage == ByteStream::Storage::MirroredRing ? ", mirrored"
+							  : storage == ByteStream::Storage::Rope		 ? ", rope"
+																			 : "";
+	cout << "ByteStream with capacity=" << capacity << label << ", write_size=" << write_size
+		 << ", read_size=" << read_size << " reached " << fixed << setprecision( 2 ) << gigabits_per_second
+		 << " Gbit/s.\n";
 
 	auto read_s = to_string( read_size );
 	string fill( 5 - read_s.size(), ' ' );
-	debug_output << "        ByteStream throughput (pop length " << read_s << "):" << fill << fixed
+	debug_output << "        ByteStream throughput (pop length " << read_s << label << "):" << fill << fixed
 				 << setprecision( 2 ) << setw( 5 ) << gigabits_per_second << " Gbit/s\n";
 
 	if ( gigabits_per_second < 0.1 ) {
@@ -88,6 +97,182 @@ double speed_test( fstream& debug_output,
 	return gigabits_per_second;
 }
 
+// How the writer hands bytes to the stream when they start out in someone else's buffer (like a socket's)
+enum class Source : uint8_t
+{
+	String,	 // copy each segment into a std::string, then push it (two copies)
+	View,	 // push a string_view of the segment (one copy)
+	Reserve, // reserve space in the stream and fill it in place (one copy, as read(2) would)
+};
+
+void source_speed_test( fstream& debug_output,
+						const size_t input_len,	  // NOLINT(bugprone-easily-swappable-parameters)
+						const size_t capacity,	  // NOLINT(bugprone-easily-swappable-parameters)
+						const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
+						const size_t write_size,  // NOLINT(bugprone-easily-swappable-parameters)
+						const Source source )
+{
+	const string data = [&random_seed, &input_len] {
+		default_random_engine rd { random_seed };
+		uniform_int_distribution<char> ud;
+		string ret;
+		for ( size_t i = 0; i < input_len; ++i ) {
+			ret += ud( rd );
+		}
+		return ret;
+	}();
+
+	ByteStream bs { capacity };
+	string output_data;
+	output_data.reserve( data.size() );
+	size_t written = 0;
+
+	const auto start_time = steady_clock::now();
+	while ( not bs.reader().is_finished() ) {
+		if ( written == data.size() ) {
+			if ( not bs.writer().is_closed() ) {
+				bs.writer().close();
+			}
+		} else {
+			const string_view segment = string_view { data }.substr( written, write_size );
+			if ( segment.size() <= bs.writer().available_capacity() ) {
+				switch ( source ) {
+					case Source::String:
+						bs.writer().push( string { segment } );
+						break;
+					case Source::View:
+						bs.writer().push( segment );
+						break;
+					case Source::Reserve: {
+						size_t filled = 0;
+						for ( const auto region : bs.writer().reserve( segment.size() ) ) {
+							segment.copy( region.data(), region.size(), filled );
+							filled += region.size();
+						}
+						bs.writer().commit( filled );
+						break;
+					}
+				}
+				written += segment.size();
+			}
+		}
+
+		if ( bs.reader().bytes_buffered() ) {
+			auto peeked = bs.reader().peek();
+			output_data += peeked;
+			bs.reader().pop( peeked.size() );
+		}
+	}
+
+	const auto stop_time = steady_clock::now();
+
+	if ( data != output_data ) {
+		throw runtime_error( "Mismatch between data written and read" );
+	}
+
+	auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+	auto gigabits_per_second = 8 * static_cast<double>( input_len ) / test_duration.count() / 1e9;
+
+	const string_view name = source == Source::String ? "string" : source == Source::View ? "view" : "reserve";
+	cout << "ByteStream with capacity=" << capacity << ", write_size=" << write_size << ", push from " << name
+		 << " reached " << fixed << setprecision( 2 ) << gigabits_per_second << " Gbit/s.\n";
+
+	string fill( 7 - name.size(), ' ' );
+	debug_output << "        ByteStream throughput (push from " << name << "):" << fill << fixed
+				 << setprecision( 2 ) << setw( 5 ) << gigabits_per_second << " Gbit/s\n";
+
+	if ( gigabits_per_second < 0.1 ) {
+		throw runtime_error( "ByteStream did not meet minimum speed of 0.1 Gbit/s" );
+	}
+}
+
+// A bare ring of `capacity` bytes, as ByteStream's was, that wraps positions either with `% capacity` or with
+// `& mask` over a ring rounded up to a power of two (as ByteStream's now is)
+template<bool UseMask>
+class IndexedRing
+{
+	uint64_t capacity_;
+	uint64_t size_;
+	std::unique_ptr<char[]> buffer_;
+	uint64_t pushed_ {};
+	uint64_t popped_ {};
+
+	uint64_t offset( uint64_t pos ) const
+	{
+		if constexpr ( UseMask ) {
+			return pos & ( size_ - 1 );
+		} else {
+			return pos % size_;
+		}
+	}
+
+  public:
+	explicit IndexedRing( uint64_t capacity )
+	  : capacity_( capacity )
+	  , size_( UseMask ? bit_ceil( capacity ) : capacity )
+	  , buffer_( make_unique<char[]>( size_ ) )
+	{}
+
+	uint64_t available_capacity() const { return capacity_ - ( pushed_ - popped_ ); }
+
+	void push( string_view data )
+	{
+		const uint64_t tail = offset( pushed_ );
+		const uint64_t first = min<uint64_t>( data.size(), size_ - tail );
+		memcpy( buffer_.get() + tail, data.data(), first );
+		memcpy( buffer_.get(), data.data() + first, data.size() - first );
+		pushed_ += data.size();
+	}
+
+	string_view peek() const
+	{
+		const uint64_t head = offset( popped_ );
+		return { buffer_.get() + head, min( pushed_ - popped_, size_ - head ) };
+	}
+
+	void pop( uint64_t len ) { popped_ += len; }
+};
+
+template<bool UseMask>
+void indexing_speed_test( fstream& debug_output,
+						  const size_t input_len,  // NOLINT(bugprone-easily-swappable-parameters)
+						  const size_t capacity,   // NOLINT(bugprone-easily-swappable-parameters)
+						  const size_t write_size, // NOLINT(bugprone-easily-swappable-parameters)
+						  const size_t read_size )
+{
+	const string data( input_len, 'x' );
+	const volatile size_t opaque_capacity = capacity; // so the compiler can't turn % into a multiply
+	IndexedRing<UseMask> ring { opaque_capacity };
+	uint64_t written = 0;
+	uint64_t read = 0;
+
+	const auto start_time = steady_clock::now();
+	while ( read < input_len ) {
+		const string_view segment = string_view { data }.substr( written, write_size );
+		if ( not segment.empty() and segment.size() <= ring.available_capacity() ) {
+			ring.push( segment );
+			written += segment.size();
+		}
+
+		const auto peeked = ring.peek().substr( 0, read_size );
+		ring.pop( peeked.size() );
+		read += peeked.size();
+	}
+	const auto stop_time = steady_clock::now();
+
+	auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+	auto gigabits_per_second = 8 * static_cast<double>( input_len ) / test_duration.count() / 1e9;
+
+	const string_view name = UseMask ? "mask" : "modulo";
+	cout << "Ring with capacity=" << capacity << ", write_size=" << write_size << ", read_size=" << read_size
+		 << ", indexed by " << name << " reached " << fixed << setprecision( 2 ) << gigabits_per_second
+		 << " Gbit/s.\n";
+
+	string fill( 6 - name.size(), ' ' );
+	debug_output << "        Ring throughput (pop length " << read_size << ", " << name << "):" << fill << fixed
+				 << setprecision( 2 ) << setw( 5 ) << gigabits_per_second << " Gbit/s\n";
+}
+
 void program_body()
 {
 	fstream debug_output;
@@ -96,6 +281,30 @@ void program_body()
 	speed_test( debug_output, 1e7, 32768, 789, 1500, 4096 );
 	speed_test( debug_output, 1e7, 32768, 789, 1500, 128 );
 	speed_test( debug_output, 1e7, 32768, 789, 1500, 32 );
+
+	// A capacity that is not a power of two (the ring is rounded up internally)
+	speed_test( debug_output, 1e7, 30000, 789, 1500, 4096 );
+	speed_test( debug_output, 1e7, 30000, 789, 1500, 128 );
+	speed_test( debug_output, 1e7, 30000, 789, 1500, 32 );
+
+	// The ring's indexing alone, with the old `% capacity` against the new `& mask`
+	indexing_speed_test<false>( debug_output, 1e8, 30000, 1500, 32 );
+	indexing_speed_test<true>( debug_output, 1e8, 30000, 1500, 32 );
+
+	// A mirrored ring, where a push or peek never has to be split at the end of the buffer
+	speed_test( debug_output, 1e7, 32768, 789, 1500, 4096, ByteStream::Storage::MirroredRing );
+	speed_test( debug_output, 1e7, 32768, 789, 1500, 128, ByteStream::Storage::MirroredRing );
+	speed_test( debug_output, 1e7, 32768, 789, 1500, 32, ByteStream::Storage::MirroredRing );
+
+	// Large writes of owned strings, which a rope keeps without copying them into a ring
+	speed_test( debug_output, 1e7, 1 << 20, 789, 1500, 65536 );
+	speed_test( debug_output, 1e7, 1 << 20, 789, 1500, 65536, ByteStream::Storage::Rope );
+	speed_test( debug_output, 1e7, 1 << 20, 789, 65536, 65536 );
+	speed_test( debug_output, 1e7, 1 << 20, 789, 65536, 65536, ByteStream::Storage::Rope );
+
+	source_speed_test( debug_output, 1e7, 32768, 789, 1500, Source::String );
+	source_speed_test( debug_output, 1e7, 32768, 789, 1500, Source::View );
+	source_speed_test( debug_output, 1e7, 32768, 789, 1500, Source::Reserve );
 }
 
 int main()
@@ -19,6 +19,31 @@ class ByteStreamTestHarness : public TestHarness<ByteStream>
 	  : TestHarness( move( test_name ), "capacity=" + std::to_string( capacity ), ByteStream { capacity } )
 	{}
 
+	ByteStreamTestHarness( std::string test_name, uint64_t capacity, ByteStream::Storage storage )
+	  : TestHarness( move( test_name ),
+					 "capacity=" + std::to_string( capacity ) + ", storage=" + storage_name( storage ),
+					 ByteStream { capacity, storage } )
+	{}
+
+	ByteStreamTestHarness( std::string test_name, uint64_t capacity, std::shared_ptr<BufferPool> pool )
+	  : TestHarness( move( test_name ),
+					 "capacity=" + std::to_string( capacity ) + ", storage=Ring, pooled",
+					 ByteStream { capacity, move( pool ) } )
+	{}
+
+	static std::string storage_name( ByteStream::Storage storage )
+	{
+		switch ( storage ) {
+			case ByteStream::Storage::Ring:
+				return "Ring";
+			case ByteStream::Storage::MirroredRing:
+				return "MirroredRing";
+			case ByteStream::Storage::Rope:
+				return "Rope";
+		}
+		return "unknown";
+	}
+
 	size_t peek_size() { return object().reader().peek().size(); }
 };
 
@@ -34,6 +59,70 @@ struct Push : public Action<ByteStream>
 	constexpr std::string obj() const override { return "Writer"; }
 };
 
+// push an owned string (which the stream may keep instead of copying)
+struct PushOwned : public Push
+{
+	using Push::Push;
+
+	std::string description() const override
+	{
+		return "push owned \"" + pretty_print( data_ ) + "\" to the stream";
+	}
+	void execute( ByteStream& bs ) const override { bs.writer().push( std::string { data_ } ); }
+};
+
+struct ReserveAndCommit : public Action<ByteStream>
+{
+	std::string data_;
+	uint64_t reserve_len_;
+	size_t regions_;
+
+	// reserve `reserve_len` bytes, expect `regions` writable regions, then fill them with `data` and commit it
+	ReserveAndCommit( std::string data, uint64_t reserve_len, size_t regions )
+	  : data_( move( data ) ), reserve_len_( reserve_len ), regions_( regions )
+	{}
+
+	std::string description() const override
+	{
+		return "reserve( " + std::to_string( reserve_len_ ) + " ) and commit \"" + pretty_print( data_ ) + "\"";
+	}
+
+	void execute( ByteStream& bs ) const override
+	{
+		const auto regions = bs.writer().reserve( reserve_len_ );
+		if ( regions.size() != regions_ ) {
+			throw ExpectationViolation { "reserve() should have returned " + std::to_string( regions_ )
+										 + " region(s), but returned " + std::to_string( regions.size() ) };
+		}
+
+		size_t filled = 0;
+		for ( const auto region : regions ) {
+			filled += data_.copy( region.data(), region.size(), filled );
+		}
+		if ( filled != data_.size() ) {
+			throw ExpectationViolation { "reserve() did not return enough space for \"" + pretty_print( data_ )
+										 + "\"" };
+		}
+		bs.writer().commit( data_.size() );
+	}
+
+	constexpr std::string obj() const override { return "Writer"; }
+};
+
+struct ShrinkToFit : public Action<ByteStream>
+{
+	std::string description() const override { return "shrink_to_fit"; }
+	void execute( ByteStream& bs ) const override { bs.shrink_to_fit(); }
+};
+
+struct SetCapacity : public Action<ByteStream>
+{
+	uint64_t capacity_;
+	explicit SetCapacity( uint64_t capacity ) : capacity_( capacity ) {}
+	std::string description() const override { return "set_capacity( " + std::to_string( capacity_ ) + " )"; }
+	void execute( ByteStream& bs ) const override { bs.set_capacity( capacity_ ); }
+};
+
 struct Close : public Action<ByteStream>
 {
 	std::string description() const override { return "close"; }
@@ -119,6 +208,48 @@ struct PeekOnce : public Peek
 	}
 };
 
+struct PeekRegions : public Expectation<ByteStream>
+{
+	std::vector<std::string> output_;
+
+	explicit PeekRegions( std::vector<std::string> output ) : output_( move( output ) ) {}
+
+	std::string description() const override
+	{
+		std::string ret = "peek_regions() gives {";
+		for ( const auto& region : output_ ) {
+			ret += " \"" + pretty_print( region ) + "\"";
+		}
+		return ret + " }";
+	}
+
+	void execute( const ByteStream& bs ) const override
+	{
+		const auto regions = bs.reader().peek_regions();
+		if ( regions.size() != output_.size() ) {
+			throw ExpectationViolation { "peek_regions() should have returned " + std::to_string( output_.size() )
+										 + " region(s), but returned " + std::to_string( regions.size() ) };
+		}
+		for ( size_t i = 0; i < regions.size(); ++i ) {
+			if ( regions[i] != output_[i] ) {
+				throw ExpectationViolation { "peek_regions() region " + std::to_string( i ) + " should have been \""
+											 + pretty_print( output_[i] ) + "\", but was \""
+											 + pretty_print( regions[i] ) + "\"" };
+			}
+		}
+	}
+
+	constexpr std::string obj() const override { return "Reader"; }
+};
+
+struct PeekRegionCount : public ExpectNumber<ByteStream, size_t>
+{
+	using ExpectNumber::ExpectNumber;
+	std::string name() const override { return "peek_regions().size()"; }
+	size_t value( const ByteStream& bs ) const override { return bs.reader().peek_regions().size(); }
+	constexpr std::string obj() const override { return "Reader"; }
+};
+
 struct IsClosed : public ExpectBool<ByteStream>
 {
 	using ExpectBool::ExpectBool;
@@ -166,6 +297,20 @@ struct AvailableCapacity : public ExpectNumber<ByteStream, uint64_t>
 	constexpr std::string obj() const override { return "Writer"; }
 };
 
+struct Capacity : public ExpectNumber<ByteStream, uint64_t>
+{
+	using ExpectNumber::ExpectNumber;
+	std::string name() const override { return "capacity"; }
+	size_t value( const ByteStream& bs ) const override { return bs.capacity(); }
+};
+
+struct ResidentCapacity : public ExpectNumber<ByteStream, uint64_t>
+{
+	using ExpectNumber::ExpectNumber;
+	std::string name() const override { return "resident_capacity"; }
+	size_t value( const ByteStream& bs ) const override { return bs.resident_capacity(); }
+};
+
 struct BytesPushed : public ExpectNumber<ByteStream, uint64_t>
 {
 	using ExpectNumber::ExpectNumber;
@@ -90,6 +90,9 @@ string to_string( const TCPSenderMessage& msg )
 	if ( msg.RST ) {
 		o << " +RST";
 	}
+	if ( msg.window_scale.has_value() ) {
+		o << " window_scale=" << static_cast<unsigned>( *msg.window_scale );
+	}
 	o << ")";
 	return o.str();
 }
@@ -98,6 +98,15 @@ class TestException : public std::runtime_error
 	using std::runtime_error::runtime_error;
 };
 
+// For tests without a TestHarness: throw unless `condition` holds, saying what was expected.
+// (To compare two values, test_should_be() in test_should_be.hh reports both sides.)
+inline void expect( bool condition, const std::string& what )
+{
+	if ( not condition ) {
+		throw std::runtime_error( "expected " + what );
+	}
+}
+
 inline std::optional<std::string> test_only()
 {
 	const char* env = getenv( "TEST_ONLY" );
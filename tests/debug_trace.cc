@@ -0,0 +1,66 @@
+#include "common.hh"
+#include "debug.hh"
+#include "test_should_be.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+	try {
+		TraceRing& ring = TraceRing::this_thread();
+		expect( not ring.enabled(), "the ring to start disabled" );
+		expect( ring.records().empty(), "the ring to start empty" );
+		ring.record( TraceCategory::Reassembler, "before enable", 1, 2 );
+		expect( ring.records().empty(), "a ring never enabled to record nothing" );
+
+		ring.enable();
+		ring.record( TraceCategory::Reassembler, "write", 10, 20 );
+		ring.record( TraceCategory::Receiver, "receive", 30, 40 );
+
+		const auto records = ring.records();
+		test_should_be( records.size(), 2UL );
+		expect( records[0].category == TraceCategory::Reassembler and string { records[0].event } == "write"
+				  and records[0].arg0 == 10 and records[0].arg1 == 20,
+				"the first record" );
+		expect( records[1].category == TraceCategory::Receiver and records[1].arg0 == 30, "the second record" );
+		expect( records[0].timestamp_ns <= records[1].timestamp_ns, "the records in time order" );
+
+		ostringstream dump;
+		ring.dump( dump );
+		expect( dump.str().find( "Reassembler: write 10 20" ) != string::npos, "the dump to show the first record" );
+		expect( dump.str().find( "Receiver: receive 30 40" ) != string::npos, "the dump to show the second record" );
+
+		// The ring keeps the most recent records
+		ring.clear();
+		for ( uint64_t i = 0; i < TraceRing::kCapacity + 100; ++i ) {
+			ring.record( TraceCategory::EventLoop, "poll", i, 0 );
+		}
+		const auto recent = ring.records();
+		test_should_be( recent.size(), TraceRing::kCapacity );
+		test_should_be( recent.front().arg0, 100UL );
+		test_should_be( recent.back().arg0, TraceRing::kCapacity + 99 );
+		test_should_be( ring.total_recorded(), TraceRing::kCapacity + 100 );
+
+		// A trace point records only if its category was compiled in
+		ring.clear();
+		trace<TraceCategory::Reassembler>( "test", 1, 2 );
+		test_should_be( ring.records().size(), trace_enabled( TraceCategory::Reassembler ) ? 1UL : 0UL );
+
+		// With the ring disabled, trace points go to debug_str() instead
+		ring.disable();
+		ring.clear();
+		trace<TraceCategory::Reassembler>( "not recorded", 1, 2 );
+		expect( ring.records().empty(), "a disabled ring to record nothing" );
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
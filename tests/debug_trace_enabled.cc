@@ -0,0 +1,52 @@
+// This test compiles the EventLoop trace points in, whatever MINNOW_TRACE the rest of the build uses. (No library
+// linked into it has EventLoop trace points, so its trace<TraceCategory::EventLoop> is the only one there is.)
+#undef MINNOW_TRACE
+#define MINNOW_TRACE 0x4 // NOLINT(*-macro-usage)
+
+#include "common.hh"
+#include "debug.hh"
+#include "test_should_be.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+static_assert( trace_enabled( TraceCategory::EventLoop ) );
+static_assert( not trace_enabled( TraceCategory::Reassembler ) );
+
+int main()
+{
+	try {
+		TraceRing& ring = TraceRing::this_thread();
+
+		// Before the ring is enabled, a compiled-in trace point goes to debug_str()
+		trace<TraceCategory::EventLoop>( "before enable", 1, 2 );
+		expect( ring.records().empty(), "a ring never enabled to record nothing" );
+
+		ring.enable();
+		trace<TraceCategory::EventLoop>( "wait", 3, 4 );
+		trace<TraceCategory::EventLoop>( "serve", 5, 6 );
+
+		const auto records = ring.records();
+		test_should_be( records.size(), 2UL );
+		expect( records[0].category == TraceCategory::EventLoop and string { records[0].event } == "wait"
+				  and records[0].arg0 == 3 and records[0].arg1 == 4,
+				"the first trace point's record" );
+		expect( string { records[1].event } == "serve" and records[1].arg0 == 5 and records[1].arg1 == 6,
+				"the second trace point's record" );
+
+		ostringstream dump;
+		ring.dump( dump );
+		expect( dump.str().find( "EventLoop: wait 3 4" ) != string::npos, "the dump to show the first record" );
+		expect( dump.str().find( "EventLoop: serve 5 6" ) != string::npos, "the dump to show the second record" );
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
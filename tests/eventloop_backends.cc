@@ -0,0 +1,338 @@
+#include "common.hh"
+#include "eventloop.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "test_should_be.hh"
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+pair<FileDescriptor, FileDescriptor> make_pipe()
+{
+	array<int, 2> fds {};
+	CheckSystemCall( "pipe2", ::pipe2( fds.data(), O_CLOEXEC | O_NONBLOCK ) );
+	return { FileDescriptor { fds[0] }, FileDescriptor { fds[1] } };
+}
+
+pair<FileDescriptor, FileDescriptor> make_socketpair()
+{
+	array<int, 2> fds {};
+	CheckSystemCall( "socketpair",
+					 ::socketpair( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0, fds.data() ) );
+	return { FileDescriptor { fds[0] }, FileDescriptor { fds[1] } };
+}
+
+// An fd closed by a cancel callback while another rule is still on it, and its number reused at once. With epoll,
+// the closed fd has left the set: changing its registration must not fail with EBADF, and the new fd must be added.
+void test_closed_and_reused_fd( const EventLoop::Backend backend, const EventLoop::Dispatch dispatch )
+{
+	using Result = EventLoop::Result;
+
+	EventLoop loop { backend, dispatch };
+	auto [ours, theirs] = make_socketpair();
+	string pending;
+	loop.add_rule(
+	  "write", ours, Direction::Out, [&] { pending.erase( 0, ours.write( pending ) ); },
+	  [&] { return not pending.empty(); } );
+	loop.add_rule(
+	  "read",
+	  ours,
+	  Direction::In,
+	  [&] {
+		  string buffer;
+		  ours.read( buffer );
+	  },
+	  [] { return true; },
+	  [&] { ours.close(); } );
+	const int number = ours.fd_num();
+
+	CheckSystemCall( "shutdown", ::shutdown( theirs.fd_num(), SHUT_WR ) ); // EOF, but no hangup
+	expect( loop.wait_next_event( 0 ) == Result::Success, "success reading EOF" );
+	loop.wait_next_event( 0 );
+	expect( ours.closed(), "the fd closed on cancel" );
+
+	auto [next_ours, next_theirs] = make_socketpair();
+	expect( next_ours.fd_num() == number, "the fd number to be reused" );
+	bool served = false;
+	loop.add_rule( "read again", next_ours, Direction::In, [&] {
+		string buffer;
+		next_ours.read( buffer );
+		served = true;
+	} );
+	next_theirs.write( "x" );
+	expect( loop.wait_next_event( 0 ) == Result::Success and served, "the new fd to be served" );
+}
+
+void test_backend( const EventLoop::Backend backend )
+{
+	using Result = EventLoop::Result;
+
+	{
+		// Data on a pipe is delivered to its rule, and the rule is cancelled at EOF
+		EventLoop loop { backend };
+		expect( loop.backend() == backend, "the requested backend" );
+		auto [read_end, write_end] = make_pipe();
+		string received;
+		bool cancelled = false;
+		loop.add_rule(
+		  "read", read_end, Direction::In,
+		  [&] {
+			  string buffer;
+			  read_end.read( buffer );
+			  received += buffer;
+		  },
+		  [] { return true; },
+		  [&] { cancelled = true; } );
+
+		expect( loop.wait_next_event( 0 ) == Result::Timeout, "a timeout with nothing to read" );
+		write_end.write( "hello" );
+		expect( loop.wait_next_event( 0 ) == Result::Success, "success once data arrived" );
+		expect( received == "hello", "the data to be read" );
+
+		write_end.close();
+		expect( loop.wait_next_event( 0 ) == Result::Success, "success at EOF" );
+		expect( loop.wait_next_event( 0 ) == Result::Exit, "exit after EOF" );
+		expect( cancelled, "the rule to be cancelled at EOF" );
+	}
+
+	{
+		// A rule is only served while interested, and an uninterested loop exits
+		EventLoop loop { backend };
+		auto [read_end, write_end] = make_pipe();
+		bool interested = false;
+		unsigned int served = 0;
+		loop.add_rule(
+		  "read", read_end, Direction::In,
+		  [&] {
+			  string buffer;
+			  read_end.read( buffer );
+			  ++served;
+		  },
+		  [&] { return interested; } );
+
+		write_end.write( "x" );
+		expect( loop.wait_next_event( 0 ) == Result::Exit, "exit with no interested rule" );
+		interested = true;
+		expect( loop.wait_next_event( 0 ) == Result::Success, "success once interested" );
+		test_should_be( served, 1U );
+		interested = false;
+		write_end.write( "y" );
+		expect( loop.wait_next_event( 0 ) == Result::Exit, "exit once uninterested again" );
+		test_should_be( served, 1U );
+	}
+
+	{
+		// Two rules on one fd, in each direction
+		EventLoop loop { backend };
+		auto [local, remote] = make_socketpair();
+		unsigned int reads = 0;
+		unsigned int writes = 0;
+		loop.add_rule( "read", local, Direction::In, [&] {
+			string buffer;
+			local.read( buffer );
+			++reads;
+		} );
+		loop.add_rule(
+		  "write",
+		  local,
+		  Direction::Out,
+		  [&] { writes += local.write( "ping" ) > 0 ? 1 : 0; },
+		  [&] { return writes < 2; } );
+
+		expect( loop.wait_next_event( 0 ) == Result::Success, "the write rule to be served" );
+		expect( loop.wait_next_event( 0 ) == Result::Success, "the write rule to be served again" );
+		expect( loop.wait_next_event( 0 ) == Result::Timeout, "a timeout once the writer is done" );
+		remote.write( "pong" );
+		expect( loop.wait_next_event( 0 ) == Result::Success, "the read rule to be served" );
+		test_should_be( reads, 1U );
+		test_should_be( writes, 2U );
+	}
+
+	{
+		// A regular file is always ready, as poll(2) reports it (epoll refuses it)
+		EventLoop loop { backend };
+		FILE* const file = notnull( "tmpfile", tmpfile() );
+		FileDescriptor fd { CheckSystemCall( "dup", ::dup( fileno( file ) ) ) };
+		static_cast<void>( fclose( file ) );
+		fd.write( "file contents" );
+		CheckSystemCall( "lseek", static_cast<int>( ::lseek( fd.fd_num(), 0, SEEK_SET ) ) );
+		string received;
+		loop.add_rule( "file", fd, Direction::In, [&] {
+			string buffer;
+			fd.read( buffer );
+			received += buffer;
+		} );
+
+		expect( loop.wait_next_event( -1 ) == Result::Success, "a regular file to be readable" );
+		expect( received == "file contents", "the file's contents" );
+		expect( loop.wait_next_event( -1 ) == Result::Success, "a regular file to be readable at EOF" );
+		expect( loop.wait_next_event( -1 ) == Result::Exit, "exit after the file's EOF" );
+	}
+
+	{
+		// Cancelling a rule through its handle removes it without the cancel callback
+		EventLoop loop { backend };
+		auto [read_end, write_end] = make_pipe();
+		bool cancelled = false;
+		auto handle = loop.add_rule(
+		  "read", read_end, Direction::In, [] {}, [] { return true; }, [&] { cancelled = true; } );
+		expect( loop.wait_next_event( 0 ) == Result::Timeout, "a timeout before cancellation" );
+		handle.cancel();
+		expect( loop.wait_next_event( 0 ) == Result::Exit, "exit after cancellation" );
+		expect( not cancelled, "no cancel callback for a cancelled rule" );
+
+		// The same fd can be watched again by a new rule
+		bool served = false;
+		loop.add_rule( "read again", read_end, Direction::In, [&] {
+			string buffer;
+			read_end.read( buffer );
+			served = true;
+		} );
+		write_end.write( "z" );
+		expect( loop.wait_next_event( 0 ) == Result::Success and served, "the new rule to be served" );
+	}
+
+	{
+		// A writer whose reader has gone away hangs up
+		EventLoop loop { backend };
+		auto [read_end, write_end] = make_pipe();
+		bool cancelled = false;
+		loop.add_rule(
+		  "write", write_end, Direction::Out, [] {}, [] { return true; }, [&] { cancelled = true; } );
+		read_end.close();
+		loop.wait_next_event( 0 );
+		expect( loop.wait_next_event( 0 ) == Result::Exit, "exit after the reader hung up" );
+		expect( cancelled, "the writer's rule to be cancelled" );
+	}
+
+	test_closed_and_reused_fd( backend, EventLoop::Dispatch::One );
+}
+
+void test_batch( const EventLoop::Backend backend )
+{
+	using Dispatch = EventLoop::Dispatch;
+	using Result = EventLoop::Result;
+
+	{
+		// Every ready fd is served by one wait
+		EventLoop loop { backend, Dispatch::Batch };
+		vector<pair<FileDescriptor, FileDescriptor>> pipes;
+		unsigned int served = 0;
+		for ( size_t i = 0; i < 4; ++i ) {
+			pipes.push_back( make_pipe() );
+			loop.add_rule( "read", pipes.back().first, Direction::In, [&, i] {
+				string buffer;
+				pipes.at( i ).first.read( buffer );
+				++served;
+			} );
+		}
+
+		for ( auto& [read_end, write_end] : pipes ) {
+			write_end.write( "x" );
+		}
+		expect( loop.wait_next_event( 0 ) == Result::Success, "success with ready fds" );
+		test_should_be( served, 4U );
+		test_should_be( loop.statistics().waits, 1UL );
+		test_should_be( loop.statistics().callbacks, 4UL );
+
+		pipes.at( 2 ).second.write( "y" );
+		expect( loop.wait_next_event( 0 ) == Result::Success and served == 5, "one more fd served" );
+		expect( loop.wait_next_event( 0 ) == Result::Timeout, "a timeout with nothing ready" );
+	}
+
+	{
+		// A rule that busy-waits is cancelled on its own, and the others are still served
+		EventLoop loop { backend, Dispatch::Batch };
+		auto [stuck_read, stuck_write] = make_pipe();
+		auto [read_end, write_end] = make_pipe();
+		bool stuck_cancelled = false;
+		bool stuck_error = false;
+		unsigned int served = 0;
+		loop.add_rule(
+		  "stuck", stuck_read, Direction::In, [] {}, [] { return true; }, [&] { stuck_cancelled = true; },
+		  [&] { stuck_error = true; } );
+		loop.add_rule( "read", read_end, Direction::In, [&] {
+			string buffer;
+			read_end.read( buffer );
+			++served;
+		} );
+
+		stuck_write.write( "x" );
+		write_end.write( "x" );
+		expect( loop.wait_next_event( 0 ) == Result::Success, "success despite the busy-waiting rule" );
+		expect( stuck_cancelled and stuck_error, "the busy-waiting rule to be cancelled with an error" );
+		test_should_be( served, 1U );
+
+		write_end.write( "x" );
+		expect( loop.wait_next_event( 0 ) == Result::Success and served == 2, "the loop to keep going" );
+	}
+
+	test_closed_and_reused_fd( backend, Dispatch::Batch );
+
+	{
+		// Dispatch::One still stops the loop on a busy wait
+		EventLoop loop { backend, Dispatch::One };
+		auto [read_end, write_end] = make_pipe();
+		loop.add_rule( "stuck", read_end, Direction::In, [] {} );
+		write_end.write( "x" );
+		bool threw = false;
+		try {
+			loop.wait_next_event( 0 );
+		} catch ( const runtime_error& ) {
+			threw = true;
+		}
+		expect( threw, "Dispatch::One to throw on a busy wait" );
+	}
+
+	{
+		// Non-fd rules take bounded turns; one that never loses interest is cancelled after 128 calls
+		EventLoop loop { backend, Dispatch::Batch };
+		unsigned int first = 0;
+		unsigned int second = 0;
+		unsigned int forever = 0;
+		loop.add_rule( "first", [&] { ++first; }, [&] { return first < 40; } );
+		loop.add_rule( "second", [&] { ++second; }, [&] { return second < 40; } );
+		loop.add_rule( "forever", [&] { ++forever; } );
+
+		expect( loop.wait_next_event( 0 ) == Result::Success, "success serving non-fd rules" );
+		expect( first == EventLoop::BATCH_RULE_BUDGET and second == EventLoop::BATCH_RULE_BUDGET,
+				"each non-fd rule to get one turn" );
+		while ( loop.wait_next_event( 0 ) == Result::Success ) {}
+		test_should_be( first, 40U );
+		test_should_be( second, 40U );
+		test_should_be( forever, 128U ); // the rule that never lost interest is cancelled after 128 calls
+	}
+}
+
+} // namespace
+
+int main()
+{
+	for ( const auto backend : { EventLoop::Backend::Poll, EventLoop::Backend::Epoll } ) {
+		try {
+			test_backend( backend );
+			test_batch( backend );
+		} catch ( const exception& e ) {
+			const string_view name = backend == EventLoop::Backend::Epoll ? "epoll" : "poll";
+			cerr << "Exception (" << name << " backend): " << e.what() << "\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+#include "common.hh"
+#include "eventloop_group.hh"
+#include "socket.hh"
+#include "test_should_be.hh"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void echo( EventLoop& loop, TCPSocket socket )
+{
+	socket.set_blocking( false );
+	auto connection = make_shared<TCPSocket>( std::move( socket ) );
+	loop.add_rule( "echo", *connection, Direction::In, [connection] {
+		string buffer;
+		connection->read( buffer );
+		connection->write( buffer );
+	} );
+}
+
+void task_test()
+{
+	constexpr size_t loops = 4;
+	constexpr size_t producers = 4;
+	constexpr uint64_t tasks_per_producer = 20000;
+
+	array<uint64_t, loops> counts {}; // each only touched by its own loop
+	array<thread::id, loops> threads {};
+	atomic<bool> wrong_thread = false;
+	atomic<uint64_t> forwarded = 0;
+	{
+		EventLoopGroup group { loops, echo };
+		test_should_be( group.size(), loops );
+
+		vector<thread> posters;
+		for ( size_t p = 0; p < producers; ++p ) {
+			posters.emplace_back( [&] {
+				for ( uint64_t i = 0; i < tasks_per_producer; ++i ) {
+					const size_t index = i % loops;
+					group.post( index, [&, index]( EventLoop& ) {
+						if ( counts[index]++ == 0 ) {
+							threads[index] = this_thread::get_id();
+						} else if ( threads[index] != this_thread::get_id() ) {
+							wrong_thread = true;
+						}
+					} );
+				}
+			} );
+		}
+		for ( auto& poster : posters ) {
+			poster.join();
+		}
+
+		// a loop can post to another, and cannot stop the group
+		atomic<bool> refused = false;
+		group.post( 0, [&]( EventLoop& ) {
+			try {
+				group.stop();
+			} catch ( const runtime_error& ) {
+				refused = true;
+			}
+			group.post( 1, [&]( EventLoop& ) { ++forwarded; } );
+		} );
+		while ( forwarded == 0 ) {
+			this_thread::yield();
+		}
+		expect( refused, "stop() from a loop to be refused" );
+	}
+
+	for ( size_t i = 0; i < loops; ++i ) {
+		test_should_be( counts[i], producers * tasks_per_producer / loops );
+	}
+	expect( not wrong_thread, "each loop's tasks to run on its own thread" );
+	expect( threads[0] != threads[1], "loops to run on different threads" );
+}
+
+void failure_test()
+{
+	EventLoopGroup group { 2, echo };
+	group.post( 0, []( EventLoop& ) { throw runtime_error( "task failed" ); } );
+
+	// once the loop has stopped, posting to it rethrows what stopped it
+	bool rethrown = false;
+	while ( not rethrown ) {
+		try {
+			group.post( 0, []( EventLoop& ) {} );
+			this_thread::yield();
+		} catch ( const runtime_error& e ) {
+			expect( string { e.what() } == "task failed", "post() to rethrow the task's exception" );
+			rethrown = true;
+		}
+	}
+
+	// the other loop carries on
+	atomic<bool> ran = false;
+	group.post( 1, [&]( EventLoop& ) { ran = true; } );
+	while ( not ran ) {
+		this_thread::yield();
+	}
+
+	bool reported = false;
+	try {
+		group.stop();
+	} catch ( const runtime_error& e ) {
+		reported = string { e.what() } == "task failed";
+	}
+	expect( reported, "stop() to rethrow the failed loop's exception" );
+	group.stop();
+}
+
+void connection_test( const EventLoopGroup::Placement placement )
+{
+	constexpr size_t loops = 4;
+	constexpr size_t clients = 12;
+
+	EventLoopGroup group { loops, echo, placement };
+	TCPSocket listener;
+	listener.set_reuseaddr();
+	listener.bind( Address { "127.0.0.1", 0 } );
+	listener.listen( clients );
+
+	vector<TCPSocket> sockets( clients );
+	array<size_t, loops> assigned {};
+	for ( auto& socket : sockets ) {
+		socket.connect( listener.local_address() );
+		++assigned.at( group.assign( listener.accept() ) );
+	}
+	if ( placement == EventLoopGroup::Placement::LeastLoaded ) {
+		for ( const size_t count : assigned ) {
+			expect( count >= 1, "connections spread over every loop" );
+		}
+	}
+
+	for ( size_t i = 0; i < clients; ++i ) {
+		sockets[i].write( "hello " + to_string( i ) );
+	}
+	for ( size_t i = 0; i < clients; ++i ) {
+		const string expected = "hello " + to_string( i );
+		string received;
+		while ( received.size() < expected.size() ) {
+			string buffer;
+			sockets[i].read( buffer );
+			expect( not sockets[i].eof(), "the connection to stay open" );
+			received += buffer;
+		}
+		expect( received == expected, "the data to be echoed" );
+	}
+
+	sockets.clear();
+	group.stop();
+	group.stop();
+}
+
+} // namespace
+
+int main()
+{
+	try {
+		task_test();
+		failure_test();
+		connection_test( EventLoopGroup::Placement::LeastLoaded );
+		connection_test( EventLoopGroup::Placement::Hash );
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
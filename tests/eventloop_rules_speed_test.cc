@@ -0,0 +1,126 @@
+#include "eventloop.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string_view>
+#include <sys/eventfd.h>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+size_t allocations = 0; // NOLINT(*-avoid-non-const-global-variables)
+} // namespace
+
+// Count every allocation in the program
+void* operator new( size_t size )
+{
+	++allocations;
+	void* ptr = malloc( size > 0 ? size : 1 ); // NOLINT(*-no-malloc, *-owning-memory)
+	if ( ptr == nullptr ) {
+		throw bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete( void* ptr ) noexcept
+{
+	free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+void operator delete( void* ptr, size_t /* size */ ) noexcept
+{
+	free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+struct Counters
+{
+	uint64_t calls {};
+	uint64_t checks {};
+};
+
+// Add `rules` rules (on idle eventfds, or without fds), each with callbacks that capture a few references as
+// typical rules do, and report the allocations per add_rule and the time per rule of a wait that serves none
+void rules_test( fstream& debug_output, const size_t rules, const bool fd_rules )
+{
+	constexpr size_t waits = 2000;
+	const string_view kind = fd_rules ? "fd rules" : "non-fd rules";
+
+	EventLoop loop {};
+	vector<FileDescriptor> fds;
+	fds.reserve( rules );
+	for ( size_t i = 0; fd_rules and i < rules; ++i ) {
+		fds.emplace_back( CheckSystemCall( "eventfd", ::eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK ) ) );
+	}
+	const size_t category = loop.add_category( "idle" );
+	Counters counters;
+	bool interested = true;
+
+	const size_t allocations_before = allocations;
+	for ( size_t i = 0; i < rules; ++i ) {
+		if ( fd_rules ) {
+			loop.add_rule(
+			  category,
+			  fds[i],
+			  Direction::In,
+			  [&counters, &fds, i] { counters.calls += fds[i].read_count(); },
+			  [&counters, &interested] {
+				  ++counters.checks;
+				  return interested;
+			  } );
+		} else {
+			loop.add_rule(
+			  category, [&counters] { ++counters.calls; }, [&counters] { return ++counters.checks == 0; } );
+		}
+	}
+	const double allocations_per_rule
+	  = static_cast<double>( allocations - allocations_before ) / static_cast<double>( rules );
+
+	loop.wait_next_event( 0 ); // registers the fds with epoll
+	const auto start_time = steady_clock::now();
+	for ( size_t i = 0; i < waits; ++i ) {
+		loop.wait_next_event( 0 );
+	}
+	const auto stop_time = steady_clock::now();
+	if ( counters.calls != 0 ) {
+		throw runtime_error( "an idle rule was served" );
+	}
+
+	const double ns_per_rule = duration_cast<duration<double, nano>>( stop_time - start_time ).count()
+							   / static_cast<double>( waits * rules );
+
+	cout << "Adding " << rules << " " << kind << " made " << fixed << setprecision( 2 ) << allocations_per_rule
+		 << " allocations per rule; each wait took " << ns_per_rule << " ns per rule.\n";
+	debug_output << "        EventLoop with " << rules << " " << kind << ":" << string( 13 - kind.size(), ' ' )
+				 << fixed << setprecision( 2 ) << setw( 5 ) << allocations_per_rule << " allocations/rule, "
+				 << setw( 6 ) << ns_per_rule << " ns/rule per wait\n";
+}
+
+void program_body()
+{
+	fstream debug_output;
+	debug_output.open( "/dev/tty" );
+
+	rules_test( debug_output, 1000, false );
+	rules_test( debug_output, 1000, true );
+}
+
+int main()
+{
+	try {
+		program_body();
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+#include "eventloop.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Wait for `events` events on one active pipe while `idle_fds` other fds (eventfds that never become readable)
+// are watched too, and report the time per event
+double latency_test( fstream& debug_output,
+					 const EventLoop::Backend backend,
+					 const size_t idle_fds, // NOLINT(bugprone-easily-swappable-parameters)
+					 const size_t events )
+{
+	EventLoop loop { backend };
+	if ( loop.backend() != backend ) {
+		throw runtime_error( "EventLoop did not use the requested backend" );
+	}
+
+	vector<FileDescriptor> idle;
+	idle.reserve( idle_fds );
+	const size_t idle_category = loop.add_category( "idle" );
+	for ( size_t i = 0; i < idle_fds; ++i ) {
+		idle.emplace_back( CheckSystemCall( "eventfd", ::eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK ) ) );
+		loop.add_rule( idle_category, idle.back(), Direction::In, [] {
+			throw runtime_error( "an idle fd became readable" );
+		} );
+	}
+
+	array<int, 2> fds {};
+	CheckSystemCall( "pipe2", ::pipe2( fds.data(), O_CLOEXEC | O_NONBLOCK ) );
+	FileDescriptor read_end { fds[0] };
+	FileDescriptor write_end { fds[1] };
+	size_t served = 0;
+	string buffer;
+	loop.add_rule( "active", read_end, Direction::In, [&] {
+		read_end.read( buffer );
+		served += buffer.size();
+	} );
+
+	// The first wait registers every fd with epoll, so it is left out of the timing
+	write_end.write( "x" );
+	loop.wait_next_event( -1 );
+
+	const auto start_time = steady_clock::now();
+	for ( size_t i = 0; i < events; ++i ) {
+		write_end.write( "x" );
+		if ( loop.wait_next_event( -1 ) != EventLoop::Result::Success ) {
+			throw runtime_error( "EventLoop did not report the active fd" );
+		}
+	}
+	const auto stop_time = steady_clock::now();
+
+	if ( served != events + 1 ) {
+		throw runtime_error( "EventLoop served the active fd " + to_string( served ) + " times, not "
+							 + to_string( events + 1 ) );
+	}
+
+	const double us_per_event
+	  = duration_cast<duration<double, micro>>( stop_time - start_time ).count() / static_cast<double>( events );
+	const string_view name = backend == EventLoop::Backend::Epoll ? "epoll" : "poll";
+	cout << "EventLoop (" << name << ") with " << idle_fds << " idle fds took " << fixed << setprecision( 2 )
+		 << us_per_event << " us per event.\n";
+	debug_output << "        EventLoop latency (" << name << ", " << setw( 5 ) << idle_fds
+				 << " idle fds):" << string( 6 - name.size(), ' ' ) << fixed << setprecision( 2 ) << setw( 8 )
+				 << us_per_event << " us\n";
+
+	return us_per_event;
+}
+
+void program_body()
+{
+	fstream debug_output;
+	debug_output.open( "/dev/tty" );
+
+	// Each idle fd is one eventfd; make room for them if the soft limit is low
+	constexpr size_t idle_fds = 10000;
+	rlimit limit {};
+	CheckSystemCall( "getrlimit", ::getrlimit( RLIMIT_NOFILE, &limit ) );
+	if ( limit.rlim_cur < idle_fds + 64 ) {
+		limit.rlim_cur = min<rlim_t>( limit.rlim_max, idle_fds + 64 );
+		CheckSystemCall( "setrlimit", ::setrlimit( RLIMIT_NOFILE, &limit ) );
+	}
+	const size_t idle_count = min<size_t>( idle_fds, limit.rlim_cur - 64 );
+
+	for ( const size_t idle : { size_t { 0 }, size_t { 100 }, idle_count } ) {
+		const double poll_us = latency_test( debug_output, EventLoop::Backend::Poll, idle, 2000 );
+		const double epoll_us = latency_test( debug_output, EventLoop::Backend::Epoll, idle, 2000 );
+		if ( idle == idle_count and epoll_us >= poll_us ) {
+			throw runtime_error( "epoll was no faster than poll with " + to_string( idle ) + " idle fds" );
+		}
+	}
+}
+
+int main()
+{
+	try {
+		program_body();
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+#include "common.hh"
+#include "eventloop.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "test_should_be.hh"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <fcntl.h>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+void test_timers( const EventLoop::Backend backend, const EventLoop::Dispatch dispatch )
+{
+	using Result = EventLoop::Result;
+
+	{
+		// A pending timer keeps the loop running, and an untimed wait returns once it fires
+		EventLoop loop { backend, dispatch };
+		const size_t category = loop.add_category( "timer" );
+		vector<int> fired;
+		const auto start = steady_clock::now();
+		loop.add_timer( category, 20, [&] { fired.push_back( 20 ); } );
+		loop.add_timer( category, 5, [&] { fired.push_back( 5 ); } );
+		auto cancelled = loop.add_timer( category, 10, [&] { fired.push_back( 10 ); } );
+		cancelled.cancel();
+		test_should_be( loop.pending_timers(), 2UL );
+
+		expect( loop.wait_next_event( 0 ) == Result::Timeout, "a timeout before any timer is due" );
+		while ( loop.pending_timers() > 0 ) {
+			expect( loop.wait_next_event( -1 ) == Result::Success, "success when a timer fires" );
+		}
+		expect( steady_clock::now() - start >= milliseconds { 20 }, "the timers not to fire early" );
+		expect( fired == vector<int> { 5, 20 }, "the timers to fire in order, without the cancelled one" );
+		test_should_be( loop.statistics().timers, 2UL );
+		expect( loop.wait_next_event( -1 ) == Result::Exit, "exit once no timer is pending" );
+		cancelled.cancel();
+	}
+
+	{
+		// The next expiry bounds the wait for an fd, and a handle outlives its loop
+		array<int, 2> fds {};
+		CheckSystemCall( "pipe2", ::pipe2( fds.data(), O_CLOEXEC | O_NONBLOCK ) );
+		FileDescriptor read_end { fds[0] };
+		const FileDescriptor write_end { fds[1] };
+
+		optional<EventLoop::TimerHandle> handle;
+		{
+			EventLoop loop { backend, dispatch };
+			loop.add_rule( "read", read_end, Direction::In, [&] {
+				string buffer;
+				read_end.read( buffer );
+			} );
+
+			bool fired = false;
+			const size_t category = loop.add_category( "timer" );
+			loop.add_timer( category, 10, [&] { fired = true; } );
+			handle = loop.add_timer( category, 100'000, [] { throw runtime_error( "a cancelled timer fired" ); } );
+
+			const auto start = steady_clock::now();
+			expect( loop.wait_next_event( 1000 ) == Result::Success, "success when the timer fires" );
+			expect( fired, "the timer to fire" );
+			expect( steady_clock::now() - start < milliseconds { 500 }, "the wait to end at the expiry" );
+
+			// a timer re-armed from its own callback fires on a later wait
+			unsigned rearmed = 0;
+			function<void()> tick = [&] {
+				if ( ++rearmed < 3 ) {
+					loop.add_timer( category, 1, tick );
+				}
+			};
+			loop.add_timer( category, 1, tick );
+			while ( rearmed < 3 ) {
+				loop.wait_next_event( -1 );
+			}
+
+			// a timer armed with UINT64_MAX as "never" stays pending rather than wrapping around to now
+			auto never
+			  = loop.add_timer( category, UINT64_MAX, [] { throw runtime_error( "a UINT64_MAX timer fired" ); } );
+			expect( loop.wait_next_event( 20 ) == Result::Timeout, "a timeout with only far-off timers" );
+			never.cancel();
+
+			handle->cancel();
+			test_should_be( loop.pending_timers(), 0UL );
+		}
+		handle->cancel();
+	}
+}
+
+} // namespace
+
+int main()
+{
+	for ( const auto backend : { EventLoop::Backend::Poll, EventLoop::Backend::Epoll } ) {
+		try {
+			for ( const auto dispatch : { EventLoop::Dispatch::One, EventLoop::Dispatch::Batch } ) {
+				test_timers( backend, dispatch );
+			}
+		} catch ( const exception& e ) {
+			const string_view name = backend == EventLoop::Backend::Epoll ? "epoll" : "poll";
+			cerr << "Exception (" << name << " backend): " << e.what() << "\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
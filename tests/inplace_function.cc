@@ -0,0 +1,87 @@
+#include "common.hh"
+#include "inplace_function.hh"
+#include "test_should_be.hh"
+
+#include <array>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+// Counts the live copies of itself
+struct Counted
+{
+	shared_ptr<int> count;
+
+	explicit Counted( shared_ptr<int> c ) : count( std::move( c ) ) { ++*count; }
+	Counted( const Counted& other ) : count( other.count ) { ++*count; }
+	Counted( Counted&& other ) noexcept : count( other.count ) { ++*count; }
+	Counted& operator=( const Counted& ) = delete;
+	Counted& operator=( Counted&& ) = delete;
+	~Counted() { --*count; }
+
+	int operator()( int x ) const { return x + 1; }
+};
+
+void test()
+{
+	using Function = InplaceFunction<int( int )>;
+
+	int calls = 0;
+	int* const calls_ptr = &calls;
+	const Function by_reference = [&calls]( int x ) { return calls += x; };
+	static_assert( Function::stored_in_place<decltype( [calls_ptr]( int x ) { return *calls_ptr + x; } )>() );
+	expect( by_reference( 2 ) == 2 and by_reference( 3 ) == 5, "a lambda capturing a reference to be called" );
+
+	Function empty;
+	expect( not empty and static_cast<bool>( by_reference ), "only a function with a target to be true" );
+
+	// Copies, moves and destruction are each balanced, in place and on the heap
+	const auto count = make_shared<int>( 0 );
+	{
+		Function small = Counted { count };
+		const Function copy = small;
+		expect( *count == 2 and copy( 1 ) == 2, "a copy of a small target" );
+		Function moved = std::move( small );
+		expect( *count == 2 and not small and moved( 2 ) == 3, "a move of a small target" ); // NOLINT
+		moved = nullptr;
+		test_should_be( *count, 1 );
+	}
+	test_should_be( *count, 0 );
+
+	{
+		array<char, 64> padding {};
+		Function large = [padding, counted = Counted { count }]( int x ) { return counted( x ) + padding[0]; };
+		const Function copy = large;
+		Function moved = std::move( large );
+		expect( *count == 2 and copy( 1 ) == 2 and moved( 1 ) == 2, "a large target to work from the heap" );
+		moved = copy;
+		test_should_be( *count, 2 );
+	}
+	test_should_be( *count, 0 );
+
+	// A std::function fits in place, so wrapping one does not allocate twice
+	const std::function<int( int )> standard = []( int x ) { return x * 2; };
+	static_assert( Function::stored_in_place<std::function<int( int )>>() );
+	test_should_be( Function { standard }( 4 ), 8 );
+}
+
+} // namespace
+
+int main()
+{
+	try {
+		test();
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+#include "byte_stream_test_harness.hh"
+#include "reassembler_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+	try {
+		for ( const auto storage : { Reassembler::Storage::Segments, Reassembler::Storage::StagingRing } ) {
+			{
+				ReassemblerTestHarness test { "batch in order", 65000, storage };
+
+				test.execute( InsertBatch { { "abc", 0 }, { "def", 3 }, { "ghi", 6 } } );
+				test.execute( BytesPushed( 9 ) );
+				test.execute( BytesPending( 0 ) );
+				test.execute( ReadAll( "abcdefghi" ) );
+			}
+
+			{
+				ReassemblerTestHarness test { "batch out of order", 65000, storage };
+
+				test.execute(
+				  InsertBatch { { "ghi", 6 }, Insert { "jk", 9 }.is_last(), { "abc", 0 }, { "def", 3 } } );
+				test.execute( BytesPending( 0 ) );
+				test.execute( ReadAll( "abcdefghijk" ) );
+				test.execute( IsFinished( true ) );
+			}
+
+			{
+				ReassemblerTestHarness test { "batch with holes", 65000, storage };
+
+				test.execute( InsertBatch { { "d", 3 }, { "b", 1 }, { "bcd", 1 }, { "fg", 5 } } );
+				test.execute( BytesPushed( 0 ) );
+				test.execute( BytesPending( 5 ) );
+
+				test.execute( InsertBatch { { "e", 4 }, { "a", 0 } } );
+				test.execute( BytesPending( 0 ) );
+				test.execute( ReadAll( "abcdefg" ) );
+			}
+
+			{
+				// The batch merges with what is already buffered, on both sides of it
+				ReassemblerTestHarness test { "batch around buffered data", 65000, storage };
+
+				test.execute( Insert { "c", 2 } );
+				test.execute( Insert { "ghij", 6 } );
+				test.execute( BytesPending( 5 ) );
+
+				test.execute( InsertBatch { { "bcde", 1 }, { "fghijkl", 5 }, { "n", 13 } } );
+				test.execute( BytesPushed( 0 ) );
+				test.execute( BytesPending( 12 ) );
+
+				test.execute( InsertBatch { { "m", 12 }, { "a", 0 } } );
+				test.execute( BytesPending( 0 ) );
+				test.execute( ReadAll( "abcdefghijklmn" ) );
+			}
+
+			{
+				// The contiguous prefix catches up with buffered data, which then continues the stream
+				ReassemblerTestHarness test { "batch fills the gap", 65000, storage };
+
+				test.execute( Insert { "def", 3 } );
+				test.execute( InsertBatch { { "h", 7 }, { "ab", 0 }, { "bc", 1 } } );
+				test.execute( BytesPushed( 6 ) );
+				test.execute( BytesPending( 1 ) );
+				test.execute( ReadAll( "abcdef" ) );
+			}
+
+			{
+				ReassemblerTestHarness test { "batch beyond capacity", 4, storage };
+
+				test.execute( InsertBatch { Insert { "efgh", 4 }.is_last(), { "cdef", 2 }, { "ab", 0 } } );
+				test.execute( BytesPushed( 4 ) );
+				test.execute( BytesPending( 0 ) );
+				test.execute( ReadAll( "abcd" ) );
+				test.execute( IsFinished( false ) );
+
+				test.execute( InsertBatch { { "gh", 6 }, { "zz", 2 } } );
+				test.execute( BytesPending( 2 ) );
+				test.execute( InsertBatch { Insert { "efgh", 4 }.is_last() } );
+				test.execute( ReadAll( "efgh" ) );
+				test.execute( IsFinished( true ) );
+			}
+
+			{
+				ReassemblerTestHarness test { "batch of retransmissions", 65000, storage };
+
+				test.execute( Insert { "abcd", 0 } );
+				test.execute( InsertBatch { { "ab", 0 }, { "bcd", 1 }, Insert { "", 4 }.is_last() } );
+				test.execute( BytesPushed( 4 ) );
+				test.execute( BytesPending( 0 ) );
+				test.execute( ReadAll( "abcd" ) );
+				test.execute( IsFinished( true ) );
+			}
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
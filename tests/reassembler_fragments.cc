@@ -0,0 +1,124 @@
+#include "byte_stream_test_harness.hh"
+#include "reassembler_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+	try {
+		{
+			// Each fragment costs far more than the byte it holds
+			ReassemblerTestHarness test { "memory counts fragment metadata", 65000 };
+
+			test.execute( MemoryUsedBetween( 0, 0 ) );
+			for ( uint64_t i = 1; i < 2000; i += 2 ) {
+				test.execute( Insert { "x", i } );
+			}
+			test.execute( BytesPending( 1000 ) );
+			test.execute( MemoryUsedBetween( 32 * 1000, 1000 * 1000 ) );
+		}
+
+		{
+			// A substring that adds most of its bytes is kept whole
+			ReassemblerTestHarness test { "memory counts payloads", 65000 };
+
+			test.execute( Insert { string( 1500, 'x' ), 10 } );
+			test.execute( Insert { string( 1500, 'y' ), 1000 } );
+			test.execute( BytesPending( 2490 ) );
+			test.execute( MemoryUsedBetween( 3000, 4000 ) );
+			test.execute( Insert { "abcdefghij", 0 } );
+			test.execute( ReadAll( "abcdefghij" + string( 1500, 'x' ) + string( 990, 'y' ) ) );
+		}
+
+		{
+			// With a limit, a substring that adds a few bytes does not keep its whole payload alive
+			ReassemblerTestHarness test { "payloads are trimmed to the bytes kept", 65000 };
+
+			test.execute( SetMaxFragments( 1000 ) );
+			test.execute( Insert { string( 1500, 'x' ), 20 } );
+			test.execute( Insert { string( 1500, 'y' ), 10 } );
+			test.execute( BytesPending( 1510 ) );
+			test.execute( MemoryUsedBetween( 1500, 2000 ) );
+			test.execute( Insert { string( 10, 'z' ), 0 } );
+			test.execute( ReadAll( string( 10, 'z' ) + string( 10, 'y' ) + string( 1500, 'x' ) ) );
+		}
+
+		{
+			ReassemblerTestHarness test { "fragment limit drops the furthest fragments", 65000 };
+
+			const string data = "abcdefghijklmnopqrst";
+			test.execute( SetMaxFragments( 8 ) );
+			for ( uint64_t i = 1; i < data.size(); i += 2 ) {
+				test.execute( Insert { data.substr( i, 1 ), i } );
+			}
+
+			// The ninth fragment went over the limit, so the store dropped back to seven (1 through 13)
+			test.execute( BytesPending( 8 ) );
+			test.execute( Insert { "a", 0 } );
+			test.execute( BytesPending( 7 ) );
+			test.execute( ReadAll( "ab" ) );
+
+			test.execute( Insert { data.substr( 2, 18 ), 2 } );
+			test.execute( BytesPending( 0 ) );
+			test.execute( ReadAll( data.substr( 2 ) ) );
+		}
+
+		{
+			ReassemblerTestHarness test { "fragment limit coalesces adjacent fragments", 65000 };
+
+			test.execute( SetMaxFragments( 4 ) );
+			test.execute( Insert { "b", 1 } );
+			test.execute( Insert { "c", 2 } );
+			test.execute( Insert { "d", 3 } );
+			test.execute( Insert { "f", 5 } );
+			test.execute( Insert { "h", 7 } );
+			test.execute( BytesPending( 5 ) );
+
+			test.execute( Insert { "j", 9 } );
+			test.execute( Insert { "l", 11 } );
+			test.execute( BytesPending( 6 ) );
+
+			test.execute( Insert { "a", 0 } );
+			test.execute( ReadAll( "abcd" ) );
+			test.execute( BytesPending( 3 ) );
+			test.execute( Insert { "efghijkl", 4 } );
+			test.execute( ReadAll( "efghijkl" ) );
+		}
+
+		{
+			// Coalescing copies just the bytes a run covers, so the payloads behind it are freed
+			ReassemblerTestHarness test { "fragment limit coalesces payloads", 65000 };
+
+			test.execute( SetMaxFragments( 2 ) );
+			test.execute( Insert { string( 1000, 'x' ), 10 } );
+			test.execute( Insert { string( 1000, 'y' ), 1010 } );
+			test.execute( Insert { "z", 3000 } );
+			test.execute( BytesPending( 2001 ) );
+			test.execute( MemoryUsedBetween( 2000, 2500 ) );
+
+			test.execute( Insert { "abcdefghij", 0 } );
+			test.execute( ReadAll( "abcdefghij" + string( 1000, 'x' ) + string( 1000, 'y' ) ) );
+		}
+
+		{
+			ReassemblerTestHarness test {
+			  "fragment limit with a staging ring", 1000, Reassembler::Storage::StagingRing };
+
+			test.execute( SetMaxFragments( 2 ) );
+			for ( uint64_t i = 1; i < 20; i += 2 ) {
+				test.execute( Insert { "x", i } );
+			}
+			test.execute( BytesPending( 10 ) );
+			test.execute( MemoryUsedBetween( 1000, 2000 ) );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+#include "reassembler.hh"
+
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <malloc.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// Peak resident set size of this process since the last reset_peak_resident(), in bytes
+static uint64_t peak_resident_bytes()
+{
+	ifstream status { "/proc/self/status" };
+	string line;
+	while ( getline( status, line ) ) {
+		if ( line.starts_with( "VmHWM:" ) ) {
+			return stoull( line.substr( line.find_first_not_of( " \t", 6 ) ) ) * 1024;
+		}
+	}
+	throw runtime_error( "could not read VmHWM from /proc/self/status" );
+}
+
+// Start measuring the peak from the current resident set size
+static void reset_peak_resident()
+{
+	malloc_trim( 0 );
+	ofstream clear_refs { "/proc/self/clear_refs" };
+	clear_refs << "5";
+	clear_refs.close();
+	if ( not clear_refs ) {
+		throw runtime_error( "could not reset the peak RSS with /proc/self/clear_refs" );
+	}
+}
+
+// Many streams, each sent the worst case for a reassembler: every other byte of its window, one byte at a time.
+// With `retransmit`, the bytes arrive instead in full-size segments, each of which adds just two bytes to the last.
+void fragments_test( fstream& debug_output,
+					 const size_t streams,
+					 const size_t fragments,
+					 const bool retransmit,
+					 const Reassembler::Storage storage,
+					 const size_t max_fragments = numeric_limits<size_t>::max() )
+{
+	constexpr uint64_t capacity = 1 << 20;
+	constexpr size_t segment_size = 1460;
+
+	const string data( 2 * fragments + segment_size, 'x' );
+	vector<Reassembler> reassemblers;
+	reassemblers.reserve( streams );
+
+	reset_peak_resident();
+	const uint64_t baseline = peak_resident_bytes();
+
+	uint64_t pending = 0;
+	uint64_t memory_used = 0;
+	for ( size_t s = 0; s < streams; ++s ) {
+		Reassembler& r = reassemblers.emplace_back( ByteStream { capacity }, storage );
+		r.set_max_fragments( max_fragments );
+		for ( uint64_t i = 1; i < 2 * fragments; i += 2 ) {
+			if ( retransmit ) {
+				r.insert( i, data.substr( i, segment_size ), false );
+			} else {
+				r.insert( i, data.substr( i, 1 ), false );
+			}
+		}
+		pending += r.count_bytes_pending();
+		memory_used += r.memory_used();
+	}
+
+	const double peak_mb = static_cast<double>( peak_resident_bytes() - baseline ) / 1e6;
+	const string_view arrivals = retransmit ? "overlapping segments" : "1-byte fragments";
+	const string_view store = storage == Reassembler::Storage::StagingRing ? "staging ring" : "segments";
+	const string limit = max_fragments == numeric_limits<size_t>::max() ? "no" : to_string( max_fragments );
+
+	cout << streams << " streams of " << fragments << " " << arrivals << " (" << store << ", " << limit
+		 << " fragment limit): " << fixed << setprecision( 1 ) << static_cast<double>( pending ) / 1e6
+		 << " MB pending, memory_used " << static_cast<double>( memory_used ) / 1e6 << " MB, peak RSS +" << peak_mb
+		 << " MB.\n";
+	debug_output << "        Reassembler memory (" << arrivals << ", " << store << ", " << limit
+				 << " limit): " << fixed << setprecision( 1 ) << setw( 6 ) << peak_mb << " MB\n";
+
+	// A fragment's bookkeeping is a few dozen bytes, and vectors may have twice the room they need
+	if ( max_fragments != numeric_limits<size_t>::max()
+		 and memory_used > streams * ( max_fragments * 256 + segment_size * 4 ) ) {
+		throw runtime_error( "Reassembler held too much memory despite its fragment limit" );
+	}
+}
+
+void program_body()
+{
+	fstream debug_output;
+	debug_output.open( "/dev/tty" );
+
+	constexpr auto segments = Reassembler::Storage::Segments;
+	constexpr auto staging = Reassembler::Storage::StagingRing;
+
+	fragments_test( debug_output, 16, 32768, false, segments );
+	fragments_test( debug_output, 16, 32768, false, segments, 1024 );
+	fragments_test( debug_output, 16, 32768, false, staging );
+
+	fragments_test( debug_output, 16, 2048, true, segments );
+	fragments_test( debug_output, 16, 2048, true, segments, 1024 );
+	fragments_test( debug_output, 16, 2048, true, staging );
+}
+
+int main()
+{
+	try {
+		program_body();
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
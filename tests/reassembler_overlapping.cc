@@ -287,6 +287,39 @@ int main()
 			test.execute( BytesPushed( 27 ) );
 			test.execute( ReadAll( "I am sentient, hello world!" ) );
 		}
+
+		{
+			// One substring spanning several stored pieces fills every gap between them
+			ReassemblerTestHarness test { "overlapping fills many holes", 100 };
+
+			test.execute( Insert { "b", 1 } );
+			test.execute( Insert { "d", 3 } );
+			test.execute( Insert { "fg", 5 } );
+			test.execute( Insert { "j", 9 } );
+			test.execute( BytesPending( 5 ) );
+
+			test.execute( Insert { "bcdefghi", 1 } );
+			test.execute( BytesPending( 9 ) );
+			test.execute( BytesPushed( 0 ) );
+
+			test.execute( Insert { "a", 0 } );
+			test.execute( BytesPending( 0 ) );
+			test.execute( ReadAll( "abcdefghij" ) );
+		}
+
+		{
+			// The last substring arrives first, and is covered by a later substring that isn't marked last
+			ReassemblerTestHarness test { "last substring covered by an overlapping one", 100 };
+
+			test.execute( Insert { "de", 3 }.is_last() );
+			test.execute( Insert { "bcde", 1 } );
+			test.execute( BytesPending( 4 ) );
+			test.execute( IsFinished( false ) );
+
+			test.execute( Insert { "a", 0 } );
+			test.execute( ReadAll( "abcde" ) );
+			test.execute( IsFinished( true ) );
+		}
 	} catch ( const exception& e ) {
 		cerr << "Exception: " << e.what() << "\n";
 		return EXIT_FAILURE;
@@ -0,0 +1,79 @@
+#include "byte_stream_test_harness.hh"
+#include "reassembler_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+	try {
+		for ( const auto storage : { Reassembler::Storage::Segments, Reassembler::Storage::StagingRing } ) {
+			{
+				ReassemblerTestHarness test { "no pending ranges", 65000, storage };
+
+				test.execute( PendingRanges( 4, {} ) );
+				test.execute( Insert { "abc", 0 } );
+				test.execute( PendingRanges( 4, {} ) );
+			}
+
+			{
+				ReassemblerTestHarness test { "one pending range", 65000, storage };
+
+				test.execute( Insert { "def", 3 } );
+				test.execute( PendingRanges( 4, { { 3, 6 } } ) );
+				test.execute( Insert { "gh", 6 } );
+				test.execute( PendingRanges( 4, { { 3, 8 } } ) );
+				test.execute( Insert { "abc", 0 } );
+				test.execute( PendingRanges( 4, {} ) );
+			}
+
+			{
+				// The range with the most recently received bytes comes first
+				ReassemblerTestHarness test { "most recent range first", 65000, storage };
+
+				test.execute( Insert { "b", 1 } );
+				test.execute( Insert { "f", 5 } );
+				test.execute( Insert { "d", 3 } );
+				test.execute( PendingRanges( 1, { { 3, 4 } } ) );
+
+				test.execute( Insert { "e", 4 } );
+				test.execute( PendingRanges( 1, { { 3, 6 } } ) );
+				test.execute( PendingRanges( 2, { { 3, 6 }, { 1, 2 } } ) );
+
+				test.execute( Insert { "a", 0 } );
+				test.execute( PendingRanges( 4, { { 3, 6 } } ) );
+			}
+
+			{
+				// Runs longer than a word of the staging ring's bitmap, and ranges that wrap around the ring
+				ReassemblerTestHarness test { "long ranges", 1000, storage };
+
+				test.execute( Insert { string( 300, 'x' ), 100 } );
+				test.execute( Insert { string( 10, 'x' ), 700 } );
+				test.execute( PendingRanges( 4, { { 700, 710 }, { 100, 400 } } ) );
+
+				test.execute( Insert { string( 100, 'x' ), 0 } );
+				test.execute( ReadAll( string( 400, 'x' ) ) );
+				test.execute( Insert { string( 100, 'x' ), 1300 } );
+				test.execute( PendingRanges( 4, { { 1300, 1400 }, { 700, 710 } } ) );
+			}
+		}
+
+		{
+			ReassemblerTestHarness test { "ranges after coalescing", 65000 };
+
+			test.execute( SetMaxFragments( 2 ) );
+			test.execute( Insert { "b", 1 } );
+			test.execute( Insert { "f", 5 } );
+			test.execute( Insert { "c", 2 } );
+			test.execute( PendingRanges( 4, { { 1, 3 }, { 5, 6 } } ) );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+#include "byte_stream_test_harness.hh"
+#include "reassembler_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+	try {
+		for ( const auto storage : { Reassembler::Storage::Segments, Reassembler::Storage::StagingRing } ) {
+			{
+				ReassemblerTestHarness test { "grow keeps pending bytes", 8, storage };
+				test.execute( Insert { "cd", 2 } );
+				test.execute( Insert { "ghij", 6 } );
+				test.execute( BytesPending { 4 } );
+				test.execute( SetOutputCapacity { 100 } );
+				test.execute( Capacity { 100 } );
+				test.execute( BytesPending { 4 } );
+				test.execute( Insert { "xyz", 50 } );
+				test.execute( BytesPending { 7 } );
+				test.execute( Insert { "ab", 0 } );
+				test.execute( Insert { "ef", 4 } );
+				test.execute( ReadAll { "abcdefgh" } );
+				test.execute( BytesPending { 3 } );
+			}
+
+			{
+				ReassemblerTestHarness test { "shrink drops what no longer fits", 100, storage };
+				test.execute( Insert { "abc", 0 } );
+				test.execute( Insert { "fgh", 5 } );
+				test.execute( Insert { "xyz", 50 } );
+				test.execute( BytesPending { 6 } );
+				test.execute( SetOutputCapacity { 7 } );
+				test.execute( Capacity { 7 } );
+				test.execute( BytesPending { 2 } );
+				test.execute( Insert { "de", 3 } );
+				test.execute( ReadAll { "abcdefg" } );
+				test.execute( BytesPending { 0 } );
+				test.execute( Insert { "hijklmnop", 7 } );
+				test.execute( ReadAll { "hijklmn" } );
+			}
+
+			{
+				ReassemblerTestHarness test { "resize an idle reassembler", 4, storage };
+				test.execute( Insert { "abcd", 0 } );
+				test.execute( ReadAll { "abcd" } );
+				test.execute( SetOutputCapacity { 1 << 16 } );
+				test.execute( Insert { string( 1000, 'y' ), 5000 } );
+				test.execute( Insert { string( 4996, 'x' ), 4 } );
+				test.execute( BytesBuffered { 5996 } );
+				test.execute( SetOutputCapacity { 4 } );
+				test.execute( Capacity { 5996 } );
+			}
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -8,33 +8,27 @@
 #include <queue>
 #include <random>
 #include <tuple>
+#include <vector>
 
 using namespace std;
 using namespace std::chrono;
 
-void speed_test( const size_t num_chunks,  // NOLINT(bugprone-easily-swappable-parameters)
-				 const size_t chunk_size,  // NOLINT(bugprone-easily-swappable-parameters)
-				 const size_t overlap,	   // NOLINT(bugprone-easily-swappable-parameters)
-				 const size_t capacity,	   // NOLINT(bugprone-easily-swappable-parameters)
-				 const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
-				 string_view scenario )
+// Split the data into segments before writing: each window is sent backwards, from its end down to the start of
+// the stream (or, without `resend_from_start`, only down to the start of the window)
+queue<tuple<uint64_t, string, bool>> split_backwards( const string& data,
+													   const size_t chunk_size, // NOLINT(*-swappable-parameters)
+													   const size_t overlap,	// NOLINT(*-swappable-parameters)
+													   const size_t capacity,	// NOLINT(*-swappable-parameters)
+													   const bool resend_from_start )
 {
-	// Generate the data to be written
-	const string data = [&] {
-		default_random_engine rd { random_seed };
-		uniform_int_distribution<char> ud;
-		string ret;
-		for ( size_t i = 0; i < num_chunks * chunk_size; ++i ) {
-			ret += ud( rd );
-		}
-		return ret;
-	}();
-
-	// Split the data into segments before writing
 	queue<tuple<uint64_t, string, bool>> split_data;
 	for ( size_t i = 0; i < data.size(); i += capacity ) {
 		size_t chunk_begin = min( i + capacity - 1, data.size() - 1 );
 		while ( true ) {
+			if ( not resend_from_start and chunk_begin < i + overlap ) {
+				split_data.emplace( i, data.substr( i, chunk_size ), i + chunk_size >= data.size() );
+				break;
+			}
 			split_data.emplace(
 			  chunk_begin, data.substr( chunk_begin, chunk_size ), chunk_begin + chunk_size >= data.size() );
 			if ( chunk_begin >= overlap ) {
@@ -45,17 +39,61 @@ void speed_test( const size_t num_chunks,  // NOLINT(bugprone-easily-swappable-p
 			}
 		}
 	}
+	return split_data;
+}
+
+string make_random_data( const size_t size, const size_t random_seed )
+{
+	default_random_engine rd { random_seed };
+	uniform_int_distribution<char> ud;
+	string ret;
+	for ( size_t i = 0; i < size; ++i ) {
+		ret += ud( rd );
+	}
+	return ret;
+}
+
+void speed_test( const size_t num_chunks,  // NOLINT(bugprone-easily-swappable-parameters)
+				 const size_t chunk_size,  // NOLINT(bugprone-easily-swappable-parameters)
+				 const size_t overlap,	   // NOLINT(bugprone-easily-swappable-parameters)
+				 const size_t capacity,	   // NOLINT(bugprone-easily-swappable-parameters)
+				 const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
+				 string_view scenario,
+				 const bool resend_from_start = true,
+				 const Reassembler::Storage storage = Reassembler::Storage::Segments,
+				 const size_t batch_size = 1 )
+{
+	// Generate the data to be written
+	const string data = make_random_data( num_chunks * chunk_size, random_seed );
+
+	auto split_data = split_backwards( data, chunk_size, overlap, capacity, resend_from_start );
 
-	Reassembler reassembler { ByteStream { capacity } };
+	Reassembler reassembler { ByteStream { capacity }, storage };
 
 	string output_data;
 	output_data.reserve( data.size() );
 
+	vector<Reassembler::Segment> batch;
+	batch.reserve( batch_size );
+
 	const auto start_time = steady_clock::now();
 	while ( not split_data.empty() ) {
-		auto& next = split_data.front();
-		reassembler.insert( get<uint64_t>( next ), move( get<string>( next ) ), get<bool>( next ) );
-		split_data.pop();
+		if ( batch_size > 1 ) {
+			// A batch ends where the window does, since nothing is read from the stream in the middle of one
+			batch.clear();
+			const uint64_t window_end = reassembler.reader().bytes_popped() + capacity;
+			while ( batch.size() < batch_size and not split_data.empty()
+					and ( batch.empty() or get<uint64_t>( split_data.front() ) < window_end ) ) {
+				auto& next = split_data.front();
+				batch.push_back( { get<uint64_t>( next ), move( get<string>( next ) ), get<bool>( next ) } );
+				split_data.pop();
+			}
+			reassembler.insert_batch( batch );
+		} else {
+			auto& next = split_data.front();
+			reassembler.insert( get<uint64_t>( next ), move( get<string>( next ) ), get<bool>( next ) );
+			split_data.pop();
+		}
 
 		while ( reassembler.reader().bytes_buffered() ) {
 			output_data += reassembler.reader().peek();
@@ -81,8 +119,9 @@ void speed_test( const size_t num_chunks,  // NOLINT(bugprone-easily-swappable-p
 	fstream debug_output;
 	debug_output.open( "/dev/tty" );
 
-	cout << "Reassembler to ByteStream with capacity=" << capacity << " reached " << fixed << setprecision( 2 )
-		 << gigabits_per_second << " Gbit/s.\n";
+	const string_view staging = storage == Reassembler::Storage::StagingRing ? " (staging ring)" : "";
+	cout << "Reassembler" << staging << " to ByteStream with capacity=" << capacity << " reached " << fixed
+		 << setprecision( 2 ) << gigabits_per_second << " Gbit/s.\n";
 
 	debug_output << "        Reassembler throughput " << scenario << fixed << setprecision( 2 ) << setw( 5 )
 				 << gigabits_per_second << " Gbit/s\n";
@@ -92,10 +131,152 @@ void speed_test( const size_t num_chunks,  // NOLINT(bugprone-easily-swappable-p
 	}
 }
 
+// Every substring arrives exactly once and in order, into a stream with plenty of room
+void in_order_speed_test( const size_t num_chunks,	// NOLINT(bugprone-easily-swappable-parameters)
+						  const size_t chunk_size,	// NOLINT(bugprone-easily-swappable-parameters)
+						  const size_t capacity,	// NOLINT(bugprone-easily-swappable-parameters)
+						  const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
+						  string_view scenario,
+						  const ByteStream::Storage output_storage = ByteStream::Storage::Ring )
+{
+	const string data = make_random_data( num_chunks * chunk_size, random_seed );
+
+	queue<string> split_data;
+	for ( size_t i = 0; i < data.size(); i += chunk_size ) {
+		split_data.emplace( data.substr( i, chunk_size ) );
+	}
+
+	Reassembler reassembler { ByteStream { capacity, output_storage } };
+	bool mismatch = false;
+
+	const auto start_time = steady_clock::now();
+	while ( not split_data.empty() ) {
+		const uint64_t first_index = reassembler.writer().bytes_pushed();
+		const bool is_last = split_data.size() == 1;
+		reassembler.insert( first_index, move( split_data.front() ), is_last );
+		split_data.pop();
+
+		if ( reassembler.reader().bytes_buffered() >= capacity / 2 or is_last ) {
+			while ( reassembler.reader().bytes_buffered() ) {
+				// Check the output in place (rather than copying it out) so the stream is what's being measured
+				const string_view peeked = reassembler.reader().peek();
+				const uint64_t offset = reassembler.reader().bytes_popped();
+				mismatch |= peeked != string_view { data }.substr( offset, peeked.size() );
+				reassembler.reader().pop( peeked.size() );
+			}
+		}
+	}
+
+	const auto stop_time = steady_clock::now();
+
+	if ( not reassembler.reader().is_finished() ) {
+		throw runtime_error( "Reassembler did not close ByteStream when finished" );
+	}
+
+	if ( mismatch or reassembler.reader().bytes_popped() != data.size() ) {
+		throw runtime_error( "Mismatch between data written and read" );
+	}
+
+	auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+	auto gigabits_per_second = 8 * static_cast<double>( data.size() ) / test_duration.count() / 1e9;
+
+	fstream debug_output;
+	debug_output.open( "/dev/tty" );
+
+	const string_view rope = output_storage == ByteStream::Storage::Rope ? " (rope)" : "";
+	cout << "Reassembler to ByteStream" << rope << " with capacity=" << capacity << ", in order, reached " << fixed
+		 << setprecision( 2 ) << gigabits_per_second << " Gbit/s.\n";
+
+	debug_output << "        Reassembler throughput " << scenario << fixed << setprecision( 2 ) << setw( 5 )
+				 << gigabits_per_second << " Gbit/s\n";
+
+	if ( gigabits_per_second < 0.1 ) {
+		throw runtime_error( "Reassembler did not meet minimum speed of 0.1 Gbit/s." );
+	}
+}
+
+// The same substrings as the "10x overlap" speed_test, timing Reassembler::insert by itself: the stream is popped
+// without copying its bytes out, and the benchmark's own cost (handing over and freeing each substring, most of
+// which are retransmissions of bytes already written) is timed separately with no Reassembler, and taken away
+void insert_only_speed_test( const size_t num_chunks,  // NOLINT(bugprone-easily-swappable-parameters)
+							 const size_t chunk_size,  // NOLINT(bugprone-easily-swappable-parameters)
+							 const size_t overlap,	   // NOLINT(bugprone-easily-swappable-parameters)
+							 const size_t capacity,	   // NOLINT(bugprone-easily-swappable-parameters)
+							 const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
+							 string_view scenario )
+{
+	const string data = make_random_data( num_chunks * chunk_size, random_seed );
+
+	// Each is timed a few times, keeping the fastest, as the difference between them is small
+	size_t substrings = 0;
+	double harness_seconds = 1e9;
+	double total_seconds = 1e9;
+	for ( size_t run = 0; run < 3; ++run ) {
+		auto harness_data = split_backwards( data, chunk_size, overlap, capacity, true );
+		substrings = harness_data.size();
+		const auto harness_start = steady_clock::now();
+		while ( not harness_data.empty() ) {
+			const string discarded = move( get<string>( harness_data.front() ) );
+			harness_data.pop();
+		}
+		harness_seconds
+		  = min( harness_seconds, duration_cast<duration<double>>( steady_clock::now() - harness_start ).count() );
+
+		auto split_data = split_backwards( data, chunk_size, overlap, capacity, true );
+		Reassembler reassembler { ByteStream { capacity } };
+		const auto start_time = steady_clock::now();
+		while ( not split_data.empty() ) {
+			auto& next = split_data.front();
+			reassembler.insert( get<uint64_t>( next ), move( get<string>( next ) ), get<bool>( next ) );
+			split_data.pop();
+
+			while ( reassembler.reader().bytes_buffered() ) {
+				reassembler.reader().pop( reassembler.reader().peek().size() );
+			}
+		}
+		total_seconds
+		  = min( total_seconds, duration_cast<duration<double>>( steady_clock::now() - start_time ).count() );
+
+		if ( not reassembler.reader().is_finished() or reassembler.reader().bytes_popped() != data.size() ) {
+			throw runtime_error( "Reassembler did not write the whole stream" );
+		}
+	}
+
+	const double own_seconds = max( total_seconds - harness_seconds, 1e-9 );
+	const double gigabits_per_second = 8 * static_cast<double>( num_chunks * capacity ) / own_seconds / 1e9;
+	const double ns_per_insert = own_seconds * 1e9 / static_cast<double>( substrings );
+
+	fstream debug_output;
+	debug_output.open( "/dev/tty" );
+
+	cout << "Reassembler::insert alone, " << substrings << " substrings: " << fixed << setprecision( 2 )
+		 << total_seconds * 1e3 << " ms, of which the benchmark's own work took " << harness_seconds * 1e3
+		 << " ms, leaving " << ns_per_insert << " ns per insert (" << gigabits_per_second << " Gbit/s).\n";
+
+	debug_output << "        Reassembler throughput " << scenario << fixed << setprecision( 2 ) << setw( 5 )
+				 << gigabits_per_second << " Gbit/s\n";
+}
+
 void program_body()
 {
+	in_order_speed_test( 20000, 1500, 1 << 20, 4096, "(in order, large capacity): " );
+	in_order_speed_test( 20000, 1500, 1 << 20, 4096, "(in order, into a rope):     ", ByteStream::Storage::Rope );
+
 	speed_test( 1000, 1500, 1500, 32768, 1370, "(no overlap):  " );
 	speed_test( 1000, 1500, 150, 32768, 6163, "(10x overlap): " );
+	speed_test( 1000, 1500, 150, 32768, 6163, "(10x overlap, out of order): ", false );
+	insert_only_speed_test( 1000, 1500, 150, 32768, 6163, "(10x overlap, insert alone): " );
+
+	constexpr auto staging = Reassembler::Storage::StagingRing;
+	speed_test( 1000, 1500, 1500, 32768, 1370, "(no overlap, staging ring):  ", true, staging );
+	speed_test( 1000, 1500, 150, 32768, 6163, "(10x overlap, staging ring): ", true, staging );
+	speed_test( 1000, 1500, 150, 32768, 6163, "(10x overlap, out of order, staging ring): ", false, staging );
+
+	constexpr auto segments = Reassembler::Storage::Segments;
+	speed_test( 1000, 1500, 150, 32768, 6163, "(10x overlap, batches of 32): ", true, segments, 32 );
+	speed_test( 1000, 1500, 150, 32768, 6163, "(10x overlap, out of order, batches of 32): ", false, segments, 32 );
+	speed_test(
+	  1000, 1500, 150, 32768, 6163, "(10x overlap, out of order, staging, batches): ", false, staging, 32 );
 }
 
 int main()
@@ -0,0 +1,112 @@
+#include "byte_stream_test_harness.hh"
+#include "reassembler_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+	try {
+		constexpr auto staging = Reassembler::Storage::StagingRing;
+
+		{
+			ReassemblerTestHarness test { "staging holes", 65000, staging };
+
+			test.execute( Insert { "b", 1 } );
+			test.execute( Insert { "d", 3 } );
+			test.execute( BytesPending( 2 ) );
+			test.execute( BytesPushed( 0 ) );
+
+			test.execute( Insert { "c", 2 } );
+			test.execute( BytesPending( 3 ) );
+			test.execute( Insert { "a", 0 } );
+			test.execute( BytesPushed( 4 ) );
+			test.execute( BytesPending( 0 ) );
+			test.execute( ReadAll( "abcd" ) );
+		}
+
+		{
+			ReassemblerTestHarness test { "staging fill and close", 65000, staging };
+
+			test.execute( Insert { "cde", 2 }.is_last() );
+			test.execute( Insert { "bcd", 1 } );
+			test.execute( BytesPending( 4 ) );
+
+			test.execute( Insert { "ab", 0 } );
+			test.execute( BytesPending( 0 ) );
+			test.execute( ReadAll( "abcde" ) );
+			test.execute( IsFinished( true ) );
+		}
+
+		{
+			// Bytes that arrive in order again after being staged are not counted twice
+			ReassemblerTestHarness test { "staging overlap with in-order data", 1000, staging };
+
+			test.execute( Insert { "cdef", 2 } );
+			test.execute( Insert { "h", 7 } );
+			test.execute( BytesPending( 5 ) );
+
+			test.execute( Insert { "abcd", 0 } );
+			test.execute( BytesPending( 1 ) );
+			test.execute( ReadAll( "abcdef" ) );
+
+			test.execute( Insert { "g", 6 } );
+			test.execute( BytesPending( 0 ) );
+			test.execute( ReadAll( "gh" ) );
+		}
+
+		{
+			ReassemblerTestHarness test { "staging capacity", 8, staging };
+
+			test.execute( Insert { "bcdefghijk", 1 } );
+			test.execute( BytesPending( 7 ) );
+			test.execute( Insert { "a", 0 } );
+			test.execute( ReadAll( "abcdefgh" ) );
+
+			test.execute( Insert { "klmnopqrstu", 10 }.is_last() );
+			test.execute( BytesPending( 6 ) );
+			test.execute( Insert { "ij", 8 } );
+			test.execute( ReadAll( "ijklmnop" ) );
+			test.execute( IsFinished( false ) );
+		}
+
+		{
+			// The stream goes around the ring many times, and stored runs cross its end
+			ReassemblerTestHarness test { "staging wrap around", 100, staging };
+
+			string expected;
+			for ( uint64_t i = 0; i < 1000; i += 30 ) {
+				const string first( 15, static_cast<char>( 'a' + i % 26 ) );
+				const string second( 15, static_cast<char>( 'A' + i % 26 ) );
+				test.execute( Insert { second, i + 15 } );
+				test.execute( BytesPending( 15 ) );
+				test.execute( Insert { first, i } );
+				test.execute( BytesPending( 0 ) );
+				test.execute( ReadAll( first + second ) );
+			}
+			test.execute( BytesPushed( 1020 ) );
+		}
+
+		{
+			// More than 64 bytes in a run, so the bitmap scan crosses words
+			ReassemblerTestHarness test { "staging long runs", 1000, staging };
+
+			const string data( 500, 'x' );
+			test.execute( Insert { data.substr( 100, 300 ), 100 } );
+			test.execute( Insert { data.substr( 1, 98 ), 1 } );
+			test.execute( BytesPending( 398 ) );
+			test.execute( Insert { data.substr( 99, 1 ), 99 } );
+			test.execute( BytesPending( 399 ) );
+			test.execute( Insert { data.substr( 0, 1 ), 0 } );
+			test.execute( BytesPending( 0 ) );
+			test.execute( ReadAll( data.substr( 0, 400 ) ) );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -4,8 +4,10 @@
 #include "helpers.hh"
 #include "reassembler.hh"
 
+#include <initializer_list>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 template<std::derived_from<TestStep<ByteStream>> T>
 struct ReassemblerTestStep : public TestStep<Reassembler>
@@ -31,6 +33,13 @@ class ReassemblerTestHarness : public TestHarness<Reassembler>
 					 { Reassembler { ByteStream { capacity } } } )
 	{}
 
+	ReassemblerTestHarness( std::string test_name, uint64_t capacity, Reassembler::Storage storage )
+	  : TestHarness( move( test_name ),
+					 "capacity=" + std::to_string( capacity ) + ", storage="
+					   + ( storage == Reassembler::Storage::StagingRing ? "StagingRing" : "Segments" ),
+					 { Reassembler { ByteStream { capacity }, storage } } )
+	{}
+
 	template<std::derived_from<TestStep<ByteStream>> T>
 	void execute( const T& test )
 	{
@@ -47,6 +56,81 @@ struct BytesPending : public ExpectNumber<Reassembler, uint64_t>
 	uint64_t value( const Reassembler& r ) const override { return r.count_bytes_pending(); }
 };
 
+struct PendingRanges : public Expectation<Reassembler>
+{
+	size_t max_ranges_;
+	std::vector<std::pair<uint64_t, uint64_t>> ranges_;
+
+	PendingRanges( size_t max_ranges, std::vector<std::pair<uint64_t, uint64_t>> ranges )
+	  : max_ranges_( max_ranges ), ranges_( std::move( ranges ) )
+	{}
+
+	static std::string to_string( const std::vector<std::pair<uint64_t, uint64_t>>& ranges )
+	{
+		std::ostringstream ss;
+		ss << "{";
+		for ( const auto& [first, end] : ranges ) {
+			ss << " [" << first << ", " << end << ")";
+		}
+		ss << " }";
+		return ss.str();
+	}
+
+	std::string description() const override
+	{
+		return "pending_ranges( " + std::to_string( max_ranges_ ) + " ) = " + to_string( ranges_ );
+	}
+
+	void execute( const Reassembler& r ) const override
+	{
+		const auto ranges = r.pending_ranges( max_ranges_ );
+		if ( ranges != ranges_ ) {
+			throw ExpectationViolation( "The Reassembler should have had pending_ranges( "
+										+ std::to_string( max_ranges_ ) + " ) = " + to_string( ranges_ )
+										+ ", but instead it was " + to_string( ranges ) + "." );
+		}
+	}
+};
+
+struct MemoryUsedBetween : public Expectation<Reassembler>
+{
+	uint64_t min_, max_;
+	MemoryUsedBetween( uint64_t min, uint64_t max ) : min_( min ), max_( max ) {} // NOLINT(*-swappable-*)
+
+	std::string description() const override
+	{
+		return "memory_used between " + std::to_string( min_ ) + " and " + std::to_string( max_ );
+	}
+
+	void execute( const Reassembler& r ) const override
+	{
+		const uint64_t used = r.memory_used();
+		if ( used < min_ or used > max_ ) {
+			throw ExpectationViolation( "memory_used was " + std::to_string( used )
+										+ ", outside the expected range" );
+		}
+	}
+};
+
+struct SetMaxFragments : public Action<Reassembler>
+{
+	size_t max_fragments_;
+	explicit SetMaxFragments( size_t max_fragments ) : max_fragments_( max_fragments ) {}
+	std::string description() const override
+	{
+		return "set_max_fragments( " + std::to_string( max_fragments_ ) + " )";
+	}
+	void execute( Reassembler& r ) const override { r.set_max_fragments( max_fragments_ ); }
+};
+
+struct SetOutputCapacity : public Action<Reassembler>
+{
+	uint64_t capacity_;
+	explicit SetOutputCapacity( uint64_t capacity ) : capacity_( capacity ) {}
+	std::string description() const override { return "set_capacity( " + std::to_string( capacity_ ) + " )"; }
+	void execute( Reassembler& r ) const override { r.set_capacity( capacity_ ); }
+};
+
 struct Insert : public Action<Reassembler>
 {
 	std::string data_;
@@ -73,3 +157,29 @@ struct Insert : public Action<Reassembler>
 
 	void execute( Reassembler& r ) const override { r.insert( first_index_, data_, is_last_substring_ ); }
 };
+
+struct InsertBatch : public Action<Reassembler>
+{
+	std::vector<Insert> inserts_;
+
+	InsertBatch( std::initializer_list<Insert> inserts ) : inserts_( inserts ) {}
+
+	std::string description() const override
+	{
+		std::ostringstream ss;
+		ss << "insert batch of " << inserts_.size() << ":";
+		for ( const auto& insert : inserts_ ) {
+			ss << " [" << insert.description() << "]";
+		}
+		return ss.str();
+	}
+
+	void execute( Reassembler& r ) const override
+	{
+		std::vector<Reassembler::Segment> segments;
+		for ( const auto& insert : inserts_ ) {
+			segments.push_back( { insert.first_index_, insert.data_, insert.is_last_substring_ } );
+		}
+		r.insert_batch( segments );
+	}
+};
@@ -4,9 +4,12 @@
 #include "tcp_receiver.hh"
 #include "tcp_receiver_message.hh"
 
+#include <algorithm>
+#include <initializer_list>
 #include <optional>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 template<std::derived_from<TestStep<Reassembler>> T>
 struct DirectReassemblerTest : public TestStep<TCPReceiver>
@@ -44,6 +47,22 @@ class TCPReceiverTestHarness : public TestHarness<TCPReceiver>
 					 { TCPReceiver { Reassembler { ByteStream { capacity } } } } )
 	{}
 
+	TCPReceiverTestHarness( std::string test_name, uint64_t capacity, uint8_t window_scale )
+	  : TestHarness( move( test_name ),
+					 "capacity=" + std::to_string( capacity ) + ", window_scale=" + std::to_string( window_scale ),
+					 { TCPReceiver {
+					   Reassembler { ByteStream { capacity } },
+					   TCPConfig { .recv_capacity = capacity, .recv_window_scale = window_scale } } } )
+	{}
+
+	TCPReceiverTestHarness( std::string test_name, const TCPConfig& config )
+	  : TestHarness( move( test_name ),
+					 "capacity=" + std::to_string( config.recv_capacity )
+					   + ", capacity_max=" + std::to_string( config.recv_capacity_max )
+					   + ", window_scale=" + std::to_string( config.recv_window_scale ),
+					 { TCPReceiver { Reassembler { ByteStream { config.recv_capacity } }, config } } )
+	{}
+
 	template<std::derived_from<TestStep<Reassembler>> T>
 	void execute( const T& test )
 	{
@@ -66,6 +85,20 @@ struct ExpectWindow : public ExpectNumber<TCPReceiver, uint16_t>
 	uint16_t value( const TCPReceiver& rs ) const override { return rs.send().window_size; }
 };
 
+struct ExpectWindowBytes : public ExpectNumber<TCPReceiver, uint64_t>
+{
+	using ExpectNumber::ExpectNumber;
+	std::string name() const override { return "window() (window_size, scaled)"; }
+	uint64_t value( const TCPReceiver& rs ) const override { return rs.send().window(); }
+};
+
+struct ExpectWindowScale : public ExpectNumber<TCPReceiver, std::optional<uint8_t>>
+{
+	using ExpectNumber::ExpectNumber;
+	std::string name() const override { return "window_scale"; }
+	std::optional<uint8_t> value( const TCPReceiver& rs ) const override { return rs.send().window_scale; }
+};
+
 struct ExpectAckno : public ExpectNumber<TCPReceiver, std::optional<Wrap32>>
 {
 	using ExpectNumber::ExpectNumber;
@@ -73,6 +106,38 @@ struct ExpectAckno : public ExpectNumber<TCPReceiver, std::optional<Wrap32>>
 	std::optional<Wrap32> value( const TCPReceiver& rs ) const override { return rs.send().ackno; }
 };
 
+struct ExpectSACK : public Expectation<TCPReceiver>
+{
+	std::vector<SACKBlock> blocks_;
+
+	explicit ExpectSACK( std::vector<SACKBlock> blocks ) : blocks_( std::move( blocks ) ) {}
+
+	static std::string to_string( const std::vector<SACKBlock>& blocks )
+	{
+		std::ostringstream ss;
+		ss << "{";
+		for ( const auto& block : blocks ) {
+			ss << " [" << block.left_edge << ", " << block.right_edge << ")";
+		}
+		ss << " }";
+		return ss.str();
+	}
+
+	std::string description() const override { return "SACK blocks = " + to_string( blocks_ ); }
+
+	void execute( const TCPReceiver& rs ) const override
+	{
+		const auto blocks = rs.send().sack_blocks;
+		const bool same = std::ranges::equal( blocks, blocks_, []( const SACKBlock& a, const SACKBlock& b ) {
+			return a.left_edge == b.left_edge and a.right_edge == b.right_edge;
+		} );
+		if ( not same ) {
+			throw ExpectationViolation( "The TCPReceiver should have sent SACK blocks " + to_string( blocks_ )
+										+ ", but instead it sent " + to_string( blocks ) + "." );
+		}
+	}
+};
+
 struct ExpectReset : public ExpectBool<TCPReceiver>
 {
 	using ExpectBool::ExpectBool;
@@ -133,6 +198,12 @@ struct SegmentArrives : public Action<TCPReceiver>
 		return *this;
 	}
 
+	SegmentArrives& with_window_scale( uint8_t window_scale )
+	{
+		msg_.window_scale = window_scale;
+		return *this;
+	}
+
 	SegmentArrives& with_rst()
 	{
 		msg_.RST = true;
@@ -178,3 +249,124 @@ struct SegmentArrives : public Action<TCPReceiver>
 		return ss.str();
 	}
 };
+
+struct SegmentsArrive : public Action<TCPReceiver>
+{
+	std::vector<TCPSenderMessage> msgs_ {};
+
+	SegmentsArrive( std::initializer_list<SegmentArrives> segments )
+	{
+		for ( const auto& segment : segments ) {
+			msgs_.push_back( segment.msg_ );
+		}
+	}
+
+	void execute( TCPReceiver& rs ) const override
+	{
+		std::vector<TCPSenderMessage> msgs = msgs_;
+		rs.receive_batch( msgs );
+	}
+
+	std::string description() const override
+	{
+		std::ostringstream ss;
+		ss << "receive batch:";
+		for ( const auto& msg : msgs_ ) {
+			ss << " [" << to_string( msg ) << "]";
+		}
+		return ss.str();
+	}
+};
+
+// Check the acks the receiver sends, by their acknos
+inline void check_acks_sent( const std::vector<TCPReceiverMessage>& sent, const std::vector<Wrap32>& expected )
+{
+	if ( sent.size() != expected.size() ) {
+		throw ExpectationViolation { "number of acks sent", expected.size(), sent.size() };
+	}
+	for ( size_t i = 0; i < sent.size(); ++i ) {
+		if ( sent[i].ackno != expected[i] ) {
+			throw ExpectationViolation {
+			  "ackno of ack #" + to_string( i ), std::optional { expected[i] }, sent[i].ackno };
+		}
+	}
+}
+
+inline std::string describe_acks( const std::vector<Wrap32>& acknos )
+{
+	std::ostringstream ss;
+	ss << acknos.size() << " ack(s)";
+	for ( const auto& ackno : acknos ) {
+		ss << " " << ackno;
+	}
+	return ss.str();
+}
+
+struct Tick : public Action<TCPReceiver>
+{
+	uint64_t ms_;
+	std::vector<Wrap32> acks_expected_ {};
+
+	explicit Tick( uint64_t ms ) : ms_( ms ) {}
+
+	Tick& with_acks( std::vector<Wrap32> acknos )
+	{
+		acks_expected_ = std::move( acknos );
+		return *this;
+	}
+
+	void execute( TCPReceiver& rs ) const override
+	{
+		std::vector<TCPReceiverMessage> sent;
+		rs.tick( ms_, [&]( const TCPReceiverMessage& ack ) { sent.push_back( ack ); } );
+		check_acks_sent( sent, acks_expected_ );
+	}
+
+	std::string description() const override
+	{
+		return to_string( ms_ ) + " ms pass, sending " + describe_acks( acks_expected_ );
+	}
+};
+
+struct DrainAcks : public Action<TCPReceiver>
+{
+	std::vector<Wrap32> acks_expected_;
+	std::optional<std::vector<std::vector<SACKBlock>>> sack_expected_ {}; // Each ack's SACK blocks, if checked
+
+	explicit DrainAcks( std::vector<Wrap32> acknos ) : acks_expected_( std::move( acknos ) ) {}
+
+	DrainAcks& with_sack( std::vector<std::vector<SACKBlock>> blocks )
+	{
+		sack_expected_ = std::move( blocks );
+		return *this;
+	}
+
+	void execute( TCPReceiver& rs ) const override
+	{
+		std::vector<TCPReceiverMessage> sent;
+		rs.drain_acks( [&]( const TCPReceiverMessage& ack ) { sent.push_back( ack ); } );
+		check_acks_sent( sent, acks_expected_ );
+
+		for ( size_t i = 0; sack_expected_.has_value() and i < sent.size(); ++i ) {
+			const auto& expected = sack_expected_->at( i );
+			const bool same
+			  = std::ranges::equal( sent[i].sack_blocks, expected, []( const SACKBlock& a, const SACKBlock& b ) {
+					return a.left_edge == b.left_edge and a.right_edge == b.right_edge;
+				} );
+			if ( not same ) {
+				throw ExpectationViolation( "Ack #" + to_string( i ) + " should have had SACK blocks "
+											+ ExpectSACK::to_string( expected ) + ", but instead it had "
+											+ ExpectSACK::to_string( sent[i].sack_blocks ) + "." );
+			}
+		}
+	}
+
+	std::string description() const override { return "drain acks, sending " + describe_acks( acks_expected_ ); }
+};
+
+struct ExpectAckDelayed : public ExpectBool<TCPReceiver>
+{
+	using ExpectBool::ExpectBool;
+	std::string name() const override { return "ack_delayed()"; }
+	bool value( const TCPReceiver& rs ) const override { return rs.ack_delayed(); }
+};
@@ -0,0 +1,208 @@
+#include "byte_stream_test_harness.hh"
+#include "receiver_test_harness.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <initializer_list>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Count the acks a receiver sends
+struct AckCounter
+{
+	uint64_t acks {};
+	uint64_t bytes {};
+};
+
+// The application reads everything, then `ms` pass and the receiver sends every ack it owes. With
+// `ack_every_segment`, the caller instead sends one ack for each of the `segments` that just arrived.
+struct ReadAndAck : public Action<TCPReceiver>
+{
+	AckCounter& counter_;
+	uint64_t ms_;
+	uint64_t segments_;
+	bool ack_every_segment_;
+
+	ReadAndAck( AckCounter& counter, uint64_t ms, uint64_t segments, bool ack_every_segment )
+	  : counter_( counter ), ms_( ms ), segments_( segments ), ack_every_segment_( ack_every_segment )
+	{}
+
+	void execute( TCPReceiver& rs ) const override
+	{
+		counter_.bytes += rs.reader().bytes_buffered();
+		rs.reader().pop( rs.reader().bytes_buffered() );
+
+		if ( ack_every_segment_ ) {
+			for ( uint64_t i = 0; i < segments_; ++i ) {
+				counter_.acks += rs.send().ackno.has_value() ? 1 : 0;
+			}
+			rs.drain_acks( []( const TCPReceiverMessage& ) {} );
+		} else {
+			rs.tick( ms_, [&]( const TCPReceiverMessage& ) { ++counter_.acks; } );
+		}
+	}
+
+	std::string description() const override
+	{
+		return "read, and send acks after " + to_string( ms_ ) + " ms";
+	}
+};
+
+// Transfer `size` bytes in full-sized segments, `batch_size` per arrival, swapping a fraction `reorder` of the
+// neighbouring segments in transit. The application reads after every arrival, and a millisecond passes every
+// `segments_per_ms` segments.
+AckCounter transfer( const size_t size,
+					 const size_t batch_size, // NOLINT(bugprone-easily-swappable-parameters)
+					 const double reorder,
+					 const bool ack_every_segment )
+{
+	constexpr size_t segment_size = TCPConfig::MAX_PAYLOAD_SIZE;
+	constexpr size_t segments_per_ms = 100;
+	const uint32_t isn = 137;
+	const string payload( segment_size, 'x' );
+
+	vector<uint64_t> order( size / segment_size );
+	for ( size_t k = 0; k < order.size(); ++k ) {
+		order[k] = k;
+	}
+	default_random_engine rd { 1 };
+	bernoulli_distribution swapped { reorder };
+	for ( size_t k = 0; k + 1 < order.size(); ++k ) {
+		if ( swapped( rd ) ) {
+			swap( order[k], order[k + 1] );
+			++k;
+		}
+	}
+
+	AckCounter counter;
+	TCPReceiverTestHarness test { "ack rate", TCPConfig::DEFAULT_CAPACITY };
+	test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+	test.execute( ReadAndAck { counter, 0, 1, ack_every_segment } );
+
+	for ( size_t k = 0; k < order.size(); k += batch_size ) {
+		const size_t n = min( batch_size, order.size() - k );
+		vector<SegmentArrives> segments;
+		for ( size_t i = k; i < k + n; ++i ) {
+			segments.push_back( SegmentArrives {}
+								  .with_seqno( isn + 1 + static_cast<uint32_t>( order[i] * segment_size ) )
+								  .with_data( payload ) );
+		}
+
+		if ( batch_size == 1 ) {
+			test.execute( segments.front() );
+		} else {
+			SegmentsArrive batch { initializer_list<SegmentArrives> {} };
+			for ( const auto& segment : segments ) {
+				batch.msgs_.push_back( segment.msg_ );
+			}
+			test.execute( batch );
+		}
+
+		const uint64_t ms = ( k + n ) / segments_per_ms - k / segments_per_ms;
+		test.execute( ReadAndAck { counter, ms, n, ack_every_segment } );
+	}
+
+	test.execute( ReadAndAck { counter, TCPConfig::ACK_DELAY_DFLT, 0, ack_every_segment } );
+	test.execute( BytesPopped { order.size() * segment_size } );
+	return counter;
+}
+
+void ack_test( fstream& debug_output, const size_t batch_size, const double reorder )
+{
+	constexpr size_t size = 4'000'000;
+	constexpr double megabytes = size / 1e6;
+
+	double acks_per_segment = 0;
+	for ( const bool ack_every_segment : { true, false } ) {
+		const AckCounter result = transfer( size, batch_size, reorder, ack_every_segment );
+		const double acks_per_mb = static_cast<double>( result.acks ) / megabytes;
+		const string_view label = ack_every_segment ? "ack per segment:" : "delayed acks:   ";
+
+		cout << "Batches of " << setw( 2 ) << batch_size << ", " << fixed << setprecision( 0 ) << 100 * reorder
+			 << "% reordered, " << label << " " << result.acks << " acks for " << result.bytes << " bytes ("
+			 << setprecision( 1 ) << acks_per_mb << " acks/MB).\n";
+		debug_output << "        Batches of " << setw( 2 ) << batch_size << ", " << fixed << setprecision( 0 )
+					 << setw( 2 ) << 100 * reorder << "% reordered, " << label << setprecision( 1 ) << setw( 8 )
+					 << acks_per_mb << " acks/MB\n";
+
+		if ( ack_every_segment ) {
+			acks_per_segment = acks_per_mb;
+		} else if ( acks_per_mb >= acks_per_segment ) {
+			throw runtime_error( "delayed acks did not reduce the number of acks" );
+		}
+	}
+}
+
+// Time out-of-order arrivals at a receiver already holding `gaps` separate pending ranges, draining the acks
+// every `drain_every` arrivals. Building an ack (SACK blocks included) should not cost more with more gaps.
+void gap_cost_test( fstream& debug_output, const size_t gaps, const size_t drain_every )
+{
+	constexpr size_t arrivals = 20000;
+	const Wrap32 isn { 137 };
+	TCPReceiver receiver { Reassembler { ByteStream { 4 * ( gaps + arrivals ) } } };
+	receiver.receive( { .seqno = isn, .SYN = true } );
+
+	// A byte at every other index leaves a gap before each
+	const auto arrive = [&]( uint64_t k ) {
+		receiver.receive( { .seqno = isn + static_cast<uint32_t>( 2 + 2 * k ), .payload = "x" } );
+	};
+	for ( size_t k = 0; k < gaps; ++k ) {
+		arrive( k );
+	}
+	receiver.drain_acks( []( const TCPReceiverMessage& ) {} );
+
+	uint64_t acks = 0;
+	const auto start = chrono::steady_clock::now();
+	for ( size_t k = gaps; k < gaps + arrivals; ++k ) {
+		arrive( k );
+		if ( ( k + 1 - gaps ) % drain_every == 0 ) {
+			receiver.drain_acks( [&]( const TCPReceiverMessage& ack ) { acks += ack.sack_blocks.size(); } );
+		}
+	}
+	const chrono::duration<double, nano> duration = chrono::steady_clock::now() - start;
+
+	if ( acks == 0 ) {
+		throw runtime_error( "no SACK blocks sent" );
+	}
+
+	const double ns_per_arrival = duration.count() / arrivals;
+	cout << "With " << setw( 6 ) << gaps << " gaps, draining every " << setw( 2 ) << drain_every << " arrivals: "
+		 << fixed << setprecision( 0 ) << ns_per_arrival << " ns per out-of-order arrival.\n";
+	debug_output << "        " << setw( 6 ) << gaps << " gaps, drain every " << setw( 2 ) << drain_every << ":"
+				 << fixed << setprecision( 0 ) << setw( 8 ) << ns_per_arrival << " ns/arrival\n";
+}
+
+void program_body()
+{
+	fstream debug_output;
+	debug_output.open( "/dev/tty" );
+
+	ack_test( debug_output, 1, 0 );
+	ack_test( debug_output, 1, 0.01 );
+	ack_test( debug_output, 16, 0 );
+	ack_test( debug_output, 16, 0.01 );
+
+	for ( const size_t gaps : { 10, 1000, 100000 } ) {
+		gap_cost_test( debug_output, gaps, 1 );
+		gap_cost_test( debug_output, gaps, 16 );
+	}
+}
+
+int main()
+{
+	try {
+		program_body();
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,296 @@
+#include "byte_stream_test_harness.hh"
+#include "random.hh"
+#include "receiver_test_harness.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// A sender with plenty to send, limited only by the receiver's window
+struct Sender
+{
+	Wrap32 isn;
+	uint64_t next_index {};
+};
+
+// One round trip: the sender fills the window from the last ack, the application reads all of it, the receiver
+// acks, and `rtt_ms` pass before the sender's next window arrives
+struct RoundTrip : public Action<TCPReceiver>
+{
+	Sender& sender_;
+	uint64_t rtt_ms_;
+
+	RoundTrip( Sender& sender, uint64_t rtt_ms ) : sender_( sender ), rtt_ms_( rtt_ms ) {}
+
+	void execute( TCPReceiver& rs ) const override
+	{
+		const TCPReceiverMessage ack = rs.send();
+		const uint64_t window_end = ack.ackno->unwrap( sender_.isn, sender_.next_index ) - 1 + ack.window();
+		while ( sender_.next_index < window_end ) {
+			const uint64_t length = min<uint64_t>( TCPConfig::MAX_PAYLOAD_SIZE, window_end - sender_.next_index );
+			rs.receive( { .seqno = sender_.isn + static_cast<uint32_t>( 1 + sender_.next_index ),
+						  .payload = string( length, 'x' ) } );
+			sender_.next_index += length;
+		}
+
+		rs.reader().pop( rs.reader().bytes_buffered() );
+		rs.drain_acks( []( const TCPReceiverMessage& ) {} );
+		rs.tick( rtt_ms_, []( const TCPReceiverMessage& ) {} );
+	}
+
+	std::string description() const override { return "one round trip of " + to_string( rtt_ms_ ) + " ms"; }
+};
+
+// The sender sends `bytes` more (in order, within the window), the application reads them, and the receiver acks
+struct Deliver : public Action<TCPReceiver>
+{
+	Sender& sender_;
+	uint64_t bytes_;
+
+	Deliver( Sender& sender, uint64_t bytes ) : sender_( sender ), bytes_( bytes ) {}
+
+	void execute( TCPReceiver& rs ) const override
+	{
+		for ( uint64_t sent = 0; sent < bytes_; ) {
+			const uint64_t length = min<uint64_t>( TCPConfig::MAX_PAYLOAD_SIZE, bytes_ - sent );
+			rs.receive( { .seqno = sender_.isn + static_cast<uint32_t>( 1 + sender_.next_index ),
+						  .payload = string( length, 'x' ) } );
+			sender_.next_index += length;
+			sent += length;
+		}
+
+		rs.reader().pop( rs.reader().bytes_buffered() );
+		rs.drain_acks( []( const TCPReceiverMessage& ) {} );
+	}
+
+	std::string description() const override { return "deliver and read " + to_string( bytes_ ) + " bytes"; }
+};
+
+// The right edge of the window the receiver advertises, as a stream index
+struct ExpectWindowEnd : public ExpectNumber<TCPReceiver, uint64_t>
+{
+	using ExpectNumber::ExpectNumber;
+	std::string name() const override { return "window end"; }
+	uint64_t value( const TCPReceiver& rs ) const override
+	{
+		return rs.writer().bytes_pushed() + rs.send().window();
+	}
+};
+
+struct ExpectRTTEstimate : public ExpectNumber<TCPReceiver, uint64_t>
+{
+	using ExpectNumber::ExpectNumber;
+	std::string name() const override { return "rtt_estimate_ms()"; }
+	uint64_t value( const TCPReceiver& rs ) const override { return rs.rtt_estimate_ms(); }
+};
+
+// The stream's capacity has shrunk below `capacity`
+struct ExpectShrunkBelow : public Expectation<TCPReceiver>
+{
+	uint64_t capacity_;
+	explicit ExpectShrunkBelow( uint64_t capacity ) : capacity_( capacity ) {}
+	std::string description() const override { return "capacity < " + to_string( capacity_ ); }
+	void execute( const TCPReceiver& rs ) const override
+	{
+		if ( rs.writer().capacity() >= capacity_ ) {
+			throw ExpectationViolation( "should have had capacity < " + to_string( capacity_ ) + ", but it was "
+										+ to_string( rs.writer().capacity() ) );
+		}
+	}
+};
+
+// The receiver sends an ack with send() (rather than through drain_acks() or tick())
+struct Send : public Action<TCPReceiver>
+{
+	void execute( TCPReceiver& rs ) const override { rs.send(); }
+	std::string description() const override { return "send an ack"; }
+};
+
+struct Idle : public Action<TCPReceiver>
+{
+	uint64_t ms_;
+	explicit Idle( uint64_t ms ) : ms_( ms ) {}
+	void execute( TCPReceiver& rs ) const override { rs.tick( ms_, []( const TCPReceiverMessage& ) {} ); }
+	std::string description() const override { return "idle for " + to_string( ms_ ) + " ms"; }
+};
+
+int main()
+{
+	try {
+		auto rd = get_random_engine();
+		constexpr uint64_t max_capacity = 4 << 20;
+		const Wrap32 isn { uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd ) };
+
+		{
+			TCPConfig config;
+			config.recv_capacity_max = max_capacity;
+			config.recv_window_scale = TCPConfig::window_scale_for( max_capacity );
+			TCPReceiverTestHarness test { "capacity grows while the window limits throughput", config };
+			Sender sender { isn };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 0 ) );
+			test.execute( DrainAcks { { isn + 1 } } );
+			test.execute( Idle { 50 } );
+
+			test.execute( RoundTrip { sender, 50 } );
+			test.execute( ExpectRTTEstimate { 50 } );
+			for ( int i = 0; i < 20; ++i ) {
+				test.execute( RoundTrip { sender, 50 } );
+			}
+			test.execute( ExpectRTTEstimate { 50 } );
+			test.execute( Capacity { max_capacity } );
+
+			// The last data arrived 50 ms ago; the buffer starts going back once a second passes without any, but
+			// the window already advertised stays open, closing only as the sender uses it
+			const uint64_t window_end = sender.next_index + max_capacity;
+			test.execute( ExpectWindowEnd { window_end } );
+			test.execute( Idle { 949 } );
+			test.execute( Capacity { max_capacity } );
+			test.execute( Idle { 1 } );
+			test.execute( Capacity { max_capacity } );
+			test.execute( ExpectWindowEnd { window_end } );
+
+			test.execute( Deliver { sender, 1 << 20 } );
+			test.execute( Capacity { max_capacity - ( 1 << 20 ) } );
+			test.execute( ExpectWindowEnd { window_end } );
+			test.execute( Idle { 100 } );
+			test.execute( Capacity { max_capacity - ( 1 << 20 ) } );
+
+			test.execute( Deliver { sender, window_end - sender.next_index } );
+			test.execute( Capacity { TCPConfig::DEFAULT_CAPACITY } );
+			test.execute( ExpectWindowEnd { window_end + TCPConfig::DEFAULT_CAPACITY } );
+			test.execute( ResidentCapacity { 0 } );
+		}
+
+		{
+			TCPConfig config;
+			config.recv_capacity_max = max_capacity;
+			config.recv_window_scale = TCPConfig::window_scale_for( max_capacity );
+			TCPReceiverTestHarness test { "no shrinking while data is pending", config };
+			Sender sender { isn };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 0 ) );
+			test.execute( DrainAcks { { isn + 1 } } );
+			test.execute( Idle { 50 } );
+			for ( int i = 0; i < 21; ++i ) {
+				test.execute( RoundTrip { sender, 50 } );
+			}
+			test.execute( Capacity { max_capacity } );
+
+			// A segment past a gap is still waiting when the connection has been idle long enough
+			test.execute( SegmentArrives {}
+							.with_seqno( isn + static_cast<uint32_t>( 1 + sender.next_index + 1000 ) )
+							.with_data( string( 1000, 'y' ) ) );
+			test.execute( Idle { 1000 } );
+			test.execute( Idle { 1000 } );
+			test.execute( Capacity { max_capacity } );
+
+			test.execute( Deliver { sender, 2000 } );
+			test.execute( Capacity { max_capacity - 2000 } );
+		}
+
+		{
+			TCPConfig config;
+			config.recv_capacity_max = max_capacity;
+			config.recv_window_scale = TCPConfig::window_scale_for( max_capacity );
+			TCPReceiverTestHarness test { "a window advertised by send() is not taken back", config };
+			Sender sender { isn };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 0 ) );
+			test.execute( DrainAcks { { isn + 1 } } );
+			test.execute( Idle { 50 } );
+			for ( int i = 0; i < 21; ++i ) {
+				test.execute( RoundTrip { sender, 50 } );
+			}
+			test.execute( Capacity { max_capacity } );
+
+			// From here on, acks are only sent with send() and tick(): data the application reads opens the
+			// window, send() advertises it, and the capacity must not shrink below it once the connection idles
+			test.execute( SegmentArrives {}
+							.with_seqno( isn + static_cast<uint32_t>( 1 + sender.next_index ) )
+							.with_data( string( 1000, 'y' ) ) );
+			sender.next_index += 1000;
+			test.execute( Idle { 50 } );
+			test.execute( ReadAll { string( 1000, 'y' ) } );
+			const uint64_t window_end = sender.next_index + max_capacity;
+			test.execute( Send {} );
+
+			test.execute( Idle { 1000 } );
+			test.execute( Capacity { max_capacity } );
+			test.execute( ExpectWindowEnd { window_end } );
+		}
+
+		{
+			TCPConfig config;
+			config.recv_capacity_max = max_capacity;
+			config.recv_window_scale = TCPConfig::window_scale_for( max_capacity );
+			TCPReceiverTestHarness test { "inspecting the window does not advertise it", config };
+			Sender sender { isn };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 0 ) );
+			test.execute( DrainAcks { { isn + 1 } } );
+			test.execute( Idle { 50 } );
+			for ( int i = 0; i < 21; ++i ) {
+				test.execute( RoundTrip { sender, 50 } );
+			}
+
+			// The window opened by the read is only looked at (through a const TCPReceiver), never sent
+			test.execute( SegmentArrives {}
+							.with_seqno( isn + static_cast<uint32_t>( 1 + sender.next_index ) )
+							.with_data( string( 1000, 'y' ) ) );
+			sender.next_index += 1000;
+			test.execute( Idle { 50 } );
+			test.execute( ReadAll { string( 1000, 'y' ) } );
+			test.execute( ExpectWindowEnd { sender.next_index + max_capacity } );
+
+			test.execute( Idle { 1000 } );
+			test.execute( ExpectShrunkBelow { max_capacity } );
+		}
+
+		{
+			TCPConfig config;
+			config.recv_capacity_max = max_capacity;
+			TCPReceiverTestHarness test { "capacity limited by the largest unscaled window", config };
+			Sender sender { isn };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			test.execute( Idle { 50 } );
+			for ( int i = 0; i < 10; ++i ) {
+				test.execute( RoundTrip { sender, 50 } );
+			}
+			test.execute( Capacity { UINT16_MAX } );
+		}
+
+		{
+			TCPConfig config;
+			config.recv_window_scale = TCPConfig::window_scale_for( max_capacity );
+			TCPReceiverTestHarness test { "no auto-tuning unless configured", config };
+			Sender sender { isn };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 0 ) );
+			test.execute( Idle { 50 } );
+			for ( int i = 0; i < 10; ++i ) {
+				test.execute( RoundTrip { sender, 50 } );
+			}
+			test.execute( ExpectRTTEstimate { 0 } );
+			test.execute( Capacity { TCPConfig::DEFAULT_CAPACITY } );
+		}
+
+		{
+			TCPConfig config;
+			config.recv_capacity_max = max_capacity;
+			config.recv_window_scale = TCPConfig::window_scale_for( max_capacity );
+			TCPReceiverTestHarness test { "no growth while the application reads slowly", config };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 0 ) );
+			for ( uint32_t i = 0; i < 20; ++i ) {
+				test.execute( Idle { 50 } );
+				test.execute( SegmentArrives {}.with_seqno( isn + 1 + i * 1000 ).with_data( string( 1000, 'x' ) ) );
+				test.execute( ReadAll { string( 1000, 'x' ) } );
+			}
+			test.execute( Capacity { TCPConfig::DEFAULT_CAPACITY } );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,85 @@
+#include "byte_stream_test_harness.hh"
+#include "random.hh"
+#include "reassembler_test_harness.hh"
+#include "receiver_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+	try {
+		auto rd = get_random_engine();
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "batch with SYN, then out of order", 4000 };
+			test.execute( SegmentsArrive { SegmentArrives {}.with_syn().with_seqno( isn ).with_data( "abc" ),
+										   SegmentArrives {}.with_seqno( isn + 5 ).with_data( "efgh" ),
+										   SegmentArrives {}.with_seqno( isn + 4 ).with_data( "d" ) } );
+			test.execute( ExpectAckno { Wrap32 { isn + 9 } } );
+			test.execute( BytesPending { 0 } );
+			test.execute( ReadAll { "abcdefgh" } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "batch with a hole, then FIN", 4000 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			test.execute( SegmentsArrive { SegmentArrives {}.with_seqno( isn + 1 ).with_data( "ab" ),
+										   SegmentArrives {}.with_seqno( isn + 5 ).with_data( "ef" ).with_fin() } );
+			test.execute( ExpectAckno { Wrap32 { isn + 3 } } );
+			test.execute( BytesPending { 2 } );
+			test.execute( IsClosed { false } );
+
+			test.execute( SegmentsArrive { SegmentArrives {}.with_seqno( isn + 3 ).with_data( "cd" ) } );
+			test.execute( ExpectAckno { Wrap32 { isn + 8 } } );
+			test.execute( IsClosed { true } );
+			test.execute( ReadAll { "abcdef" } );
+		}
+
+		{
+			// Each sequence number is unwrapped near the end of the message before it, as receive() would
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "batch of consecutive segments", 4000 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			test.execute(
+			  SegmentsArrive { SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 1000, 'a' ) ),
+							   SegmentArrives {}.with_seqno( isn + 1001 ).with_data( string( 1000, 'b' ) ),
+							   SegmentArrives {}.with_seqno( isn + 2001 ).with_data( "c" ) } );
+			test.execute( ExpectAckno { Wrap32 { isn + 2002 } } );
+			test.execute( BytesPushed { 2001 } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "batch before SYN", 4000 };
+			test.execute( SegmentsArrive { SegmentArrives {}.with_seqno( isn + 1 ).with_data( "hello" ) } );
+			test.execute( HasAckno { false } );
+			test.execute( BytesPending { 0 } );
+			test.execute( SegmentsArrive { SegmentArrives {}.with_syn().with_seqno( isn ),
+										   SegmentArrives {}.with_seqno( isn + 1 ).with_data( "hello" ) } );
+			test.execute( ExpectAckno { Wrap32 { isn + 6 } } );
+			test.execute( ReadAll { "hello" } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "batch with RST", 4000 };
+			test.execute( SegmentsArrive { SegmentArrives {}.with_syn().with_seqno( isn ),
+										   SegmentArrives {}.with_seqno( isn + 1 ).with_rst(),
+										   SegmentArrives {}.with_seqno( isn + 1 ).with_data( "ab" ) } );
+			test.execute( ExpectReset { true } );
+			test.execute( BytesPushed { 2 } );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+#include "byte_stream_test_harness.hh"
+#include "random.hh"
+#include "reassembler_test_harness.hh"
+#include "receiver_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+	try {
+		auto rd = get_random_engine();
+		const string full( TCPConfig::MAX_PAYLOAD_SIZE, 'x' );
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "SYN acked at once", 64000 };
+			test.execute( DrainAcks { {} } );
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			test.execute( ExpectAckDelayed { false } );
+			test.execute( DrainAcks { { Wrap32 { isn + 1 } } } );
+			test.execute( DrainAcks { {} } );
+			test.execute( Tick { 1000 } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "single segment acked on the timer", 64000 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			test.execute( DrainAcks { { Wrap32 { isn + 1 } } } );
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( full ) );
+			test.execute( ExpectAckDelayed { true } );
+			test.execute( DrainAcks { {} } );
+			test.execute( Tick { TCPConfig::ACK_DELAY_DFLT - 1 } );
+			test.execute( Tick { 1 }.with_acks( { Wrap32 { isn + 1001 } } ) );
+			test.execute( ExpectAckDelayed { false } );
+
+			test.execute( SegmentArrives {}.with_seqno( isn + 1001 ).with_data( "abc" ) );
+			test.execute( ExpectAckDelayed { true } );
+			test.execute( Tick { TCPConfig::ACK_DELAY_DFLT }.with_acks( { Wrap32 { isn + 1004 } } ) );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "every second full segment acked", 64000 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			test.execute( DrainAcks { { Wrap32 { isn + 1 } } } );
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( full ) );
+			test.execute( SegmentArrives {}.with_seqno( isn + 1001 ).with_data( full ) );
+			test.execute( ExpectAckDelayed { false } );
+			test.execute( SegmentArrives {}.with_seqno( isn + 2001 ).with_data( full ) );
+			test.execute( ExpectAckDelayed { true } );
+			test.execute( DrainAcks { { Wrap32 { isn + 3001 } } } );
+			test.execute( ExpectAckDelayed { false } );
+			test.execute( SegmentArrives {}.with_seqno( isn + 3001 ).with_data( full ) );
+			test.execute( SegmentArrives {}.with_seqno( isn + 4001 ).with_data( full ) );
+			test.execute( SegmentArrives {}.with_seqno( isn + 5001 ).with_data( full ) );
+			test.execute( DrainAcks { { Wrap32 { isn + 6001 } } } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "out-of-order data acked at once", 64000 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			test.execute( DrainAcks { { Wrap32 { isn + 1 } } } );
+			test.execute( SegmentArrives {}.with_seqno( isn + 1001 ).with_data( full ) );
+			test.execute( SegmentArrives {}.with_seqno( isn + 2001 ).with_data( full ) );
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ) );
+			test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( string( 997, 'y' ) ) );
+			test.execute(
+			  DrainAcks { { Wrap32 { isn + 1 }, Wrap32 { isn + 1 }, Wrap32 { isn + 4 }, Wrap32 { isn + 3001 } } } );
+			test.execute( ExpectAckDelayed { false } );
+
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ) );
+			test.execute( DrainAcks { { Wrap32 { isn + 3001 } } } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "acks drained together lead with their own arrival", 64000 };
+			const SACKBlock first { Wrap32 { isn + 11 }, Wrap32 { isn + 13 } };
+			const SACKBlock second { Wrap32 { isn + 21 }, Wrap32 { isn + 23 } };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			test.execute( DrainAcks { { Wrap32 { isn + 1 } } } );
+			test.execute( SegmentArrives {}.with_seqno( isn + 11 ).with_data( "bb" ) );
+			test.execute( SegmentArrives {}.with_seqno( isn + 21 ).with_data( "cc" ) );
+			test.execute( DrainAcks { { Wrap32 { isn + 1 }, Wrap32 { isn + 1 } } }.with_sack(
+			  { { first, second }, { second, first } } ) );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "FIN acked at once", 64000 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ) );
+			test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_fin() );
+			test.execute( DrainAcks { { Wrap32 { isn + 5 } } } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "window update acked", 4000 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			for ( uint32_t i = 0; i < 4; ++i ) {
+				test.execute( SegmentArrives {}.with_seqno( isn + 1 + i * 1000 ).with_data( full ) );
+			}
+			test.execute( DrainAcks { { Wrap32 { isn + 4001 } } } );
+			test.execute( ExpectWindow { 0 } );
+			test.execute( Pop { 1000 } );
+			test.execute( DrainAcks { {} } );
+			test.execute( Pop { 1000 } );
+			test.execute( DrainAcks { { Wrap32 { isn + 4001 } } } );
+			test.execute( DrainAcks { {} } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "batch acked as one", 64000 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			test.execute( DrainAcks { { Wrap32 { isn + 1 } } } );
+			test.execute( SegmentsArrive { SegmentArrives {}.with_seqno( isn + 1 ).with_data( full ),
+										   SegmentArrives {}.with_seqno( isn + 1001 ).with_data( full ),
+										   SegmentArrives {}.with_seqno( isn + 2001 ).with_data( full ) } );
+			test.execute( DrainAcks { { Wrap32 { isn + 3001 } } } );
+
+			test.execute( SegmentsArrive { SegmentArrives {}.with_seqno( isn + 3001 ).with_data( "a" ) } );
+			test.execute( ExpectAckDelayed { true } );
+			test.execute( SegmentsArrive { SegmentArrives {}.with_seqno( isn + 3002 ).with_data( "b" ),
+										   SegmentArrives {}.with_seqno( isn + 3004 ).with_data( "d" ) } );
+			test.execute( DrainAcks { { Wrap32 { isn + 3003 } } } );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+#include "byte_stream_test_harness.hh"
+#include "random.hh"
+#include "reassembler_test_harness.hh"
+#include "receiver_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+	try {
+		auto rd = get_random_engine();
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "no SACK blocks in order", 4000 };
+			test.execute( ExpectSACK { {} } );
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abcd" ) );
+			test.execute( ExpectAckno { Wrap32 { isn + 5 } } );
+			test.execute( ExpectSACK { {} } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "SACK blocks for out-of-order segments", 4000 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "efgh" ) );
+			test.execute( ExpectAckno { Wrap32 { isn + 1 } } );
+			test.execute( ExpectSACK { { { Wrap32 { isn + 5 }, Wrap32 { isn + 9 } } } } );
+
+			test.execute( SegmentArrives {}.with_seqno( isn + 13 ).with_data( "mn" ) );
+			test.execute( ExpectSACK {
+			  { { Wrap32 { isn + 13 }, Wrap32 { isn + 15 } }, { Wrap32 { isn + 5 }, Wrap32 { isn + 9 } } } } );
+
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abcd" ) );
+			test.execute( ExpectAckno { Wrap32 { isn + 9 } } );
+			test.execute( ExpectSACK { { { Wrap32 { isn + 13 }, Wrap32 { isn + 15 } } } } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "at most four SACK blocks", 4000 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			for ( uint32_t i = 2; i <= 12; i += 2 ) {
+				test.execute( SegmentArrives {}.with_seqno( isn + i ).with_data( "x" ) );
+			}
+			test.execute( ExpectSACK { { { Wrap32 { isn + 12 }, Wrap32 { isn + 13 } },
+										 { Wrap32 { isn + 10 }, Wrap32 { isn + 11 } },
+										 { Wrap32 { isn + 8 }, Wrap32 { isn + 9 } },
+										 { Wrap32 { isn + 6 }, Wrap32 { isn + 7 } } } } );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
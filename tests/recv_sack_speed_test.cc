@@ -0,0 +1,125 @@
+#include "tcp_config.hh"
+#include "tcp_receiver.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct TransferResult
+{
+	uint64_t bytes_sent;
+	uint64_t rounds;
+};
+
+// Send `data` over a link that drops each segment with probability `loss`, one window per round trip.
+// At the end of each round the sender hears the receiver's latest message (acknowledgments are not lost)
+// and resends whatever it has no evidence was received: everything past the ackno, or, with `use_sack`,
+// only the segments no SACK block has covered.
+TransferResult transfer( const string& data, const double loss, const bool use_sack, const size_t seed )
+{
+	constexpr size_t segment_size = TCPConfig::MAX_PAYLOAD_SIZE;
+	const Wrap32 isn { 137 };
+	const size_t num_segments = ( data.size() + segment_size - 1 ) / segment_size;
+
+	TCPReceiver receiver { Reassembler { ByteStream { TCPConfig::DEFAULT_CAPACITY } } };
+	default_random_engine rd { seed };
+	bernoulli_distribution dropped { loss };
+
+	receiver.receive( { .seqno = isn, .SYN = true } );
+
+	vector<bool> sacked( num_segments );
+	size_t highest_sent = 0; // Segments [0, highest_sent) have been sent at least once
+	TransferResult result {};
+
+	while ( not receiver.reader().is_finished() ) {
+		const TCPReceiverMessage ack = receiver.send();
+		const uint64_t acked = ack.ackno->unwrap( isn, highest_sent * segment_size ) - 1;
+		const uint64_t window_end = acked + ack.window();
+
+		if ( use_sack ) {
+			for ( const auto& block : ack.sack_blocks ) {
+				const uint64_t left = block.left_edge.unwrap( isn, acked ) - 1;
+				const uint64_t right = block.right_edge.unwrap( isn, acked ) - 1;
+				// Mark the segments that lie entirely within the block
+				const uint64_t first = ( left + segment_size - 1 ) / segment_size;
+				for ( uint64_t k = first; ( k + 1 ) * segment_size <= right; ++k ) {
+					sacked[k] = true;
+				}
+			}
+		}
+
+		for ( size_t k = acked / segment_size; k < num_segments and k * segment_size < window_end; ++k ) {
+			if ( sacked[k] ) {
+				continue;
+			}
+
+			TCPSenderMessage segment { .seqno = isn + static_cast<uint32_t>( 1 + k * segment_size ),
+									   .payload = data.substr( k * segment_size, segment_size ),
+									   .FIN = k + 1 == num_segments };
+			result.bytes_sent += segment.payload.size();
+			highest_sent = max( highest_sent, k + 1 );
+			if ( not dropped( rd ) ) {
+				receiver.receive( move( segment ) );
+			}
+		}
+
+		receiver.reader().pop( receiver.reader().bytes_buffered() );
+		++result.rounds;
+	}
+
+	return result;
+}
+
+void sack_test( fstream& debug_output, const size_t size, const double loss, const size_t seed )
+{
+	const string data( size, 'x' );
+
+	uint64_t retransmitted_without_sack = 0;
+	for ( const bool use_sack : { false, true } ) {
+		const TransferResult result = transfer( data, loss, use_sack, seed );
+		const uint64_t retransmitted = result.bytes_sent - data.size();
+		const double percent = 100.0 * static_cast<double>( retransmitted ) / static_cast<double>( data.size() );
+		const string_view label = use_sack ? "with SACK:   " : "without SACK:";
+
+		cout << "Transfer of " << data.size() << " bytes at " << fixed << setprecision( 0 ) << 100 * loss
+			 << "% loss " << label << " " << result.rounds << " round trips, " << retransmitted
+			 << " bytes retransmitted (" << setprecision( 1 ) << percent << "%).\n";
+		debug_output << "        Retransmitted at " << fixed << setprecision( 0 ) << setw( 2 ) << 100 * loss
+					 << "% loss " << label << setprecision( 1 ) << setw( 7 ) << percent << "%\n";
+
+		if ( not use_sack ) {
+			retransmitted_without_sack = retransmitted;
+		} else if ( retransmitted >= retransmitted_without_sack and retransmitted_without_sack > 0 ) {
+			throw runtime_error( "SACK blocks did not reduce the bytes retransmitted" );
+		}
+	}
+}
+
+void program_body()
+{
+	fstream debug_output;
+	debug_output.open( "/dev/tty" );
+
+	sack_test( debug_output, 4 << 20, 0.01, 1 );
+	sack_test( debug_output, 4 << 20, 0.05, 2 );
+	sack_test( debug_output, 4 << 20, 0.20, 3 );
+}
+
+int main()
+{
+	try {
+		program_body();
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "random.hh"
+#include "reassembler_test_harness.hh"
+#include "receiver_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+	try {
+		auto rd = get_random_engine();
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "no scaling unless the SYN asks for it", 1 << 20, 5 };
+			test.execute( ExpectWindowScale { nullopt } );
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+			test.execute( ExpectWindowScale { nullopt } );
+			test.execute( ExpectWindow { UINT16_MAX } );
+			test.execute( ExpectWindowBytes { UINT16_MAX } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "the SYN-ACK's window is not scaled", 1 << 20, 5 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 7 ) );
+			test.execute( ExpectWindowScale { 5 } );
+			test.execute( ExpectWindow { UINT16_MAX } );
+			test.execute( ExpectWindowBytes { UINT16_MAX } );
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 7 ) );
+			test.execute( ExpectWindow { UINT16_MAX } ); // a retransmitted SYN-ACK is still unscaled
+
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 ) ); // the peer's ack of the SYN-ACK
+			test.execute( ExpectWindow { ( 1 << 20 ) >> 5 } );
+			test.execute( ExpectWindowBytes { 1 << 20 } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "window advertised in scaled units", 1 << 20, 5 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 7 ) );
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 ) );
+			test.execute( ExpectWindowScale { 5 } );
+			test.execute( ExpectWindow { ( 1 << 20 ) >> 5 } );
+			test.execute( ExpectWindowBytes { 1 << 20 } );
+
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 100, 'x' ) ) );
+			test.execute( ExpectAckno { Wrap32 { isn + 101 } } );
+			test.execute( ExpectWindow { ( ( 1 << 20 ) - 100 ) >> 5 } );
+			test.execute( ExpectWindowBytes { ( ( ( 1 << 20 ) - 100 ) >> 5 ) << 5 } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "data beyond 64 KB accepted with scaling", 200000, 2 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 0 ) );
+			test.execute( ExpectWindowBytes { UINT16_MAX } );
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 ) );
+			test.execute( ExpectWindowBytes { 200000 } );
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 + 150000 ).with_data( "abc" ) );
+			test.execute( ExpectAckno { Wrap32 { isn + 1 } } );
+			test.execute( BytesPending { 3 } );
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 150000, 'x' ) ) );
+			test.execute( ExpectAckno { Wrap32 { isn + 150004 } } );
+			test.execute( ExpectWindowBytes { 50000 - 3 - ( ( 50000 - 3 ) % 4 ) } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "scale of zero is negotiated but unscaled", 4000, 0 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 3 ) );
+			test.execute( ExpectWindowScale { 0 } );
+			test.execute( ExpectWindow { 4000 } );
+		}
+
+		{
+			const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+			TCPReceiverTestHarness test { "shift clamped to 14", 1 << 20, 20 };
+			test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 14 ) );
+			test.execute( SegmentArrives {}.with_seqno( isn + 1 ) );
+			test.execute( ExpectWindowScale { TCPConfig::MAX_WINDOW_SCALE } );
+			test.execute( ExpectWindow { ( 1 << 20 ) >> 14 } );
+		}
+
+		{
+			static_assert( TCPConfig::window_scale_for( TCPConfig::DEFAULT_CAPACITY ) == 0 );
+			static_assert( TCPConfig::window_scale_for( 65536 ) == 1 );
+			static_assert( TCPConfig::window_scale_for( 1 << 20 ) == 5 );
+			static_assert( TCPConfig::window_scale_for( SIZE_MAX ) == TCPConfig::MAX_WINDOW_SCALE );
+		}
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
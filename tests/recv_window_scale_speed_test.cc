@@ -0,0 +1,107 @@
+#include "tcp_config.hh"
+#include "tcp_receiver.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// A simulated path: 50 ms round-trip time over a 1 Gbit/s link (a bandwidth-delay product of 6.25 MB)
+constexpr double rtt_seconds = 0.050;
+constexpr double link_bytes_per_second = 1e9 / 8;
+
+// Send `data` one window per round trip, as a window-limited sender would. A round lasts one RTT, or longer
+// if the window takes longer than that to serialize onto the link. The application reads everything that
+// arrived at the end of each round. Returns the simulated transfer time, in seconds.
+double transfer( const string& data, const size_t capacity, const bool use_window_scale )
+{
+	constexpr size_t segment_size = TCPConfig::MAX_PAYLOAD_SIZE;
+	const Wrap32 isn { 137 };
+
+	TCPConfig config;
+	config.recv_capacity = capacity;
+	config.recv_window_scale = TCPConfig::window_scale_for( capacity );
+	TCPReceiver receiver { Reassembler { ByteStream { capacity } }, config };
+
+	TCPSenderMessage syn { .seqno = isn, .SYN = true };
+	if ( use_window_scale ) {
+		syn.window_scale = 0;
+	}
+	receiver.receive( move( syn ) );
+
+	double elapsed = 0;
+	while ( not receiver.reader().is_finished() ) {
+		const TCPReceiverMessage ack = receiver.send();
+		const uint64_t acked = ack.ackno->unwrap( isn, receiver.writer().bytes_pushed() ) - 1;
+		const uint64_t window_end = min( acked + ack.window(), static_cast<uint64_t>( data.size() ) );
+
+		for ( uint64_t offset = acked; offset < window_end; offset += segment_size ) {
+			const size_t length = min( segment_size, window_end - offset );
+			receiver.receive( { .seqno = isn + static_cast<uint32_t>( 1 + offset ),
+								.payload = data.substr( offset, length ),
+								.FIN = offset + length == data.size() } );
+		}
+
+		elapsed += max( rtt_seconds, static_cast<double>( window_end - acked ) / link_bytes_per_second );
+		receiver.reader().pop( receiver.reader().bytes_buffered() );
+	}
+
+	return elapsed;
+}
+
+void window_scale_test( fstream& debug_output, const string& data, const size_t capacity )
+{
+	double unscaled_rate = 0;
+	for ( const bool use_window_scale : { false, true } ) {
+		const auto start = chrono::steady_clock::now();
+		const double elapsed = transfer( data, capacity, use_window_scale );
+		const auto stop = chrono::steady_clock::now();
+
+		const double rate = static_cast<double>( data.size() ) / elapsed;
+		const double wall = chrono::duration_cast<chrono::duration<double>>( stop - start ).count();
+		const string_view label = use_window_scale ? "with window scaling:   " : "without window scaling:";
+
+		cout << "Capacity " << setw( 8 ) << capacity << " " << label << " " << fixed << setprecision( 2 )
+			 << rate / 1e6 << " MB/s over a 50 ms RTT (simulated " << data.size() << " bytes in " << elapsed
+			 << " s; " << setprecision( 3 ) << wall << " s of wall time).\n";
+		debug_output << "        Capacity " << setw( 8 ) << capacity << " " << label << fixed << setprecision( 2 )
+					 << setw( 8 ) << rate / 1e6 << " MB/s\n";
+
+		if ( not use_window_scale ) {
+			unscaled_rate = rate;
+		} else if ( capacity > UINT16_MAX and rate <= unscaled_rate ) {
+			throw runtime_error( "window scaling did not raise throughput past a 64 KB window" );
+		} else if ( rate < unscaled_rate ) {
+			throw runtime_error( "window scaling lowered throughput" );
+		}
+	}
+}
+
+void program_body()
+{
+	fstream debug_output;
+	debug_output.open( "/dev/tty" );
+
+	const string data( 32 << 20, 'x' );
+	for ( const size_t capacity : { size_t { 64000 }, size_t { 256 << 10 }, size_t { 1 << 20 }, size_t { 4 << 20 },
+									size_t { 16 << 20 } } ) {
+		window_scale_test( debug_output, data, capacity );
+	}
+}
+
+int main()
+{
+	try {
+		program_body();
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+#include "common.hh"
+#include "random.hh"
+#include "slot_map.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void basic_test()
+{
+	SlotMap<string, 4> map;
+	const auto a = map.emplace( "a" );
+	const auto b = map.emplace( 3, 'b' );
+	expect( map.size() == 2 and map.find( a ) != nullptr and *map.find( b ) == "bbb", "two values" );
+
+	// A value stays put while others come and go, and a stale key finds nothing
+	const string* const b_address = map.find( b );
+	expect( map.erase( a ), "erasing a live key to succeed" );
+	expect( not map.erase( a ) and map.find( a ) == nullptr, "a stale key to find nothing" );
+	for ( unsigned i = 0; i < 100; ++i ) {
+		map.emplace( to_string( i ) );
+	}
+	expect( map.find( b ) == b_address, "a value not to move" );
+
+	// A freed slot is reused, under a new generation
+	const auto c = map.emplace( "c" );
+	const auto d = map.emplace( "d" );
+	map.erase( c );
+	const auto e = map.emplace( "e" );
+	expect( e.slot == c.slot and e.generation != c.generation, "a freed slot to be reused" );
+	expect( map.find( c ) == nullptr and *map.find( e ) == "e" and *map.find( d ) == "d", "keys to stay distinct" );
+
+	size_t live = 0;
+	for ( uint32_t slot = 0; slot < map.slot_count(); ++slot ) {
+		live += map.get( slot ) != nullptr ? 1 : 0;
+	}
+	test_should_be( live, map.size() );
+}
+
+// Emplace and erase at random, against a map of the values that should be present
+void random_test( default_random_engine& rd )
+{
+	SlotMap<unique_ptr<uint64_t>> map;
+	vector<pair<SlotKey, uint64_t>> keys;
+	std::map<uint64_t, bool> present;
+
+	for ( uint64_t i = 0; i < 100000; ++i ) {
+		if ( keys.empty() or uniform_int_distribution<unsigned> { 0, 2 }( rd ) > 0 ) {
+			keys.emplace_back( map.emplace( make_unique<uint64_t>( i ) ), i );
+			present[i] = true;
+		} else {
+			const size_t k = uniform_int_distribution<size_t> { 0, keys.size() - 1 }( rd );
+			const auto [key, value] = keys[k];
+			expect( map.erase( key ) == present[value], "erase() to report whether the value was present" );
+			present[value] = false;
+		}
+
+		const auto [key, value] = keys[uniform_int_distribution<size_t> { 0, keys.size() - 1 }( rd )];
+		const unique_ptr<uint64_t>* found = map.find( key );
+		expect( ( found != nullptr ) == present[value], "find() to find exactly the present values" );
+		expect( found == nullptr or **found == value, "find() to return the right value" );
+	}
+}
+
+} // namespace
+
+int main()
+{
+	try {
+		auto rd = get_random_engine();
+		basic_test();
+		random_test( rd );
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+#include "common.hh"
+#include "random.hh"
+#include "test_should_be.hh"
+#include "timer_wheel.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Add, cancel and advance at random, checking that each timer fires exactly at its expiry, in order, against
+// a multimap of the pending timers
+void random_test( default_random_engine& rd, const uint64_t max_delay, const uint64_t max_step )
+{
+	const uint64_t start = uniform_int_distribution<uint64_t> { 0, UINT32_MAX }( rd );
+	TimerWheel wheel { start };
+	multimap<uint64_t, uint64_t> expected; // expiry -> serial number
+	vector<pair<uint64_t, TimerWheel::TimerId>> ids;
+	uint64_t serial = 0;
+	uint64_t last_fired = start;
+
+	for ( unsigned step = 0; step < 20000; ++step ) {
+		const unsigned action = uniform_int_distribution<unsigned> { 0, 9 }( rd );
+		if ( action < 5 ) {
+			const uint64_t delay = uniform_int_distribution<uint64_t> { 0, max_delay }( rd );
+			const uint64_t expiry = wheel.now() + delay;
+			const uint64_t number = serial++;
+			ids.emplace_back( number, wheel.add( delay, [&, expiry, number] {
+				test_should_be( wheel.now(), expiry );
+				expect( expiry >= last_fired, "timers to fire in order" );
+				last_fired = expiry;
+				const auto [first, last] = expected.equal_range( expiry );
+				bool found = false;
+				for ( auto it = first; it != last; ++it ) {
+					if ( it->second == number ) {
+						expected.erase( it );
+						found = true;
+						break;
+					}
+				}
+				expect( found, "a pending timer to fire" );
+			} ) );
+			expected.emplace( expiry, number );
+		} else if ( action < 7 and not ids.empty() ) {
+			const size_t k = uniform_int_distribution<size_t> { 0, ids.size() - 1 }( rd );
+			const auto [number, id] = ids[k];
+			ids[k] = ids.back();
+			ids.pop_back();
+			bool pending = false;
+			for ( auto it = expected.begin(); it != expected.end(); ++it ) {
+				if ( it->second == number ) {
+					expected.erase( it );
+					pending = true;
+					break;
+				}
+			}
+			expect( wheel.cancel( id ) == pending, "cancel() to report whether the timer was pending" );
+			expect( not wheel.cancel( id ), "a second cancel() to fail" );
+		} else {
+			const uint64_t target = wheel.now() + uniform_int_distribution<uint64_t> { 0, max_step }( rd );
+			size_t due = 0;
+			for ( auto it = expected.begin(); it != expected.end() and it->first <= target; ++it ) {
+				++due;
+			}
+			test_should_be( wheel.advance( target ), due );
+			test_should_be( wheel.now(), target );
+		}
+
+		test_should_be( wheel.size(), expected.size() );
+		const auto wakeup = wheel.next_wakeup();
+		expect( wakeup.has_value() == not expected.empty(), "a wakeup while timers are pending" );
+		if ( wakeup.has_value() ) {
+			expect( *wakeup >= wheel.now() and *wakeup <= expected.begin()->first,
+					"the wakeup to be no later than the earliest expiry" );
+		}
+	}
+
+	wheel.advance( UINT64_MAX / 2 );
+	expect( expected.empty() and wheel.empty(), "every timer to fire eventually" );
+}
+
+void callback_test()
+{
+	TimerWheel wheel { 1000 };
+	vector<string> log;
+
+	// A callback can cancel a timer that is due at the same time, and add one that is due at once
+	TimerWheel::TimerId victim {};
+	wheel.add( 10, [&] {
+		log.emplace_back( "first" );
+		expect( wheel.cancel( victim ), "a timer due now to be cancellable" );
+		wheel.add( 0, [&] { log.emplace_back( "immediate" ); } );
+		wheel.add( 5, [&] { log.emplace_back( "later" ); } );
+	} );
+	victim = wheel.add( 10, [&] { log.emplace_back( "victim" ); } );
+	wheel.add( 11, [&] { log.emplace_back( "next" ); } );
+
+	expect( wheel.next_wakeup() == 1010, "a wakeup at the first expiry" );
+	test_should_be( wheel.advance( 1009 ), 0UL );
+	test_should_be( wheel.advance( 1010 ), 2UL );
+	expect( log == vector<string> { "first", "immediate" }, "the cancelled timer not to fire" );
+	test_should_be( wheel.advance( 2000 ), 2UL );
+	expect( log == vector<string> { "first", "immediate", "next", "later" }, "timers to fire in order" );
+	expect( not wheel.next_wakeup().has_value(), "no wakeup when empty" );
+
+	// Long delays cascade down the wheel, waking early, but fire on time
+	bool fired = false;
+	wheel.add( 1'000'000, [&] { fired = true; } );
+	const auto wakeup = wheel.next_wakeup();
+	expect( wakeup.has_value() and *wakeup < 1'002'000, "a wakeup to cascade before the expiry" );
+	wheel.advance( 1'001'999 );
+	expect( not fired, "no early firing" );
+	wheel.advance( 1'002'000 );
+	expect( fired, "the long timer to fire" );
+
+	// Delays beyond the top of the wheel are capped
+	wheel.add( UINT64_MAX, [] {} );
+	expect( wheel.next_wakeup().has_value(), "a wakeup for a capped timer" );
+	test_should_be( wheel.advance( wheel.now() + ( uint64_t { 1 } << 36 ) ), 1UL );
+}
+
+} // namespace
+
+int main()
+{
+	try {
+		auto rd = get_random_engine();
+		callback_test();
+		random_test( rd, 100, 50 );
+		random_test( rd, 10'000, 3'000 );
+		random_test( rd, 100'000'000, 10'000'000 );
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,125 @@
+#include "timer_wheel.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// The usual alternative to a timing wheel: timers in a multimap ordered by expiry, cancelled by iterator
+class TimerMap
+{
+	multimap<uint64_t, function<void( void )>> timers_ {};
+	uint64_t now_ms_ {};
+
+  public:
+	using TimerId = multimap<uint64_t, function<void( void )>>::iterator;
+
+	TimerId add( uint64_t delay_ms, function<void( void )> callback )
+	{
+		return timers_.emplace( now_ms_ + delay_ms, std::move( callback ) );
+	}
+
+	void cancel( TimerId id ) { timers_.erase( id ); }
+
+	size_t advance( uint64_t now_ms )
+	{
+		size_t fired = 0;
+		while ( not timers_.empty() and timers_.begin()->first <= now_ms ) {
+			auto node = timers_.extract( timers_.begin() );
+			now_ms_ = node.key();
+			node.mapped()();
+			++fired;
+		}
+		now_ms_ = max( now_ms_, now_ms );
+		return fired;
+	}
+};
+
+// Arm `count` timers with delays of up to a minute, then either cancel them all in random order (as acks cancel
+// retransmission timers) or let them all fire, advancing a millisecond at a time
+template<class Timers>
+double timer_test( const size_t count, const bool cancel )
+{
+	default_random_engine rd { 1234 };
+	uniform_int_distribution<uint64_t> delay { 1, 60'000 };
+	vector<uint64_t> delays( count );
+	for ( auto& d : delays ) {
+		d = delay( rd );
+	}
+	vector<size_t> order( count );
+	for ( size_t i = 0; i < count; ++i ) {
+		order[i] = i;
+	}
+	shuffle( order.begin(), order.end(), rd );
+
+	Timers timers;
+	vector<typename Timers::TimerId> ids;
+	ids.reserve( count );
+	size_t fired = 0;
+
+	const auto start_time = steady_clock::now();
+	for ( const uint64_t d : delays ) {
+		ids.push_back( timers.add( d, [&fired] { ++fired; } ) );
+	}
+	if ( cancel ) {
+		for ( const size_t i : order ) {
+			timers.cancel( ids[i] );
+		}
+	} else {
+		for ( uint64_t ms = 1; ms <= 60'000; ++ms ) {
+			timers.advance( ms );
+		}
+	}
+	const auto stop_time = steady_clock::now();
+
+	if ( fired != ( cancel ? 0 : count ) ) {
+		throw runtime_error( "wrong number of timers fired" );
+	}
+
+	return duration_cast<duration<double, nano>>( stop_time - start_time ).count() / static_cast<double>( count );
+}
+
+void speed_test( fstream& debug_output, const size_t count, const bool cancel )
+{
+	const string_view what = cancel ? "armed and cancelled" : "armed and fired";
+	const double map_ns = timer_test<TimerMap>( count, cancel );
+	const double wheel_ns = timer_test<TimerWheel>( count, cancel );
+
+	cout << count << " timers " << what << " in " << fixed << setprecision( 1 ) << wheel_ns
+		 << " ns each with the timing wheel, " << map_ns << " ns with a multimap (" << setprecision( 2 )
+		 << map_ns / wheel_ns << "x).\n";
+	debug_output << "        Timers " << what << ":" << string( 20 - what.size(), ' ' ) << fixed
+				 << setprecision( 1 ) << setw( 6 ) << wheel_ns << " ns (multimap: " << setw( 6 ) << map_ns
+				 << " ns)\n";
+}
+
+void program_body()
+{
+	fstream debug_output;
+	debug_output.open( "/dev/tty" );
+
+	speed_test( debug_output, 1'000'000, true );
+	speed_test( debug_output, 1'000'000, false );
+}
+
+int main()
+{
+	try {
+		program_body();
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
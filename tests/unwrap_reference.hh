@@ -0,0 +1,30 @@
+#pragma once
+
+#include "conversions.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+
+// The candidate/alternative comparison that Wrap32::unwrap() made before it became branch-free
+inline uint64_t reference_unwrap( Wrap32 seqno, Wrap32 zero_point, uint64_t checkpoint )
+{
+	using minnow_conversions::DebugWrap32;
+	const uint32_t offset
+	  = DebugWrap32 { seqno }.debug_get_raw_value() - DebugWrap32 { zero_point }.debug_get_raw_value();
+
+	const uint64_t base = checkpoint & 0xFFFFFFFF00000000;
+	const uint64_t candidate = base + offset;
+
+	const uint64_t alt1 = candidate + ( 1ULL << 32 );
+	const uint64_t alt2 = candidate - ( 1ULL << 32 );
+
+	if ( candidate >= checkpoint ) {
+		if ( candidate - checkpoint > ( 1ULL << 31 ) && alt2 <= checkpoint ) {
+			return alt2;
+		}
+	} else if ( checkpoint - candidate > ( 1ULL << 31 ) ) {
+		return alt1;
+	}
+
+	return candidate;
+}
@@ -0,0 +1,102 @@
+#include "random.hh"
+#include "test_should_be.hh"
+#include "wrapping_integers.hh"
+
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+// Wrapping and unwrapping
+static_assert( Wrap32::wrap( 3 * ( 1UL << 32 ) + 17, Wrap32 { 5 } ) == Wrap32 { 22 } );
+static_assert( Wrap32 { 1 }.unwrap( Wrap32 { 0 }, UINT32_MAX ) == ( 1UL << 32 ) + 1 );
+static_assert( Wrap32 { UINT32_MAX }.unwrap( Wrap32 { 10 }, 3 * ( 1UL << 32 ) ) == 3 * ( 1UL << 32 ) - 11 );
+static_assert( Wrap32 { 15 }.unwrap( Wrap32 { 16 }, 0 ) == UINT32_MAX );
+static_assert( Wrap32 { UINT32_MAX }.unwrap( Wrap32 { INT32_MAX }, 0 ) == 1UL << 31 );
+
+// Signed distance, the short way around
+static_assert( Wrap32 { 1 } - Wrap32 { UINT32_MAX } == 2 );
+static_assert( Wrap32 { UINT32_MAX } - Wrap32 { 1 } == -2 );
+static_assert( Wrap32 { 1U << 31 } - Wrap32 { 0 } == INT32_MIN );
+static_assert( Wrap32 { 7 } + static_cast<uint32_t>( Wrap32 { 3 } - Wrap32 { 7 } ) == Wrap32 { 3 } );
+
+// Serial number ordering
+static_assert( Wrap32 { 5 } < Wrap32 { 6 } );
+static_assert( Wrap32 { 1 } > Wrap32 { UINT32_MAX } );
+static_assert( Wrap32 { 9 } <= Wrap32 { 9 } and Wrap32 { 9 } >= Wrap32 { 9 } );
+static_assert( ( Wrap32 { 9 } <=> Wrap32 { 9 } ) == partial_ordering::equivalent );
+static_assert( ( Wrap32 { 0 } <=> Wrap32 { 1U << 31 } ) == partial_ordering::unordered );
+static_assert( not( Wrap32 { 0 } < Wrap32 { 1U << 31 } ) and not( Wrap32 { 0 } > Wrap32 { 1U << 31 } ) );
+static_assert( Wrap32 { 0 } < Wrap32 { ( 1U << 31 ) - 1 } );
+
+// Windows that wrap around
+static_assert( Wrap32 { UINT32_MAX - 1 }.in_window( Wrap32 { UINT32_MAX - 1 }, 8 ) );
+static_assert( Wrap32 { 2 }.in_window( Wrap32 { UINT32_MAX - 1 }, 8 ) );
+static_assert( not Wrap32 { 6 }.in_window( Wrap32 { UINT32_MAX - 1 }, 8 ) );
+static_assert( not Wrap32 { UINT32_MAX - 2 }.in_window( Wrap32 { UINT32_MAX - 1 }, 8 ) );
+static_assert( not Wrap32 { 3 }.in_window( Wrap32 { 3 }, 0 ) );
+
+// A compile-time table of the seqnos of consecutive full segments, starting just before a wrap
+template<size_t... I>
+constexpr array<Wrap32, sizeof...( I )> segment_seqnos( Wrap32 isn, uint32_t segment_size, index_sequence<I...> )
+{
+	return { Wrap32::wrap( 1 + I * segment_size, isn )... };
+}
+
+constexpr Wrap32 ISN { UINT32_MAX - 2500 };
+constexpr uint32_t SEGMENT_SIZE = 1000;
+constexpr auto SEQNOS = segment_seqnos( ISN, SEGMENT_SIZE, make_index_sequence<6> {} );
+
+constexpr bool table_is_consistent()
+{
+	for ( size_t i = 0; i < SEQNOS.size(); ++i ) {
+		if ( SEQNOS[i].unwrap( ISN, i * SEGMENT_SIZE ) != 1 + i * SEGMENT_SIZE ) {
+			return false;
+		}
+		if ( i > 0 and ( SEQNOS[i] - SEQNOS[i - 1] != SEGMENT_SIZE or not( SEQNOS[i - 1] < SEQNOS[i] ) ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static_assert( SEQNOS[3] == Wrap32 { 500 } );
+static_assert( table_is_consistent() );
+
+} // namespace
+
+int main()
+{
+	try {
+		auto rd = get_random_engine();
+		uniform_int_distribution<uint32_t> dist32;
+		uniform_int_distribution<int32_t> dist_distance { INT32_MIN + 1, INT32_MAX };
+
+		// Distance and ordering agree with unwrapping both seqnos against a checkpoint near them
+		for ( size_t i = 0; i < 32768; ++i ) {
+			const Wrap32 isn { dist32( rd ) };
+			const uint64_t checkpoint = ( uint64_t { dist32( rd ) } << 16 ) + ( 1UL << 32 );
+			const int32_t distance = dist_distance( rd );
+			const Wrap32 a = Wrap32::wrap( checkpoint, isn );
+			const Wrap32 b = a + static_cast<uint32_t>( distance );
+
+			test_should_be( b - a, distance );
+			test_should_be( a - b, -distance );
+			test_should_be( a < b, distance > 0 );
+			test_should_be( a > b, distance < 0 );
+			test_should_be( a < b, a.unwrap( isn, checkpoint ) < b.unwrap( isn, checkpoint ) );
+			test_should_be( b.in_window( a, 1U << 31 ), distance >= 0 );
+		}
+	} catch ( const exception& e ) {
+		cerr << e.what() << "\n";
+		return 1;
+	}
+
+	return EXIT_SUCCESS;
+}
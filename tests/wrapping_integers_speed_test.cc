@@ -0,0 +1,131 @@
+#include "unwrap_reference.hh"
+#include "wrapping_integers.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// How unwrap is called on each batch of sequence numbers
+enum class Method : uint8_t
+{
+	Reference, // the branching unwrap(), one seqno at a time
+	Scalar,	   // the branch-free unwrap(), one seqno at a time
+	Many,	   // unwrap_many() on the whole batch
+};
+
+void unwrap_batches( const Method method,
+					 const vector<Wrap32>& seqnos,
+					 const vector<uint64_t>& checkpoints,
+					 const Wrap32 zero_point,
+					 const size_t batch_size,
+					 vector<uint64_t>& out )
+{
+	for ( size_t b = 0; b * batch_size < seqnos.size(); ++b ) {
+		const span<const Wrap32> batch = span { seqnos }.subspan( b * batch_size, batch_size );
+		const span<uint64_t> results = span { out }.subspan( b * batch_size, batch_size );
+		switch ( method ) {
+			case Method::Reference:
+				for ( size_t i = 0; i < batch.size(); ++i ) {
+					results[i] = reference_unwrap( batch[i], zero_point, checkpoints[b] );
+				}
+				break;
+			case Method::Scalar:
+				for ( size_t i = 0; i < batch.size(); ++i ) {
+					results[i] = batch[i].unwrap( zero_point, checkpoints[b] );
+				}
+				break;
+			case Method::Many:
+				Wrap32::unwrap_many( batch, zero_point, checkpoints[b], results );
+				break;
+		}
+	}
+}
+
+// Unwrap `batches` batches of `batch_size` seqnos each, either spread uniformly over the sequence space or
+// within a window of the batch's checkpoint, and compare the time each method takes
+void speed_test( fstream& debug_output, const size_t batch_size, const size_t batches, const bool near_checkpoint )
+{
+	constexpr size_t repetitions = 20;
+	default_random_engine rd { 4321 };
+	uniform_int_distribution<uint32_t> dist32;
+	uniform_int_distribution<uint64_t> dist_checkpoint { 0, uint64_t { 1 } << 48 };
+	uniform_int_distribution<uint64_t> dist_window { 0, 1 << 20 };
+
+	const Wrap32 zero_point { dist32( rd ) };
+	vector<uint64_t> checkpoints( batches );
+	vector<Wrap32> seqnos;
+	seqnos.reserve( batch_size * batches );
+	for ( auto& checkpoint : checkpoints ) {
+		checkpoint = dist_checkpoint( rd );
+		for ( size_t i = 0; i < batch_size; ++i ) {
+			const uint64_t nearby = checkpoint + dist_window( rd ) - ( 1 << 16 );
+			seqnos.push_back( near_checkpoint ? Wrap32::wrap( nearby, zero_point ) : Wrap32 { dist32( rd ) } );
+		}
+	}
+
+	vector<uint64_t> expected( seqnos.size() );
+	unwrap_batches( Method::Reference, seqnos, checkpoints, zero_point, batch_size, expected );
+
+	const string_view input = near_checkpoint ? "near-checkpoint" : "random";
+	double reference_ns = 0;
+	for ( const Method method : { Method::Reference, Method::Scalar, Method::Many } ) {
+		vector<uint64_t> out( seqnos.size() );
+		const auto start_time = steady_clock::now();
+		for ( size_t r = 0; r < repetitions; ++r ) {
+			unwrap_batches( method, seqnos, checkpoints, zero_point, batch_size, out );
+		}
+		const auto stop_time = steady_clock::now();
+
+		if ( out != expected ) {
+			throw runtime_error( "unwrap results differ from the reference implementation" );
+		}
+
+		const double ns_per_unwrap = duration_cast<duration<double, nano>>( stop_time - start_time ).count()
+									 / static_cast<double>( repetitions * seqnos.size() );
+		if ( method == Method::Reference ) {
+			reference_ns = ns_per_unwrap;
+		}
+
+		const string_view name = method == Method::Reference ? "reference"
+								 : method == Method::Scalar	 ? "branch-free"
+															 : "unwrap_many";
+		cout << "Unwrapping " << input << " seqnos in batches of " << batch_size << " with " << name << " took "
+			 << fixed << setprecision( 2 ) << ns_per_unwrap << " ns each (" << reference_ns / ns_per_unwrap
+			 << "x the reference).\n";
+		debug_output << "        Unwrap (" << input << ", batch " << setw( 3 ) << batch_size << ", " << name
+					 << "):" << string( 12 - name.size(), ' ' ) << fixed << setprecision( 2 ) << setw( 5 )
+					 << ns_per_unwrap << " ns\n";
+	}
+}
+
+void program_body()
+{
+	fstream debug_output;
+	debug_output.open( "/dev/tty" );
+
+	speed_test( debug_output, 256, 4096, false );
+	speed_test( debug_output, 256, 4096, true );
+	speed_test( debug_output, 16, 65536, false );
+	speed_test( debug_output, 16, 65536, true );
+}
+
+int main()
+{
+	try {
+		program_body();
+	} catch ( const exception& e ) {
+		cerr << "Exception: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+#include "conversions.hh"
+#include "random.hh"
+#include "test_should_be.hh"
+#include "unwrap_reference.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+void check_many( const vector<Wrap32>& seqnos, const Wrap32 zero_point, const uint64_t checkpoint )
+{
+	vector<uint64_t> out( seqnos.size() );
+	Wrap32::unwrap_many( seqnos, zero_point, checkpoint, out );
+
+	for ( size_t i = 0; i < seqnos.size(); ++i ) {
+		const uint64_t expected = reference_unwrap( seqnos[i], zero_point, checkpoint );
+		if ( out[i] != expected or seqnos[i].unwrap( zero_point, checkpoint ) != expected ) {
+			ostringstream ss;
+			ss << "unwrap_many() disagreed with the reference unwrap\n";
+			ss << "  for seqno " << seqnos[i] << " (element " << i << " of " << seqnos.size()
+			   << "), zero point " << zero_point << " and checkpoint " << checkpoint << ":\n";
+			ss << "  expected " << expected << ", but unwrap_many() gave " << out[i] << " and unwrap() gave "
+			   << seqnos[i].unwrap( zero_point, checkpoint ) << "\n";
+			throw runtime_error( ss.str() );
+		}
+	}
+}
+
+int main()
+{
+	try {
+		auto rd = get_random_engine();
+		uniform_int_distribution<uint32_t> dist32 { 0, UINT32_MAX };
+		uniform_int_distribution<uint64_t> dist64 { 0, UINT64_MAX };
+
+		// Batches of every length up to a few vectors, so the scalar tail is exercised too
+		const vector<uint64_t> checkpoints { 0,
+											 1,
+											 ( 1ULL << 31 ) - 1,
+											 1ULL << 31,
+											 ( 1ULL << 31 ) + 1,
+											 ( 1ULL << 32 ) - 1,
+											 1ULL << 32,
+											 3 * ( 1ULL << 32 ) + 17,
+											 UINT64_MAX - ( 1ULL << 31 ),
+											 UINT64_MAX };
+		for ( const uint64_t checkpoint : checkpoints ) {
+			for ( const uint32_t zero : { 0U, 19U, 1U << 31, UINT32_MAX } ) {
+				const Wrap32 zero_point { zero };
+				vector<Wrap32> seqnos;
+				for ( size_t length = 0; length < 20; ++length ) {
+					check_many( seqnos, zero_point, checkpoint );
+					// Alternate between seqnos just around the checkpoint and exactly half a wrap away
+					const uint32_t low = static_cast<uint32_t>( checkpoint ) + zero;
+					const uint32_t delta = length % 2 ? ( 1U << 31 ) + static_cast<uint32_t>( length / 4 ) - 2
+													  : static_cast<uint32_t>( length ) - 8;
+					seqnos.emplace_back( low + delta );
+				}
+			}
+		}
+
+		// Random seqnos, zero points and checkpoints
+		for ( unsigned int i = 0; i < 10000; ++i ) {
+			vector<Wrap32> seqnos;
+			for ( unsigned int j = 0; j < 37; ++j ) {
+				seqnos.emplace_back( dist32( rd ) );
+			}
+			check_many( seqnos, Wrap32 { dist32( rd ) }, dist64( rd ) >> ( i % 64 ) );
+		}
+
+		// A burst of segments near the checkpoint
+		const Wrap32 isn { dist32( rd ) };
+		const uint64_t checkpoint = ( 5ULL << 32 ) - 3000;
+		vector<Wrap32> burst;
+		for ( uint64_t k = 0; k < 16; ++k ) {
+			burst.push_back( Wrap32::wrap( checkpoint + k * 1000, isn ) );
+		}
+		vector<uint64_t> out( burst.size() );
+		Wrap32::unwrap_many( burst, isn, checkpoint, out );
+		for ( uint64_t k = 0; k < 16; ++k ) {
+			test_should_be( out[k], checkpoint + k * 1000 );
+		}
+
+		// The output must hold every result
+		bool threw = false;
+		try {
+			vector<uint64_t> short_out( 2 );
+			Wrap32::unwrap_many( burst, isn, checkpoint, short_out );
+		} catch ( const runtime_error& ) {
+			threw = true;
+		}
+		test_should_be( threw, true );
+	} catch ( const exception& e ) {
+		cerr << e.what() << "\n";
+		return 1;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -1,5 +1,7 @@
 #include "debug.hh"
 
+#include <chrono>
+#include <iomanip>
 #include <iostream>
 
 using namespace std;
@@ -29,3 +31,77 @@ void reset_debug_handler()
 {
 	debug_handler = default_debug_handler;
 }
+
+string_view to_string( TraceCategory category )
+{
+	switch ( category ) {
+		case TraceCategory::Reassembler:
+			return "Reassembler";
+		case TraceCategory::Receiver:
+			return "Receiver";
+		case TraceCategory::EventLoop:
+			return "EventLoop";
+	}
+	return "unknown";
+}
+
+TraceRing& TraceRing::this_thread()
+{
+	thread_local TraceRing ring;
+	return ring;
+}
+
+void TraceRing::enable()
+{
+	if ( not records_ ) {
+		records_ = make_unique<TraceRecord[]>( kCapacity );
+	}
+	enabled_ = true;
+}
+
+void TraceRing::record( TraceCategory category, const char* event, uint64_t arg0, uint64_t arg1 )
+{
+	if ( not enabled_ ) {
+		return;
+	}
+	const auto now = chrono::steady_clock::now().time_since_epoch();
+	const auto timestamp_ns = static_cast<uint64_t>( chrono::duration_cast<chrono::nanoseconds>( now ).count() );
+	records_[count_++ % kCapacity] = { timestamp_ns, category, event, arg0, arg1 };
+}
+
+vector<TraceRecord> TraceRing::records() const
+{
+	vector<TraceRecord> ret;
+	const uint64_t first = count_ > kCapacity ? count_ - kCapacity : 0;
+	ret.reserve( count_ - first );
+	for ( uint64_t i = first; i < count_; ++i ) {
+		ret.push_back( records_[i % kCapacity] );
+	}
+	return ret;
+}
+
+/**
+ * @brief Print the records in the ring, one per line, with times relative to the oldest.
+ */
+void TraceRing::dump( ostream& out ) const
+{
+	const vector<TraceRecord> all = records();
+	if ( count_ > all.size() ) {
+		out << "(" << count_ - all.size() << " older trace records dropped)\n";
+	}
+	for ( const auto& record : all ) {
+		out << setw( 12 ) << record.timestamp_ns - all.front().timestamp_ns << " ns  "
+			<< to_string( record.category ) << ": " << record.event << " " << record.arg0 << " " << record.arg1
+			<< "\n";
+	}
+}
+
+void trace_event( TraceCategory category, const char* event, uint64_t arg0, uint64_t arg1 )
+{
+	TraceRing& ring = TraceRing::this_thread();
+	if ( ring.enabled() ) {
+		ring.record( category, event, arg0, arg1 );
+	} else {
+		debug_str( format( "{}: {} {} {}", to_string( category ), event, arg0, arg1 ) );
+	}
+}
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <format>
+#include <iosfwd>
+#include <memory>
 #include <string_view>
+#include <vector>
 
 // The `debug` function can be called from anywhere and tries to print debugging
 // information in the most convenient place.
@@ -20,3 +25,72 @@ void debug( std::format_string<Args...> fmt [[maybe_unused]], Args&&... args [[m
 
 void set_debug_handler( void ( * )( void*, std::string_view ), void* arg );
 void reset_debug_handler();
+
+// Trace points are for hot paths: each belongs to a category, and a category's trace points compile
+// to nothing unless its bit is set in MINNOW_TRACE (e.g. `cmake -DMINNOW_TRACE=0x3` for the Reassembler
+// and TCPReceiver). An enabled trace point records an event name and two numbers, without formatting,
+// in this thread's TraceRing if it is enabled, and otherwise passes them to debug_str().
+enum class TraceCategory : uint8_t
+{
+	Reassembler,
+	Receiver,
+	EventLoop,
+};
+
+#ifndef MINNOW_TRACE
+#define MINNOW_TRACE 0 // NOLINT(*-macro-usage)
+#endif
+
+constexpr bool trace_enabled( TraceCategory category )
+{
+	return ( static_cast<uint64_t>( MINNOW_TRACE ) >> static_cast<unsigned>( category ) ) & 1U;
+}
+
+std::string_view to_string( TraceCategory category );
+
+struct TraceRecord
+{
+	uint64_t timestamp_ns; // steady_clock time of the trace point
+	TraceCategory category;
+	const char* event; // A string literal naming the trace point
+	uint64_t arg0;
+	uint64_t arg1;
+};
+
+// The most recent trace records of one thread. Only that thread writes to its ring, so recording is
+// a store and an increment, with no locks or atomics; read it from the same thread (e.g. after a run).
+class TraceRing
+{
+  public:
+	static constexpr size_t kCapacity = 4096;
+
+	static TraceRing& this_thread();
+
+	void enable(); // Start recording (allocating the ring the first time)
+	void disable() { enabled_ = false; }
+	bool enabled() const { return enabled_; }
+
+	// Add a record (ignored unless enabled)
+	void record( TraceCategory category, const char* event, uint64_t arg0, uint64_t arg1 );
+	std::vector<TraceRecord> records() const; // The records still in the ring, oldest first
+	uint64_t total_recorded() const { return count_; }
+	void dump( std::ostream& out ) const; // Print the records, oldest first
+	void clear() { count_ = 0; }
+
+  private:
+	std::unique_ptr<TraceRecord[]> records_ {};
+	uint64_t count_ {};
+	bool enabled_ {};
+};
+
+void trace_event( TraceCategory category, const char* event, uint64_t arg0, uint64_t arg1 );
+
+template<TraceCategory category>
+void trace( const char* event [[maybe_unused]],
+			uint64_t arg0 [[maybe_unused]] = 0,
+			uint64_t arg1 [[maybe_unused]] = 0 )
+{
+	if constexpr ( trace_enabled( category ) ) {
+		trace_event( category, event, arg0, arg1 );
+	}
+}
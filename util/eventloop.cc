@@ -1,12 +1,48 @@
 #include "eventloop.hh"
+#include "debug.hh"
 #include "exception.hh"
 
+#include <array>
+#include <chrono>
+#include <climits>
 #include <cstring>
 #include <iostream>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 
 using namespace std;
 
+namespace {
+uint32_t epoll_events_for( const Direction direction )
+{
+	return direction == Direction::In ? EPOLLIN : EPOLLOUT;
+}
+
+uint64_t steady_ms()
+{
+	const auto now = chrono::steady_clock::now().time_since_epoch();
+	return static_cast<uint64_t>( chrono::duration_cast<chrono::milliseconds>( now ).count() );
+}
+} // namespace
+
+EventLoop::EventLoop( const Backend backend, const Dispatch dispatch )
+  : _rules( make_shared<Rules>() )
+  , _backend( backend )
+  , _dispatch( dispatch )
+  , _timers( make_shared<TimerWheel>( steady_ms() ) )
+{
+	_rule_categories.reserve( 64 );
+
+	if ( _backend == Backend::Epoll ) {
+		const int epoll_fd = ::epoll_create1( EPOLL_CLOEXEC );
+		if ( epoll_fd < 0 ) {
+			_backend = Backend::Poll;
+		} else {
+			_epoll.emplace( epoll_fd );
+		}
+	}
+}
+
 unsigned int EventLoop::FDRule::service_count() const
 {
 	return direction == Direction::In ? fd.read_count() : fd.write_count();
@@ -50,10 +86,25 @@ EventLoop::RuleHandle EventLoop::add_rule( size_t category_id,
 		throw out_of_range( "bad category_id" );
 	}
 
-	_fd_rules.emplace_back( make_shared<FDRule>(
-	  BasicRule { category_id, interest, callback }, fd.duplicate(), direction, cancel, error ) );
+	const SlotKey key = _rules->fd.emplace(
+	  BasicRule { category_id, interest, callback }, fd.duplicate(), direction, cancel, error );
+
+	// Registered with epoll at the next wait, even if not yet interested (errors are still reported)
+	if ( _backend == Backend::Epoll ) {
+		const auto fd_num = static_cast<size_t>( fd.fd_num() );
+		if ( fd_num >= _registrations.size() ) {
+			_registrations.resize( fd_num + 1 );
+		}
+
+		uint32_t* link = &_registrations[fd_num].first_rule;
+		while ( *link != NO_RULE ) {
+			link = &_rules->fd[*link].next_on_fd;
+		}
+		*link = key.slot;
+		_changed_fds.push_back( fd.fd_num() );
+	}
 
-	return RuleHandle { _fd_rules.back() };
+	return { _rules, key, true };
 }
 
 EventLoop::RuleHandle EventLoop::add_rule( const size_t category_id,
@@ -64,34 +115,271 @@ EventLoop::RuleHandle EventLoop::add_rule( const size_t category_id,
 		throw out_of_range( "bad category_id" );
 	}
 
-	_non_fd_rules.emplace_back( make_shared<BasicRule>( category_id, interest, callback ) );
-
-	return RuleHandle { _non_fd_rules.back() };
+	return { _rules, _rules->non_fd.emplace( category_id, interest, callback ), false };
 }
 
 void EventLoop::RuleHandle::cancel()
 {
-	const shared_ptr<BasicRule> rule_shared_ptr = rule_weak_ptr_.lock();
-	if ( rule_shared_ptr ) {
-		rule_shared_ptr->cancel_requested = true;
+	const shared_ptr<Rules> rules = rules_weak_ptr_.lock();
+	if ( not rules ) {
+		return;
+	}
+
+	BasicRule* const rule = fd_rule_ ? rules->fd.find( key_ ) : rules->non_fd.find( key_ );
+	if ( rule ) {
+		rule->cancel_requested = true;
+	}
+}
+
+/**
+ * @brief Arm a timer. The wheel's time only moves when timers are fired, so the delay is counted from now, and
+ * rounded up to the next millisecond so that the timer never fires early. The sum saturates, so a delay of
+ * UINT64_MAX ("never") lands at the wheel's maximum delay rather than wrapping around to now.
+ */
+EventLoop::TimerHandle EventLoop::add_timer( const size_t category_id,
+											 const uint64_t delay_ms,
+											 const CallbackT& callback )
+{
+	if ( category_id >= _rule_categories.size() ) {
+		throw out_of_range( "bad category_id" );
+	}
+
+	trace<TraceCategory::EventLoop>( "add timer", category_id, delay_ms );
+	const uint64_t lag = steady_ms() - _timers->now();
+	const uint64_t delay = delay_ms >= UINT64_MAX - lag - 1 ? UINT64_MAX : delay_ms + lag + 1;
+	return { _timers, _timers->add( delay, callback ) };
+}
+
+void EventLoop::TimerHandle::cancel()
+{
+	const shared_ptr<TimerWheel> wheel = wheel_weak_ptr_.lock();
+	if ( wheel ) {
+		wheel->cancel( id_ );
+	}
+}
+
+/**
+ * @brief Remove an fd rule, freeing its slot, and stop watching its fd once no rule is left on it.
+ */
+void EventLoop::erase_fd_rule( const uint32_t slot )
+{
+	const FDRule& rule = _rules->fd[slot];
+	if ( _backend == Backend::Epoll ) {
+		const FileDescriptor& fd = rule.fd;
+		Registration& reg = _registrations.at( fd.fd_num() );
+		uint32_t* link = &reg.first_rule;
+		while ( *link != slot ) {
+			link = &_rules->fd[*link].next_on_fd;
+		}
+		*link = rule.next_on_fd;
+
+		if ( reg.first_rule != NO_RULE ) {
+			if ( fd.closed() ) {
+				reg.added = false; // it left the epoll set, and its number may already belong to a new fd
+			}
+			_changed_fds.push_back( fd.fd_num() );
+		} else {
+			// a closed fd has already left the epoll set
+			if ( reg.added and not reg.always_ready and not fd.closed() ) {
+				++_statistics.registrations;
+				const int ret = ::epoll_ctl( _epoll->fd_num(), EPOLL_CTL_DEL, fd.fd_num(), nullptr );
+				if ( ret < 0 and errno != ENOENT and errno != EBADF ) {
+					throw unix_error( "epoll_ctl" );
+				}
+			}
+			std::erase( _always_ready_fds, fd.fd_num() );
+			reg = {};
+		}
+	}
+
+	_rules->fd.erase_slot( slot );
+}
+
+/**
+ * @brief Bring the epoll set up to date with the fds whose rules were added, removed, or changed interest.
+ *
+ * Each fd is registered once, for the union of the directions its interested rules want. An fd that epoll
+ * refuses (such as a regular file) is kept aside as always ready, which is how poll(2) treats it.
+ */
+void EventLoop::update_registrations()
+{
+	for ( const int fd_num : _changed_fds ) {
+		Registration& reg = _registrations.at( fd_num );
+		if ( reg.first_rule == NO_RULE ) {
+			continue;
+		}
+
+		uint32_t events = 0;
+		bool open_rule = false;
+		for ( uint32_t slot = reg.first_rule; slot != NO_RULE; slot = _rules->fd[slot].next_on_fd ) {
+			const FDRule& rule = _rules->fd[slot];
+			if ( rule.fd.closed() ) {
+				// closed by a callback (the rule is cancelled at the next wait), so it has left the epoll set,
+				// and its number may already belong to a new fd
+				reg.added = false;
+				continue;
+			}
+			open_rule = true;
+			if ( rule.armed ) {
+				events |= epoll_events_for( rule.direction );
+			}
+		}
+		if ( not open_rule ) {
+			continue;
+		}
+
+		if ( reg.added and events == reg.events ) {
+			continue;
+		}
+		reg.events = events;
+		if ( reg.always_ready ) {
+			continue;
+		}
+
+		register_fd( fd_num, reg );
+	}
+
+	_changed_fds.clear();
+}
+
+/**
+ * @brief Add an fd number to the epoll set, or change the events it is registered for, to match `reg.events`.
+ *
+ * A rule's fd may be closed by a callback while another rule is still on it. The closed fd has left the epoll
+ * set (so EPOLL_CTL_MOD would fail with EBADF), and its number may already belong to a new fd, so the registration
+ * is marked as not added and the number is added afresh. Either call can still meet the other's case (the number
+ * is still registered, or was closed and reused behind the loop's back), so each falls back to the other.
+ */
+void EventLoop::register_fd( const int fd_num, Registration& reg )
+{
+	epoll_event event { .events = reg.events, .data = { .fd = fd_num } };
+	++_statistics.registrations;
+	if ( not reg.added ) {
+		reg.added = true;
+		if ( ::epoll_ctl( _epoll->fd_num(), EPOLL_CTL_ADD, fd_num, &event ) < 0 ) {
+			if ( errno == EEXIST ) {
+				++_statistics.registrations;
+				CheckSystemCall( "epoll_ctl", ::epoll_ctl( _epoll->fd_num(), EPOLL_CTL_MOD, fd_num, &event ) );
+			} else if ( errno != EPERM ) {
+				throw unix_error( "epoll_ctl" );
+			} else {
+				reg.always_ready = true;
+				_always_ready_fds.push_back( fd_num );
+			}
+		}
+	} else if ( ::epoll_ctl( _epoll->fd_num(), EPOLL_CTL_MOD, fd_num, &event ) < 0 ) {
+		if ( errno != ENOENT ) {
+			throw unix_error( "epoll_ctl" );
+		}
+		++_statistics.registrations;
+		CheckSystemCall( "epoll_ctl", ::epoll_ctl( _epoll->fd_num(), EPOLL_CTL_ADD, fd_num, &event ) );
 	}
 }
 
 // NOLINTBEGIN(*-cognitive-complexity)
 // NOLINTBEGIN(*-signed-bitwise)
-EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
+/**
+ * @brief Act on the events reported for a rule's fd, the same way for either backend.
+ *
+ * @param rule The rule
+ * @param error Whether the fd reported an error
+ * @param hangup Whether the fd reported a hangup
+ * @param asked Whether the rule asked for its direction (it was interested)
+ * @param ready Whether the fd is ready in the direction the rule asked for
+ *
+ * With Dispatch::Batch, earlier callbacks from the same poll result may have closed the fd or changed the rule's
+ * interest, so those are checked again, and a rule that busy-waits is cancelled instead of stopping the loop.
+ */
+EventLoop::Outcome EventLoop::serve( FDRule& rule, bool error, bool hangup, bool asked, bool ready )
 {
-	// first, handle the non-file-descriptor-related rules
-	{
-		for ( auto it = _non_fd_rules.begin(); it != _non_fd_rules.end(); ) {
-			auto& this_rule = **it;
-			bool rule_fired = false;
+	if ( _dispatch == Dispatch::Batch
+		 and ( rule.fd.closed() or ( rule.direction == Direction::In and rule.fd.eof() ) ) ) {
+		return Outcome::Idle; // cancelled at the next wait
+	}
 
-			if ( this_rule.cancel_requested ) {
-				it = _non_fd_rules.erase( it );
-				continue;
+	if ( error ) {
+		/* see if fd is a socket */
+		int socket_error = 0;
+		socklen_t optlen = sizeof( socket_error );
+		const int ret = getsockopt( rule.fd.fd_num(), SOL_SOCKET, SO_ERROR, &socket_error, &optlen );
+		if ( ret == -1 and errno == ENOTSOCK ) {
+			cerr << "error on polled file descriptor for rule \"" << _rule_categories.at( rule.category_id ).name
+				 << "\"\n";
+		} else if ( ret == -1 ) {
+			throw unix_error( "getsockopt" );
+		} else if ( optlen != sizeof( socket_error ) ) {
+			throw runtime_error( "unexpected length from getsockopt: " + to_string( optlen ) );
+		} else if ( socket_error ) {
+			cerr << "error on polled socket for rule \"" << _rule_categories.at( rule.category_id ).name
+				 << "\": " << strerror( socket_error ) << "\n";
+		}
+
+		rule.error();
+		rule.cancel();
+		return Outcome::Defunct;
+	}
+
+	if ( hangup && ( ( asked && !ready ) or ( rule.direction == Direction::Out ) ) ) {
+		// if we asked for the status, and the _only_ condition was a hangup, this FD is defunct:
+		//   - if it was POLLIN and nothing is readable, no more will ever be readable
+		//   - if it was POLLOUT, it will not be writable again
+		// additionally, consider FD defunct if rule will only query for Direction::Out
+		rule.cancel();
+		return Outcome::Defunct;
+	}
+
+	if ( ready and ( _dispatch == Dispatch::One or rule.interest() ) ) {
+		// we only want to call callback if revents includes the event we asked for
+		const auto count_before = rule.service_count();
+		trace<TraceCategory::EventLoop>( "fd rule", rule.category_id, rule.fd.fd_num() );
+		++_statistics.callbacks;
+		rule.callback();
+
+		if ( count_before == rule.service_count() and ( not rule.fd.closed() ) and rule.interest() ) {
+			const string message = "EventLoop: busy wait detected: rule \""
+								   + _rule_categories.at( rule.category_id ).name
+								   + "\" did not read/write fd and is still interested";
+			if ( _dispatch == Dispatch::One ) {
+				throw runtime_error( message );
 			}
 
+			cerr << message << "; cancelling it\n";
+			rule.error();
+			rule.cancel();
+			return Outcome::Defunct;
+		}
+
+		return Outcome::Served;
+	}
+
+	return Outcome::Idle;
+}
+
+/**
+ * @brief Serve the non-fd rules that are interested: the first one (Dispatch::One), or each of them for a bounded
+ * turn (Dispatch::Batch), cancelling any that is still interested after 128 calls in a row.
+ *
+ * @return Whether any rule's callback was called
+ */
+bool EventLoop::serve_non_fd_rules()
+{
+	bool any_fired = false;
+	SlotMap<BasicRule>& rules = _rules->non_fd;
+
+	for ( uint32_t slot = 0; slot < rules.slot_count(); ++slot ) {
+		BasicRule* const rule = rules.get( slot );
+		if ( rule == nullptr ) {
+			continue;
+		}
+		auto& this_rule = *rule;
+
+		if ( this_rule.cancel_requested ) {
+			rules.erase_slot( slot );
+			continue;
+		}
+
+		if ( _dispatch == Dispatch::One ) {
+			bool rule_fired = false;
 			uint8_t iterations = 0;
 			while ( this_rule.interest() ) {
 				if ( iterations++ >= 128 ) {
@@ -101,127 +389,261 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
 				}
 
 				rule_fired = true;
+				++_statistics.callbacks;
 				this_rule.callback();
 			}
 
 			if ( rule_fired ) {
-				return Result::Success; /* only serve one rule on each iteration */
+				trace<TraceCategory::EventLoop>( "non-fd rule", this_rule.category_id, iterations );
+				return true; /* only serve one rule on each iteration */
 			}
 
-			++it;
+			continue;
+		}
+
+		unsigned calls = 0;
+		bool interested = this_rule.interest();
+		while ( interested and calls < BATCH_RULE_BUDGET ) {
+			++calls;
+			++_statistics.callbacks;
+			this_rule.callback();
+			interested = this_rule.interest();
 		}
+
+		if ( calls > 0 ) {
+			trace<TraceCategory::EventLoop>( "non-fd rule", this_rule.category_id, calls );
+			any_fired = true;
+		}
+
+		this_rule.busy_calls = interested ? this_rule.busy_calls + calls : 0;
+		if ( this_rule.busy_calls >= 128 ) {
+			cerr << "EventLoop: busy wait detected: rule \"" << _rule_categories.at( this_rule.category_id ).name
+				 << "\" is still interested after " << this_rule.busy_calls << " iterations; cancelling it\n";
+			rules.erase_slot( slot );
+		}
+	}
+
+	return any_fired;
+}
+
+/**
+ * @brief Fire every timer that is due.
+ *
+ * @return Whether any timer fired
+ */
+bool EventLoop::fire_timers()
+{
+	const size_t fired = _timers->advance( steady_ms() );
+	if ( fired > 0 ) {
+		trace<TraceCategory::EventLoop>( "timers", fired, _timers->now() );
+		_statistics.timers += fired;
+	}
+	return fired > 0;
+}
+
+EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
+{
+	// first, the timers that are due, then the non-file-descriptor-related rules
+	bool fired = fire_timers();
+	if ( fired and _dispatch == Dispatch::One ) {
+		return Result::Success;
+	}
+
+	fired |= serve_non_fd_rules();
+	if ( fired and _dispatch == Dispatch::One ) {
+		return Result::Success;
 	}
 
 	// now the file-descriptor-related rules. poll any "interested" file descriptors
-	vector<pollfd> pollfds {};
-	pollfds.reserve( _fd_rules.size() );
+	_pollfds.clear();
+	_poll_rules.clear();
 	bool something_to_poll = false;
 
-	// set up the pollfd for each rule
-	for ( auto it = _fd_rules.begin();
-		  it != _fd_rules.end(); ) { // NOTE: it gets erased or incremented in loop body
-		auto& this_rule = **it;
+	// set up the pollfd (or the epoll interest) for each rule
+	SlotMap<FDRule>& fd_rules = _rules->fd;
+	for ( uint32_t slot = 0; slot < fd_rules.slot_count(); ++slot ) {
+		FDRule* const rule = fd_rules.get( slot );
+		if ( rule == nullptr ) {
+			continue;
+		}
+		auto& this_rule = *rule;
 
 		if ( this_rule.cancel_requested ) {
 			//      this_rule.cancel();
 			//      if rule is cancelled externally, no need to call the cancellation callback
 			//      this makes it easier to cancel rules and delete captured objects right away
-			it = _fd_rules.erase( it );
+			erase_fd_rule( slot );
 			continue;
 		}
 
 		if ( this_rule.direction == Direction::In && this_rule.fd.eof() ) {
 			// no more reading on this rule, it's reached eof
 			this_rule.cancel();
-			it = _fd_rules.erase( it );
+			erase_fd_rule( slot );
 			continue;
 		}
 
 		if ( this_rule.fd.closed() ) {
 			this_rule.cancel();
-			it = _fd_rules.erase( it );
+			erase_fd_rule( slot );
 			continue;
 		}
 
-		if ( this_rule.interest() ) {
-			pollfds.push_back( { this_rule.fd.fd_num(),
-								 static_cast<int16_t>( this_rule.direction == Direction::In ? POLLIN : POLLOUT ),
-								 0 } );
-			something_to_poll = true;
-		} else {
-			pollfds.push_back( { this_rule.fd.fd_num(), 0, 0 } ); // placeholder --- we still want errors
+		const bool interested = this_rule.interest();
+		something_to_poll |= interested;
+
+		if ( _backend == Backend::Poll ) {
+			if ( interested ) {
+				const auto events = static_cast<int16_t>( this_rule.direction == Direction::In ? POLLIN : POLLOUT );
+				_pollfds.push_back( { this_rule.fd.fd_num(), events, 0 } );
+			} else {
+				_pollfds.push_back( { this_rule.fd.fd_num(), 0, 0 } ); // placeholder --- we still want errors
+			}
+			_poll_rules.push_back( slot );
+		} else if ( interested != this_rule.armed ) {
+			// epoll keeps the fd registered; only a change of interest needs a system call
+			this_rule.armed = interested;
+			_changed_fds.push_back( this_rule.fd.fd_num() );
 		}
-		++it;
 	}
 
-	// quit if there is nothing left to poll
-	if ( not something_to_poll ) {
-		return Result::Exit;
+	// quit if there is nothing left to poll or to wait for
+	if ( not something_to_poll and _timers->empty() ) {
+		return fired ? Result::Success : Result::Exit;
+	}
+
+	return wait_fds( timeout_ms, fired );
+}
+
+/**
+ * @brief Wait for the fds, but no later than the next timer wakeup, then fire the timers that are due.
+ *
+ * @param timeout_ms The caller's timeout (negative for none)
+ * @param fired Whether callbacks have run already, in which case only the fds that are ready are collected
+ *
+ * A wakeup may only move timers down the wheel without firing any, and then the wait resumes for what is left
+ * of the caller's timeout.
+ */
+EventLoop::Result EventLoop::wait_fds( const int timeout_ms, const bool fired )
+{
+	const uint64_t start = steady_ms();
+
+	while ( true ) {
+		const uint64_t now = steady_ms();
+		int timeout = timeout_ms;
+		if ( fired ) {
+			timeout = 0;
+		} else if ( timeout_ms >= 0 ) {
+			timeout = static_cast<int>( timeout_ms - min( now - start, static_cast<uint64_t>( timeout_ms ) ) );
+		}
+
+		bool timer_bound = false;
+		const auto wakeup = _timers->next_wakeup();
+		if ( not fired and wakeup.has_value() ) {
+			const uint64_t until = min( *wakeup - min( *wakeup, now ), static_cast<uint64_t>( INT_MAX ) );
+			if ( timeout < 0 or until < static_cast<uint64_t>( timeout ) ) {
+				timeout = static_cast<int>( until );
+				timer_bound = true;
+			}
+		}
+
+		const Result result = _backend == Backend::Poll ? wait_poll( timeout ) : wait_epoll( timeout );
+		const bool timers_fired = fire_timers();
+		if ( fired or timers_fired or result != Result::Timeout or not timer_bound ) {
+			return fired or timers_fired ? Result::Success : result;
+		}
 	}
+}
 
+EventLoop::Result EventLoop::wait_poll( const int timeout_ms )
+{
 	// call poll -- wait until one of the fds satisfies one of the rules (writeable/readable)
-	if ( 0 == CheckSystemCall( "poll", ::poll( pollfds.data(), pollfds.size(), timeout_ms ) ) ) {
+	trace<TraceCategory::EventLoop>( "poll", _pollfds.size(), static_cast<uint64_t>( timeout_ms ) );
+	++_statistics.waits;
+	if ( 0 == CheckSystemCall( "poll", ::poll( _pollfds.data(), _pollfds.size(), timeout_ms ) ) ) {
 		return Result::Timeout;
 	}
 
 	// go through the poll results
-	for ( auto [it, idx] = make_pair( _fd_rules.begin(), static_cast<size_t>( 0 ) ); it != _fd_rules.end();
-		  ++idx ) {
-		const auto& this_pollfd = pollfds.at( idx );
-		auto& this_rule = **it;
-
-		const auto poll_error = static_cast<bool>( this_pollfd.revents & ( POLLERR | POLLNVAL ) );
-		if ( poll_error ) {
-			/* see if fd is a socket */
-			int socket_error = 0;
-			socklen_t optlen = sizeof( socket_error );
-			const int ret = getsockopt( this_rule.fd.fd_num(), SOL_SOCKET, SO_ERROR, &socket_error, &optlen );
-			if ( ret == -1 and errno == ENOTSOCK ) {
-				cerr << "error on polled file descriptor for rule \""
-					 << _rule_categories.at( this_rule.category_id ).name << "\"\n";
-			} else if ( ret == -1 ) {
-				throw unix_error( "getsockopt" );
-			} else if ( optlen != sizeof( socket_error ) ) {
-				throw runtime_error( "unexpected length from getsockopt: " + to_string( optlen ) );
-			} else if ( socket_error ) {
-				cerr << "error on polled socket for rule \"" << _rule_categories.at( this_rule.category_id ).name
-					 << "\": " << strerror( socket_error ) << "\n";
-			}
-
-			this_rule.error();
-			this_rule.cancel();
-			it = _fd_rules.erase( it );
+	// (with Dispatch::Batch, callbacks may add rules, which have no pollfd yet)
+	for ( size_t idx = 0; idx < _pollfds.size(); ++idx ) {
+		const auto& this_pollfd = _pollfds[idx];
+		const uint32_t slot = _poll_rules[idx];
+		FDRule& rule = _rules->fd[slot];
+		if ( rule.cancel_requested ) {
 			continue;
 		}
 
-		const auto poll_ready = static_cast<bool>( this_pollfd.revents & this_pollfd.events );
-		const auto poll_hup = static_cast<bool>( this_pollfd.revents & POLLHUP );
-		if ( poll_hup && ( ( this_pollfd.events && !poll_ready ) or ( this_rule.direction == Direction::Out ) ) ) {
-			// if we asked for the status, and the _only_ condition was a hangup, this FD is defunct:
-			//   - if it was POLLIN and nothing is readable, no more will ever be readable
-			//   - if it was POLLOUT, it will not be writable again
-			// additionally, consider FD defunct if rule will only query for Direction::Out
-			this_rule.cancel();
-			it = _fd_rules.erase( it );
+		const Outcome outcome = serve( rule,
+									   static_cast<bool>( this_pollfd.revents & ( POLLERR | POLLNVAL ) ),
+									   static_cast<bool>( this_pollfd.revents & POLLHUP ),
+									   static_cast<bool>( this_pollfd.events ),
+									   static_cast<bool>( this_pollfd.revents & this_pollfd.events ) );
+		if ( outcome == Outcome::Defunct ) {
+			erase_fd_rule( slot );
 			continue;
 		}
 
-		if ( poll_ready ) {
-			// we only want to call callback if revents includes the event we asked for
-			const auto count_before = this_rule.service_count();
-			this_rule.callback();
+		if ( outcome == Outcome::Served and _dispatch == Dispatch::One ) {
+			return Result::Success; /* only serve one rule on each iteration */
+		}
+	}
 
-			if ( count_before == this_rule.service_count() and ( not this_rule.fd.closed() )
-				 and this_rule.interest() ) {
-				throw runtime_error( "EventLoop: busy wait detected: rule \""
-									 + _rule_categories.at( this_rule.category_id ).name
-									 + "\" did not read/write fd and is still interested" );
-			}
+	return Result::Success;
+}
 
-			return Result::Success; /* only serve one rule on each iteration */
+EventLoop::Result EventLoop::wait_epoll( const int timeout_ms )
+{
+	update_registrations();
+
+	// fds that epoll refused are reported ready without waiting, as poll(2) would report them
+	array<epoll_event, 256> events {};
+	size_t count = 0;
+	for ( const int fd_num : _always_ready_fds ) {
+		const uint32_t ready = _registrations[fd_num].events;
+		if ( ready and count < events.size() ) {
+			events.at( count++ ) = { .events = ready, .data = { .fd = fd_num } };
+		}
+	}
+
+	const int timeout = count > 0 ? 0 : timeout_ms;
+	trace<TraceCategory::EventLoop>( "epoll", _registrations.size(), static_cast<uint64_t>( timeout ) );
+	++_statistics.waits;
+	count += CheckSystemCall(
+	  "epoll_wait",
+	  ::epoll_wait( _epoll->fd_num(), events.data() + count, static_cast<int>( events.size() - count ), timeout ) );
+	if ( count == 0 ) {
+		return Result::Timeout;
+	}
+
+	// go through the ready fds, and each rule on them
+	for ( size_t i = 0; i < count; ++i ) {
+		const auto fd_num = static_cast<size_t>( events.at( i ).data.fd );
+		if ( fd_num >= _registrations.size() ) {
+			continue;
 		}
 
-		++it; // if we got here, it means we didn't call _fd_rules.erase()
+		// callbacks may add rules to this fd (but rules are only removed between waits)
+		const uint32_t revents = events.at( i ).events;
+		for ( uint32_t slot = _registrations[fd_num].first_rule; slot != NO_RULE;
+			  slot = _rules->fd[slot].next_on_fd ) {
+			FDRule& rule = _rules->fd[slot];
+			if ( rule.cancel_requested ) {
+				continue;
+			}
+
+			const uint32_t asked = rule.armed ? epoll_events_for( rule.direction ) : 0;
+			const Outcome outcome = serve( rule,
+										   static_cast<bool>( revents & EPOLLERR ),
+										   static_cast<bool>( revents & EPOLLHUP ),
+										   static_cast<bool>( asked ),
+										   static_cast<bool>( revents & asked ) );
+			if ( outcome == Outcome::Defunct ) {
+				rule.cancel_requested = true; // erased at the next wait
+			} else if ( outcome == Outcome::Served and _dispatch == Dispatch::One ) {
+				return Result::Success; /* only serve one rule on each iteration */
+			}
+		}
 	}
 
 	return Result::Success;
@@ -1,11 +1,14 @@
 #pragma once
 
-#include <functional>
-#include <list>
 #include <memory>
+#include <optional>
 #include <poll.h>
+#include <vector>
 
 #include "file_descriptor.hh"
+#include "inplace_function.hh"
+#include "slot_map.hh"
+#include "timer_wheel.hh"
 
 //! Waits for events on file descriptors and executes corresponding callbacks.
 class EventLoop
@@ -18,21 +21,54 @@ class EventLoop
 		Out // Callback will be triggered when Rule::fd is writable.
 	};
 
+	//! How the EventLoop waits for its file descriptors.
+	enum class Backend : uint8_t
+	{
+		Poll, //!< Build a pollfd for every rule and call poll(2) on each wakeup (the default).
+		//! Keep fds registered with epoll(7), changing them only when a rule's interest changes. The kernel then
+		//! returns just the ready fds, but each wakeup still calls every fd rule's interest() to see whether it
+		//! changed (rules do not report changes), so a wakeup remains O(rules), only with a much smaller constant.
+		Epoll
+	};
+
+	//! How many rules each call to EventLoop::wait_next_event serves.
+	enum class Dispatch : uint8_t
+	{
+		One,  //!< Serve the first rule that is ready, then return.
+		Batch //!< Serve every rule that is ready, each a bounded number of times.
+	};
+
+	//! Most times a non-fd rule is called in one Dispatch::Batch wakeup before the other rules get their turn.
+	//! (An fd rule is called at most once per wakeup, since the poll result is stale after its callback.)
+	static constexpr unsigned BATCH_RULE_BUDGET = 16;
+
+	//! Counts of the work done by an EventLoop
+	struct Statistics
+	{
+		uint64_t waits {};		   //!< calls to poll(2) or epoll_wait(2)
+		uint64_t registrations {}; //!< calls to epoll_ctl(2)
+		uint64_t callbacks {};	   //!< rule callbacks served
+		uint64_t timers {};		   //!< timer callbacks fired
+	};
+
   private:
-	using CallbackT = std::function<void( void )>;
-	using InterestT = std::function<bool( void )>;
+	using CallbackT = InplaceFunction<void( void )>;
+	using InterestT = InplaceFunction<bool( void )>;
 
 	struct RuleCategory
 	{
 		std::string name;
 	};
 
+	static constexpr uint32_t NO_RULE = UINT32_MAX;
+
 	struct BasicRule
 	{
 		size_t category_id;
+		bool cancel_requested {};
+		unsigned busy_calls {}; //!< Calls in a row (across Dispatch::Batch wakeups) with interest remaining
 		InterestT interest;
 		CallbackT callback;
-		bool cancel_requested {};
 
 		BasicRule( size_t s_category_id, InterestT s_interest, CallbackT s_callback );
 	};
@@ -43,6 +79,10 @@ class EventLoop
 		Direction direction; //!< Direction::In for reading from fd, Direction::Out for writing to fd.
 		CallbackT cancel;	 //!< A callback that is called when the rule is cancelled (e.g. on EOF or hangup)
 		CallbackT error;	 //!< A callback that is called when the fd has an error before cancellation
+		bool armed {};		 //!< Whether the rule's direction is registered with epoll (interest at last check)
+
+		//! The slot of the next rule on the same fd (see Registration::first_rule)
+		uint32_t next_on_fd { NO_RULE };
 
 		FDRule( BasicRule&& base,
 				FileDescriptor&& s_fd,
@@ -55,12 +95,47 @@ class EventLoop
 		unsigned int service_count() const;
 	};
 
+	//! The epoll registration of one fd number, shared by every rule on that fd
+	struct Registration
+	{
+		//! The slot of the first rule on this fd; the rules are linked through FDRule::next_on_fd, in the order
+		//! they were added
+		uint32_t first_rule { NO_RULE };
+		uint32_t events {};	  //!< Events currently registered with epoll
+		bool added {};		  //!< Whether epoll_ctl(EPOLL_CTL_ADD) has been attempted
+		bool always_ready {}; //!< epoll refused the fd (e.g. a regular file), which poll treats as ready
+	};
+
+	//! The rules, shared with the RuleHandles (which only find them while the loop exists)
+	struct Rules
+	{
+		SlotMap<FDRule> fd {};
+		SlotMap<BasicRule> non_fd {};
+	};
+
 	std::vector<RuleCategory> _rule_categories {};
-	std::list<std::shared_ptr<FDRule>> _fd_rules {};
-	std::list<std::shared_ptr<BasicRule>> _non_fd_rules {};
+	std::shared_ptr<Rules> _rules;
+	std::vector<pollfd> _pollfds {};	  //!< With Backend::Poll, the pollfd for each rule in _poll_rules
+	std::vector<uint32_t> _poll_rules {}; //!< The slot of each rule polled
+
+	Backend _backend;
+	Dispatch _dispatch;
+	Statistics _statistics {};
+	std::optional<FileDescriptor> _epoll {};
+	std::vector<Registration> _registrations {}; //!< Indexed by fd number
+	std::vector<int> _changed_fds {};			 //!< fds whose rules' interest changed since they were registered
+	std::vector<int> _always_ready_fds {};
+	std::shared_ptr<TimerWheel> _timers;
 
   public:
-	EventLoop() { _rule_categories.reserve( 64 ); }
+	//! Use `backend` to wait for events; if epoll is unavailable, the loop falls back to poll.
+	explicit EventLoop( Backend backend = Backend::Poll, Dispatch dispatch = Dispatch::One );
+
+	//! The backend in use
+	Backend backend() const { return _backend; }
+
+	//! The work done so far
+	const Statistics& statistics() const { return _statistics; }
 
 	//! Returned by each call to EventLoop::wait_next_event.
 	enum class Result : uint8_t
@@ -75,13 +150,16 @@ class EventLoop
 
 	class RuleHandle
 	{
-		std::weak_ptr<BasicRule> rule_weak_ptr_;
+		std::weak_ptr<Rules> rules_weak_ptr_;
+		SlotKey key_;
+		bool fd_rule_;
 
 	  public:
-		template<class RuleType>
-		explicit RuleHandle( const std::shared_ptr<RuleType> x ) : rule_weak_ptr_( x )
+		RuleHandle( const std::shared_ptr<Rules>& rules, SlotKey key, bool fd_rule )
+		  : rules_weak_ptr_( rules ), key_( key ), fd_rule_( fd_rule )
 		{}
 
+		//! Stop the rule (its slot is freed at the next wait, since the rule may be running)
 		void cancel();
 	};
 
@@ -97,7 +175,32 @@ class EventLoop
 	RuleHandle
 	add_rule( size_t category_id, const CallbackT& callback, const InterestT& interest = [] { return true; } );
 
-	//! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
+	class TimerHandle
+	{
+		std::weak_ptr<TimerWheel> wheel_weak_ptr_;
+		TimerWheel::TimerId id_;
+
+	  public:
+		TimerHandle( const std::shared_ptr<TimerWheel>& wheel, TimerWheel::TimerId id )
+		  : wheel_weak_ptr_( wheel ), id_( id )
+		{}
+
+		//! Stop the timer, if it has not fired yet (in O(1))
+		void cancel();
+	};
+
+	//! Call `callback` once, `delay_ms` from now. Pending timers keep the loop running, and
+	//! EventLoop::wait_next_event waits no longer than the next expiry.
+	TimerHandle add_timer( size_t category_id, uint64_t delay_ms, const CallbackT& callback );
+
+	//! Timers that have not fired or been cancelled
+	size_t pending_timers() const { return _timers->size(); }
+
+	//! Rules that have not been removed (a cancelled rule is removed at the next wait)
+	size_t rule_count() const { return _rules->fd.size() + _rules->non_fd.size(); }
+
+	//! Calls [poll(2)](\ref man2::poll) or [epoll_wait(2)](\ref man2::epoll_wait) and then executes the callback
+	//! for a ready fd (or, with Dispatch::Batch, for every ready fd). Timers that are due all fire together.
 	Result wait_next_event( int timeout_ms );
 
 	// convenience function to add category and rule at the same time
@@ -106,6 +209,26 @@ class EventLoop
 	{
 		return add_rule( add_category( name ), std::forward<Targs>( Fargs )... );
 	}
+
+  private:
+	//! What a rule did with the events reported for its fd
+	enum class Outcome : uint8_t
+	{
+		Idle,	 //!< Nothing for this rule
+		Served,	 //!< The callback ran
+		Defunct, //!< The fd had an error or hung up (or the rule busy-waited), and the rule was cancelled
+	};
+
+	bool fire_timers();
+	bool serve_non_fd_rules();
+
+	Outcome serve( FDRule& rule, bool error, bool hangup, bool asked, bool ready );
+	void erase_fd_rule( uint32_t slot );
+	void update_registrations();
+	void register_fd( int fd_num, Registration& reg );
+	Result wait_poll( int timeout_ms );
+	Result wait_epoll( int timeout_ms );
+	Result wait_fds( int timeout_ms, bool fired );
 };
 
 using Direction = EventLoop::Direction;
@@ -0,0 +1,207 @@
+#include "eventloop_group.hh"
+#include "exception.hh"
+
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+/**
+ * @brief Pin the calling thread to the `index`th CPU it may run on (wrapping around), if the system allows it.
+ */
+void pin_to_cpu( const size_t index )
+{
+	cpu_set_t allowed;
+	CPU_ZERO( &allowed );
+	if ( ::sched_getaffinity( 0, sizeof( allowed ), &allowed ) != 0 or CPU_COUNT( &allowed ) == 0 ) {
+		return;
+	}
+
+	size_t skip = index % static_cast<size_t>( CPU_COUNT( &allowed ) );
+	for ( int cpu = 0; cpu < CPU_SETSIZE; ++cpu ) {
+		if ( CPU_ISSET( cpu, &allowed ) and skip-- == 0 ) {
+			cpu_set_t one;
+			CPU_ZERO( &one );
+			CPU_SET( cpu, &one );
+			::pthread_setaffinity_np( ::pthread_self(), sizeof( one ), &one ); // best effort
+			return;
+		}
+	}
+}
+} // namespace
+
+EventLoopGroup::Shard::Shard()
+  : wakeup( CheckSystemCall( "eventfd", ::eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK ) ) )
+{}
+
+EventLoopGroup::EventLoopGroup( const size_t loops,
+								ConnectionHandler on_connection,
+								const Placement placement,
+								const bool pin_threads )
+  : _on_connection( move( on_connection ) ), _placement( placement )
+{
+	if ( loops == 0 ) {
+		throw runtime_error( "EventLoopGroup needs at least one loop" );
+	}
+
+	_shards.reserve( loops );
+	for ( size_t i = 0; i < loops; ++i ) {
+		_shards.push_back( make_unique<Shard>() );
+	}
+
+	// each shard is complete before any thread starts, so a loop can post to the others right away
+	for ( size_t i = 0; i < loops; ++i ) {
+		Shard* const shard = _shards[i].get();
+		shard->thread = thread( [this, shard, i, pin_threads] { run( *shard, i, pin_threads ); } );
+	}
+}
+
+EventLoopGroup::~EventLoopGroup()
+{
+	try {
+		stop();
+	} catch ( const exception& e ) {
+		cerr << "EventLoopGroup: " << e.what() << "\n";
+	} catch ( ... ) {
+		cerr << "EventLoopGroup: a loop failed with an unknown exception\n";
+	}
+}
+
+/**
+ * @brief A loop's thread: serve the loop until the group stops, then take what was posted before the stop.
+ *
+ * If anything the loop runs throws, the loop stops there, and the exception is kept for stop() to rethrow.
+ */
+void EventLoopGroup::run( Shard& shard, const size_t index, const bool pin_thread )
+{
+	if ( pin_thread ) {
+		pin_to_cpu( index );
+	}
+
+	try {
+		EventLoop loop { EventLoop::Backend::Epoll, EventLoop::Dispatch::Batch };
+		string buffer;
+		loop.add_rule( "EventLoopGroup wakeup", shard.wakeup, Direction::In, [&] {
+			shard.wakeup.read( buffer );
+			drain( shard, loop );
+		} );
+
+		while ( not _stopping.load( memory_order_acquire ) ) {
+			loop.wait_next_event( -1 );
+			shard.rules.store( loop.rule_count(), memory_order_relaxed );
+		}
+		drain( shard, loop );
+	} catch ( ... ) {
+		shard.error = current_exception();
+		shard.failed.store( true, memory_order_release );
+	}
+}
+
+/**
+ * @brief Run the posted tasks and take the assigned connections.
+ *
+ * The flag is cleared first, so a push that the loop stops short of (see MPSCQueue) writes the wakeup again.
+ */
+void EventLoopGroup::drain( Shard& shard, EventLoop& loop )
+{
+	shard.notified.exchange( false, memory_order_acq_rel );
+
+	while ( auto task = shard.tasks.pop() ) {
+		( *task )( loop );
+	}
+
+	while ( auto socket = shard.connections.pop() ) {
+		shard.pending.fetch_sub( 1, memory_order_relaxed );
+		_on_connection( loop, move( *socket ) );
+	}
+}
+
+/**
+ * @brief Rethrow the exception that stopped a loop, if one did.
+ */
+void EventLoopGroup::check_running( const Shard& shard )
+{
+	if ( shard.failed.load( memory_order_acquire ) ) {
+		rethrow_exception( shard.error );
+	}
+}
+
+/**
+ * @brief Wake a loop to drain its queues, unless a wakeup is already on its way.
+ */
+void EventLoopGroup::notify( Shard& shard )
+{
+	if ( not shard.notified.exchange( true, memory_order_acq_rel ) ) {
+		const uint64_t one = 1;
+		CheckSystemCall( "write", ::write( shard.wakeup.fd_num(), &one, sizeof( one ) ) );
+	}
+}
+
+void EventLoopGroup::post( const size_t index, Task task )
+{
+	Shard& shard = *_shards.at( index );
+	check_running( shard );
+	shard.tasks.push( move( task ) );
+	notify( shard );
+}
+
+size_t EventLoopGroup::assign( TCPSocket socket )
+{
+	size_t index = 0;
+	if ( _placement == Placement::Hash ) {
+		index = hash<string> {}( socket.peer_address().to_string() ) % _shards.size();
+	} else {
+		for ( size_t i = 1; i < _shards.size(); ++i ) {
+			const bool failed = _shards[index]->failed.load( memory_order_relaxed );
+			if ( ( failed or load( i ) < load( index ) ) and not _shards[i]->failed.load( memory_order_relaxed ) ) {
+				index = i;
+			}
+		}
+	}
+
+	Shard& shard = *_shards[index];
+	check_running( shard );
+	shard.pending.fetch_add( 1, memory_order_relaxed );
+	shard.connections.push( move( socket ) );
+	notify( shard );
+	return index;
+}
+
+size_t EventLoopGroup::load( const size_t index ) const
+{
+	const Shard& shard = *_shards.at( index );
+	return shard.rules.load( memory_order_relaxed ) + shard.pending.load( memory_order_relaxed );
+}
+
+void EventLoopGroup::stop()
+{
+	for ( const auto& shard : _shards ) {
+		if ( shard->thread.get_id() == this_thread::get_id() ) {
+			throw runtime_error( "EventLoopGroup::stop() called from one of its loops" );
+		}
+	}
+
+	_stopping.store( true, memory_order_release );
+	for ( const auto& shard : _shards ) {
+		if ( shard->thread.joinable() ) {
+			notify( *shard );
+			shard->thread.join();
+		}
+	}
+
+	// Reported once (a later stop(), such as the destructor's, does not rethrow it)
+	for ( const auto& shard : _shards ) {
+		if ( shard->failed.load( memory_order_acquire ) and not _failure_reported ) {
+			_failure_reported = true;
+			rethrow_exception( shard->error );
+		}
+	}
+}
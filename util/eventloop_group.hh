@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "eventloop.hh"
+#include "inplace_function.hh"
+#include "mpsc_queue.hh"
+#include "socket.hh"
+
+//! Runs several EventLoops, each on its own thread (pinned to its own CPU where allowed), and spreads connections
+//! across them. Any thread can post a task to a loop through the loop's lock-free queue; the loop runs it on its
+//! own thread. The loops use Backend::Epoll and Dispatch::Batch.
+class EventLoopGroup
+{
+  public:
+	//! Work to run on a loop's thread
+	using Task = InplaceFunction<void( EventLoop& )>;
+
+	//! Takes ownership of a connection, on the thread of the loop it was assigned to
+	using ConnectionHandler = std::function<void( EventLoop&, TCPSocket )>;
+
+	//! How EventLoopGroup::assign chooses a loop for a connection
+	enum class Placement : uint8_t
+	{
+		Hash,		//!< By a hash of the peer's address and port, which needs no shared state
+		LeastLoaded //!< The loop with the fewest rules, counting connections it has yet to take
+	};
+
+	//! Start `loops` loops (at least one), which hand each connection they are assigned to `on_connection`
+	EventLoopGroup( size_t loops,
+					ConnectionHandler on_connection,
+					Placement placement = Placement::LeastLoaded,
+					bool pin_threads = true );
+
+	//! Stops the loops
+	~EventLoopGroup();
+
+	EventLoopGroup( const EventLoopGroup& other ) = delete;
+	EventLoopGroup& operator=( const EventLoopGroup& other ) = delete;
+	EventLoopGroup( EventLoopGroup&& other ) = delete;
+	EventLoopGroup& operator=( EventLoopGroup&& other ) = delete;
+
+	size_t size() const { return _shards.size(); }
+
+	//! Run `task` on loop `index` (callable from any thread). If that loop has failed, rethrows what stopped it.
+	void post( size_t index, Task task );
+
+	//! Hand a connection to a loop, chosen by the Placement; returns the loop's index (callable from any thread).
+	//! LeastLoaded passes over loops that have failed; if the loop chosen has failed, rethrows what stopped it.
+	size_t assign( TCPSocket socket );
+
+	//! The load of loop `index`: its rules after its last wakeup, plus the connections it has yet to take
+	size_t load( size_t index ) const;
+
+	//! Wake every loop, let each run the tasks and take the connections already posted to it, and wait for the
+	//! threads to finish. Call it from outside the loops; later posts are dropped. If a loop failed (a task,
+	//! handler or callback threw), rethrows the exception that stopped the first such loop, once.
+	void stop();
+
+  private:
+	//! One loop's thread and the ways in to it
+	struct Shard
+	{
+		MPSCQueue<Task> tasks {};
+		MPSCQueue<TCPSocket> connections {};
+		FileDescriptor wakeup; //!< An eventfd, which other threads write by number (FileDescriptor isn't shared)
+		std::atomic<bool> notified {}; //!< Whether the wakeup has been written since the loop last drained
+		std::atomic<size_t> pending {}; //!< Connections assigned but not yet taken
+		std::atomic<size_t> rules {};	//!< The loop's rule count after its last wakeup
+		std::exception_ptr error {};	//!< What stopped the loop, if it failed (set before `failed`)
+		std::atomic<bool> failed {};
+		std::thread thread {};
+
+		Shard();
+	};
+
+	std::vector<std::unique_ptr<Shard>> _shards {};
+	ConnectionHandler _on_connection;
+	Placement _placement;
+	std::atomic<bool> _stopping {};
+	bool _failure_reported {}; //!< Whether stop() has rethrown a loop's exception
+
+	void run( Shard& shard, size_t index, bool pin_thread );
+	void drain( Shard& shard, EventLoop& loop );
+	static void notify( Shard& shard );
+	static void check_running( const Shard& shard );
+};
@@ -3,6 +3,7 @@
 #include "ref.hh"
 #include <cstddef>
 #include <memory>
+#include <span>
 #include <vector>
 
 // A reference-counted handle to a file descriptor
@@ -65,6 +66,10 @@ class FileDescriptor
 	void read( std::string& buffer );
 	void read( std::vector<std::string>& buffers );
 
+	// Read directly into caller-owned memory (e.g. from Writer::reserve())
+	// returns number of bytes read
+	size_t read( const std::vector<std::span<char>>& buffers );
+
 	// Attempt to write a buffer
 	// returns number of bytes written
 	size_t write( std::string_view buffer );
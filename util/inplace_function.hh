@@ -0,0 +1,162 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//! A copyable callable wrapper like std::function, whose target is stored in place when it is at most `Capacity`
+//! bytes (which covers lambdas that capture up to four references or pointers). A larger target falls back to
+//! the heap.
+template<class Signature, size_t Capacity = 32>
+class InplaceFunction;
+
+template<class R, class... Args, size_t Capacity>
+class InplaceFunction<R( Args... ), Capacity>
+{
+	using Invoker = R ( * )( void* target, Args&&... args );
+
+	//! How to copy, move and destroy the target, one table per target type
+	struct Ops
+	{
+		void ( *copy )( void* dst, const void* src );
+		void ( *move )( void* dst, void* src ) noexcept; //!< Move-construct `dst` from `src`, and destroy `src`
+		void ( *destroy )( void* target ) noexcept;
+	};
+
+	template<class F>
+	static constexpr bool fits_in_place = sizeof( F ) <= Capacity
+										  and alignof( F ) <= alignof( void* )
+										  and std::is_nothrow_move_constructible_v<F>;
+
+	template<class F>
+	static F& target_of( void* storage )
+	{
+		if constexpr ( fits_in_place<F> ) {
+			return *std::launder( static_cast<F*>( storage ) );
+		} else {
+			return **static_cast<F**>( storage );
+		}
+	}
+
+	template<class F>
+	static R invoke( void* target, Args&&... args )
+	{
+		return std::invoke( target_of<F>( target ), std::forward<Args>( args )... );
+	}
+
+	template<class F>
+	static constexpr Ops ops_for {
+	  []( void* dst, const void* src ) {
+		  const F& from = target_of<F>( const_cast<void*>( src ) ); // NOLINT(*-const-cast)
+		  if constexpr ( fits_in_place<F> ) {
+			  ::new ( dst ) F( from );
+		  } else {
+			  ::new ( dst ) F*( new F( from ) ); // NOLINT(*-owning-memory)
+		  }
+	  },
+	  []( void* dst, void* src ) noexcept {
+		  if constexpr ( fits_in_place<F> ) {
+			  ::new ( dst ) F( std::move( target_of<F>( src ) ) );
+			  target_of<F>( src ).~F();
+		  } else {
+			  ::new ( dst ) F*( *static_cast<F**>( src ) );
+		  }
+	  },
+	  []( void* target ) noexcept {
+		  if constexpr ( fits_in_place<F> ) {
+			  target_of<F>( target ).~F();
+		  } else {
+			  delete *static_cast<F**>( target ); // NOLINT(*-owning-memory)
+		  }
+	  } };
+
+	alignas( void* ) mutable std::array<std::byte, Capacity> storage_ {};
+	Invoker invoke_ {}; //!< Called directly, as the table is only needed to copy, move or destroy the target
+	const Ops* ops_ {};
+
+  public:
+	InplaceFunction() = default;
+	InplaceFunction( std::nullptr_t ) {} // NOLINT(*-explicit-*)
+
+	template<class F>
+		requires( not std::is_same_v<std::decay_t<F>, InplaceFunction>
+				  and std::is_invocable_r_v<R, std::decay_t<F>&, Args...> )
+	InplaceFunction( F&& f ) // NOLINT(*-explicit-*)
+	  : invoke_( &invoke<std::decay_t<F>> ), ops_( &ops_for<std::decay_t<F>> )
+	{
+		using Target = std::decay_t<F>;
+		if constexpr ( fits_in_place<Target> ) {
+			::new ( storage_.data() ) Target( std::forward<F>( f ) );
+		} else {
+			::new ( storage_.data() ) Target*( new Target( std::forward<F>( f ) ) ); // NOLINT(*-owning-memory)
+		}
+	}
+
+	InplaceFunction( const InplaceFunction& other ) : invoke_( other.invoke_ ), ops_( other.ops_ )
+	{
+		if ( ops_ ) {
+			ops_->copy( storage_.data(), other.storage_.data() );
+		}
+	}
+
+	InplaceFunction( InplaceFunction&& other ) noexcept
+	  : invoke_( std::exchange( other.invoke_, nullptr ) ), ops_( std::exchange( other.ops_, nullptr ) )
+	{
+		if ( ops_ ) {
+			ops_->move( storage_.data(), other.storage_.data() );
+		}
+	}
+
+	InplaceFunction& operator=( const InplaceFunction& other )
+	{
+		if ( this != &other ) {
+			*this = InplaceFunction { other };
+		}
+		return *this;
+	}
+
+	InplaceFunction& operator=( InplaceFunction&& other ) noexcept
+	{
+		if ( this != &other ) {
+			reset();
+			invoke_ = std::exchange( other.invoke_, nullptr );
+			ops_ = std::exchange( other.ops_, nullptr );
+			if ( ops_ ) {
+				ops_->move( storage_.data(), other.storage_.data() );
+			}
+		}
+		return *this;
+	}
+
+	InplaceFunction& operator=( std::nullptr_t )
+	{
+		reset();
+		return *this;
+	}
+
+	~InplaceFunction() { reset(); }
+
+	explicit operator bool() const { return ops_ != nullptr; }
+
+	//! Call the target (which must exist)
+	R operator()( Args... args ) const { return invoke_( storage_.data(), std::forward<Args>( args )... ); }
+
+	//! Whether a target of type F would be stored in place
+	template<class F>
+	static constexpr bool stored_in_place()
+	{
+		return fits_in_place<F>;
+	}
+
+  private:
+	void reset()
+	{
+		if ( ops_ ) {
+			invoke_ = nullptr;
+			std::exchange( ops_, nullptr )->destroy( storage_.data() );
+		}
+	}
+};
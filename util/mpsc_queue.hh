@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+//! An unbounded queue that any number of threads may push to and one thread pops from, without locks.
+//! \details Each value travels in its own node. A push swaps the new node in as the head with one atomic exchange
+//! and then links it behind the previous head, so it never waits. Until that link is made, pop() stops short of
+//! the new node (and of any pushed after it), so the consumer should be told to look again after every push.
+template<class T>
+class MPSCQueue
+{
+	struct Node
+	{
+		std::atomic<Node*> next { nullptr };
+		std::optional<T> value {};
+	};
+
+	std::atomic<Node*> head_; //!< The most recently pushed node (shared by the producers)
+	Node* tail_;			  //!< The node before the oldest value, whose own value is gone (the consumer's)
+
+  public:
+	MPSCQueue() : head_( new Node ), tail_( head_.load() ) {} // NOLINT(*-owning-memory)
+
+	~MPSCQueue()
+	{
+		while ( tail_ != nullptr ) {
+			delete std::exchange( tail_, tail_->next.load( std::memory_order_relaxed ) ); // NOLINT(*-owning-memory)
+		}
+	}
+
+	MPSCQueue( const MPSCQueue& other ) = delete;
+	MPSCQueue& operator=( const MPSCQueue& other ) = delete;
+	MPSCQueue( MPSCQueue&& other ) = delete;
+	MPSCQueue& operator=( MPSCQueue&& other ) = delete;
+
+	//! Add a value (from any thread)
+	void push( T value )
+	{
+		Node* const node = new Node; // NOLINT(*-owning-memory)
+		node->value.emplace( std::move( value ) );
+		Node* const previous = head_.exchange( node, std::memory_order_acq_rel );
+		previous->next.store( node, std::memory_order_release );
+	}
+
+	//! Take the oldest value whose push has completed (from the consumer thread only)
+	std::optional<T> pop()
+	{
+		Node* const next = tail_->next.load( std::memory_order_acquire );
+		if ( next == nullptr ) {
+			return std::nullopt;
+		}
+
+		std::optional<T> value { std::move( next->value ) };
+		next->value.reset();
+		delete std::exchange( tail_, next ); // NOLINT(*-owning-memory)
+		return value;
+	}
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+//! Refers to a value in a SlotMap: the slot it is in, and the slot's generation when it was put there
+struct SlotKey
+{
+	uint32_t slot { UINT32_MAX };
+	uint32_t generation {};
+};
+
+//! Values in numbered slots, allocated a page of `PageSize` slots at a time. A value is found by a key that holds
+//! its slot and the slot's generation, which changes when the value is erased, so a stale key finds nothing.
+//! Emplacing and erasing are O(1) (a freed slot is reused first), and a value never moves while it exists.
+template<class T, size_t PageSize = 64>
+class SlotMap
+{
+  public:
+	static constexpr uint32_t NIL = UINT32_MAX;
+
+	using Key = SlotKey;
+
+	//! Construct a value in a free slot
+	template<class... Args>
+	Key emplace( Args&&... args )
+	{
+		uint32_t index = free_;
+		if ( index == NIL ) {
+			if ( slot_count_ == NIL - 1 ) {
+				throw std::runtime_error( "SlotMap::emplace(): too many slots" );
+			}
+			if ( slot_count_ % PageSize == 0 ) {
+				pages_.push_back( std::make_unique<Page>() );
+			}
+			index = slot_count_++;
+		}
+
+		Slot& s = slot_at( index );
+		s.value.emplace( std::forward<Args>( args )... );
+		free_ = s.next_free;
+		s.next_free = NIL;
+		++size_;
+		return { index, s.generation };
+	}
+
+	//! Destroy the value a key refers to; returns false if the key is stale
+	bool erase( Key key )
+	{
+		if ( find( key ) == nullptr ) {
+			return false;
+		}
+		erase_slot( key.slot );
+		return true;
+	}
+
+	//! Destroy the value in an occupied slot
+	void erase_slot( uint32_t index )
+	{
+		Slot& s = slot_at( index );
+		s.value.reset();
+		++s.generation;
+		s.next_free = free_;
+		free_ = index;
+		--size_;
+	}
+
+	//! The value a key refers to, or nullptr if the key is stale
+	T* find( Key key )
+	{
+		if ( key.slot >= slot_count_ ) {
+			return nullptr;
+		}
+		Slot& s = slot_at( key.slot );
+		return s.generation == key.generation and s.value.has_value() ? &*s.value : nullptr;
+	}
+
+	//! The value in a slot, or nullptr if the slot is free
+	T* get( uint32_t index )
+	{
+		std::optional<T>& value = slot_at( index ).value;
+		return value.has_value() ? &*value : nullptr;
+	}
+
+	//! The value in an occupied slot
+	T& operator[]( uint32_t index ) { return *slot_at( index ).value; }
+
+	//! The key to the value in an occupied slot
+	Key key( uint32_t index ) const { return { index, slot_at( index ).generation }; }
+
+	//! Slots that have ever been used; iterate over [0, slot_count()) and skip the ones not occupied
+	uint32_t slot_count() const { return slot_count_; }
+
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+  private:
+	struct Slot
+	{
+		uint32_t generation {};
+		uint32_t next_free { NIL }; //!< The next free slot, while this one is free
+		std::optional<T> value {};
+	};
+
+	using Page = std::array<Slot, PageSize>;
+
+	std::vector<std::unique_ptr<Page>> pages_ {};
+	uint32_t slot_count_ {};
+	uint32_t free_ { NIL };
+	size_t size_ {};
+
+	Slot& slot_at( uint32_t index ) { return ( *pages_[index / PageSize] )[index % PageSize]; }
+	const Slot& slot_at( uint32_t index ) const { return ( *pages_[index / PageSize] )[index % PageSize]; }
+};
@@ -13,11 +13,26 @@ class TCPConfig
 	static constexpr size_t DEFAULT_CAPACITY = 64000; //!< Default capacity
 	static constexpr size_t MAX_PAYLOAD_SIZE = 1000;  //!< Conservative max payload size for real Internet
 	static constexpr uint16_t TIMEOUT_DFLT = 1000;	  //!< Default re-transmit timeout is 1 second
+	static constexpr uint16_t ACK_DELAY_DFLT = 40;	  //!< Default delayed-ack timeout is 40 milliseconds
 	static constexpr unsigned MAX_RETX_ATTEMPTS = 8;  //!< Maximum re-transmit attempts before giving up
+	static constexpr uint8_t MAX_WINDOW_SCALE = 14;	  //!< Largest window scale shift allowed (RFC 7323)
+
+	//! The smallest window scale shift that lets a 16-bit window advertise `capacity` bytes
+	static constexpr uint8_t window_scale_for( size_t capacity )
+	{
+		uint8_t shift = 0;
+		while ( shift < MAX_WINDOW_SCALE and ( capacity >> shift ) > UINT16_MAX ) {
+			++shift;
+		}
+		return shift;
+	}
 
 	uint16_t rt_timeout = TIMEOUT_DFLT;		 //!< Initial value of the retransmission timeout, in milliseconds
+	uint16_t ack_delay = ACK_DELAY_DFLT;	 //!< Longest the receiver holds back an ack, in milliseconds
 	size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes
+	size_t recv_capacity_max = 0;			 //!< Auto-tuning limit on the receive capacity (0 for none)
 	size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes
+	uint8_t recv_window_scale = 0;			 //!< Window scale shift the receiver uses, if the peer supports it
 	Wrap32 isn { 137 };						 //!< Default initial sequence number
 };
 
@@ -2,7 +2,10 @@
 
 #include "wrapping_integers.hh"
 
+#include <cstddef>
+#include <cstdint>
 #include <optional>
+#include <vector>
 
 /*
  * The TCPReceiverMessage structure contains the information sent from a TCP receiver to its sender.
@@ -14,14 +17,42 @@
  *
  * 2) The window size. This is the number of sequence numbers that the TCP receiver is interested
  *    to receive, starting from the ackno if present. The maximum value is 65,535 (UINT16_MAX from
- *    the <cstdint> header).
+ *    the <cstdint> header), in units of 2^window_scale bytes if window scaling was negotiated.
  *
  * 3) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * 4) Selective acknowledgment (SACK) blocks: ranges of sequence numbers beyond the ackno that the receiver
+ *    already holds, so the sender need not retransmit them. The block with the most recently received
+ *    segment comes first, and there are at most MAX_SACK_BLOCKS (as many as fit in the TCP options).
+ *
+ * 5) The window scale (RFC 7323): once the sender's SYN has asked for window scaling, the shift the
+ *    receiver applies to its windows, so the window is window_size << window_scale bytes. (On the wire
+ *    this option travels once, on the SYN-ACK; it is repeated here so that each message stands alone.)
+ *    The window of the SYN-ACK itself is never scaled, so until the sender has acknowledged the receiver's
+ *    SYN, the receiver's messages are marked `syn_ack` and their window is window_size bytes.
  */
 
+// The sequence numbers [left_edge, right_edge)
+struct SACKBlock
+{
+	Wrap32 left_edge;
+	Wrap32 right_edge;
+};
+
 struct TCPReceiverMessage
 {
+	static constexpr size_t MAX_SACK_BLOCKS = 4;
+
 	std::optional<Wrap32> ackno {};
 	uint16_t window_size {};
 	bool RST {};
+	std::vector<SACKBlock> sack_blocks {};
+	std::optional<uint8_t> window_scale {};
+	bool syn_ack {}; // Sent before the sender acknowledged the receiver's SYN, so the window is not scaled
+
+	// The window in bytes, with the scale applied (if it is in effect yet)
+	uint64_t window() const
+	{
+		return static_cast<uint64_t>( window_size ) << ( syn_ack ? 0 : window_scale.value_or( 0 ) );
+	}
 };
@@ -2,12 +2,15 @@
 
 #include "wrapping_integers.hh"
 
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <string>
 
 /*
  * The TCPSenderMessage structure contains the information sent from a TCP sender to its receiver.
  *
- * It contains five fields:
+ * It contains six fields:
  *
  * 1) The sequence number (seqno) of the beginning of the segment. If the SYN flag is set, this is the
  *    sequence number of the SYN flag. Otherwise, it's the sequence number of the beginning of the payload.
@@ -20,6 +23,9 @@
  * 4) The FIN flag. If set, the payload represents the ending of the byte stream.
  *
  * 5) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * 6) The window scale option (RFC 7323), which only means something on a SYN. If present, the sender
+ *    supports window scaling, so the receiver may advertise windows larger than 64 KiB in scaled units.
  */
 
 struct TCPSenderMessage
@@ -32,6 +38,8 @@ struct TCPSenderMessage
 
 	bool RST {};
 
+	std::optional<uint8_t> window_scale {};
+
 	// How many sequence numbers does this segment use?
 	size_t sequence_length() const { return SYN + payload.size() + FIN; }
 };
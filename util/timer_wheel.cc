@@ -0,0 +1,204 @@
+#include "timer_wheel.hh"
+
+#include <bit>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+TimerWheel::TimerWheel( uint64_t now_ms ) : now_ms_( now_ms )
+{
+	heads_.fill( NIL );
+	tails_.fill( NIL );
+}
+
+/**
+ * @brief Add a timer, taking a free entry if there is one.
+ */
+TimerWheel::TimerId TimerWheel::add( uint64_t delay_ms, CallbackT callback )
+{
+	uint32_t index = free_;
+	if ( index == NIL ) {
+		if ( timers_.size() >= NIL ) {
+			throw runtime_error( "TimerWheel::add(): too many timers" );
+		}
+		index = static_cast<uint32_t>( timers_.size() );
+		timers_.emplace_back();
+	} else {
+		free_ = timers_[index].next;
+	}
+
+	Timer& timer = timers_[index];
+	timer.expiry_ms = now_ms_ + min( delay_ms, MAX_DELAY );
+	timer.callback = std::move( callback );
+	schedule( index );
+	++size_;
+
+	return { index, timer.generation };
+}
+
+bool TimerWheel::cancel( TimerId id )
+{
+	if ( id.index >= timers_.size() ) {
+		return false;
+	}
+
+	Timer& timer = timers_[id.index];
+	if ( timer.generation != id.generation or timer.list == NO_LIST ) {
+		return false;
+	}
+
+	unlink( id.index );
+	timer.callback = nullptr;
+	++timer.generation;
+	timer.next = free_;
+	free_ = id.index;
+	--size_;
+	return true;
+}
+
+/**
+ * @brief Move time forward one wakeup at a time: at each, cascade the higher-level slots that start then, and
+ * fire the timers in the level-0 slot.
+ */
+size_t TimerWheel::advance( uint64_t now_ms )
+{
+	size_t fired = 0;
+
+	for ( auto wakeup = next_wakeup(); wakeup.has_value() and *wakeup <= now_ms; wakeup = next_wakeup() ) {
+		now_ms_ = *wakeup;
+
+		for ( unsigned level = LEVELS - 1; level > 0; --level ) {
+			const unsigned shift = level * SLOT_BITS;
+			if ( now_ms_ & ( ( uint64_t { 1 } << shift ) - 1 ) ) {
+				continue;
+			}
+			const auto slot = static_cast<uint16_t>( level * SLOTS + ( ( now_ms_ >> shift ) & ( SLOTS - 1 ) ) );
+			for ( uint32_t index = detach( slot ); index != NIL; ) {
+				const uint32_t next = timers_[index].next;
+				timers_[index].list = NO_LIST;
+				schedule( index );
+				index = next;
+			}
+		}
+
+		// Callbacks may cancel timers that are waiting to fire, so those stay linked into the firing list
+		const auto slot = static_cast<uint16_t>( now_ms_ & ( SLOTS - 1 ) );
+		tails_[FIRING_LIST] = tails_[slot];
+		heads_[FIRING_LIST] = detach( slot );
+		for ( uint32_t index = heads_[FIRING_LIST]; index != NIL; index = timers_[index].next ) {
+			timers_[index].list = FIRING_LIST;
+		}
+		while ( heads_[FIRING_LIST] != NIL ) {
+			const uint32_t index = heads_[FIRING_LIST];
+			CallbackT callback = std::move( timers_[index].callback );
+			cancel( { index, timers_[index].generation } );
+			++fired;
+			callback();
+		}
+	}
+
+	now_ms_ = max( now_ms_, now_ms );
+	return fired;
+}
+
+std::optional<uint64_t> TimerWheel::next_wakeup() const
+{
+	optional<uint64_t> earliest;
+	for ( unsigned level = 0; level < LEVELS; ++level ) {
+		const auto start = slot_start( level );
+		if ( start.has_value() and ( not earliest.has_value() or *start < *earliest ) ) {
+			earliest = start;
+		}
+	}
+	return earliest;
+}
+
+/**
+ * @brief The time the first occupied slot of a level starts (for level 0, when its timers expire).
+ *
+ * Every timer in level L expires less than 64^(L+1) ms from now, in a slot that starts after now (at or after
+ * now, for level 0), so a slot's position relative to the current one gives its start time.
+ */
+optional<uint64_t> TimerWheel::slot_start( unsigned level ) const
+{
+	if ( occupied_[level] == 0 ) {
+		return nullopt;
+	}
+
+	// Above level 0, the current slot has started, so a timer there is a full turn of the wheel away
+	const unsigned shift = level * SLOT_BITS;
+	const uint64_t first = ( now_ms_ >> shift ) + ( level > 0 ? 1 : 0 );
+	const auto rotated = rotr( occupied_[level], static_cast<int>( first & ( SLOTS - 1 ) ) );
+	return ( first + static_cast<uint64_t>( countr_zero( rotated ) ) ) << shift;
+}
+
+/**
+ * @brief Put a timer in the lowest level whose slots reach its expiry.
+ */
+void TimerWheel::schedule( uint32_t index )
+{
+	const uint64_t expiry = timers_[index].expiry_ms;
+	const uint64_t delay = expiry > now_ms_ ? expiry - now_ms_ : 0;
+
+	unsigned level = 0;
+	while ( level + 1 < LEVELS and delay >> ( ( level + 1 ) * SLOT_BITS ) ) {
+		++level;
+	}
+
+	// An overdue timer (added with a zero delay while firing) fires at the current time
+	const uint64_t when = max( expiry, now_ms_ );
+	link( index, static_cast<uint16_t>( level * SLOTS + ( ( when >> ( level * SLOT_BITS ) ) & ( SLOTS - 1 ) ) ) );
+}
+
+void TimerWheel::link( uint32_t index, uint16_t list )
+{
+	Timer& timer = timers_[index];
+	timer.list = list;
+	timer.prev = tails_[list];
+	timer.next = NIL;
+	if ( timer.prev != NIL ) {
+		timers_[timer.prev].next = index;
+	} else {
+		heads_[list] = index;
+	}
+	tails_[list] = index;
+
+	if ( list < FIRING_LIST ) {
+		occupied_[list / SLOTS] |= uint64_t { 1 } << ( list % SLOTS );
+	}
+}
+
+void TimerWheel::unlink( uint32_t index )
+{
+	Timer& timer = timers_[index];
+	if ( timer.prev != NIL ) {
+		timers_[timer.prev].next = timer.next;
+	} else {
+		heads_[timer.list] = timer.next;
+	}
+	if ( timer.next != NIL ) {
+		timers_[timer.next].prev = timer.prev;
+	} else {
+		tails_[timer.list] = timer.prev;
+	}
+
+	if ( timer.list < FIRING_LIST and heads_[timer.list] == NIL ) {
+		occupied_[timer.list / SLOTS] &= ~( uint64_t { 1 } << ( timer.list % SLOTS ) );
+	}
+	timer.list = NO_LIST;
+}
+
+/**
+ * @brief Empty a list, returning its former head (the timers stay chained through Timer::next).
+ */
+uint32_t TimerWheel::detach( uint16_t list )
+{
+	const uint32_t head = heads_[list];
+	heads_[list] = NIL;
+	tails_[list] = NIL;
+	if ( list < FIRING_LIST ) {
+		occupied_[list / SLOTS] &= ~( uint64_t { 1 } << ( list % SLOTS ) );
+	}
+	return head;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "inplace_function.hh"
+
+//! A hierarchical timing wheel: timers are added and cancelled in O(1) and fire in order of their expiry time,
+//! to the millisecond.
+//! \details Level L of the wheel has 64 slots of 64^L ms each. A timer goes in the lowest level whose 64 slots
+//! reach its expiry time, and moves down a level ("cascades") when time reaches the start of its slot. Delays
+//! are capped at 64^6 ms (over two years).
+class TimerWheel
+{
+  public:
+	using CallbackT = InplaceFunction<void( void )>;
+
+	//! Identifies a timer; it goes stale once the timer fires or is cancelled.
+	struct TimerId
+	{
+		uint32_t index {};
+		uint32_t generation {};
+	};
+
+	explicit TimerWheel( uint64_t now_ms = 0 );
+
+	//! Call `callback` once `delay_ms` have passed (at the first advance() to now() + delay_ms or later).
+	TimerId add( uint64_t delay_ms, CallbackT callback );
+
+	//! Cancel a timer; returns whether it was still pending.
+	bool cancel( TimerId id );
+
+	//! Advance the wheel's time to `now_ms` (if later), firing every timer that is due, in order of expiry.
+	//! Callbacks may add or cancel timers. Returns the number of timers fired.
+	size_t advance( uint64_t now_ms );
+
+	//! The time by which advance() should next be called, if any timer is pending: the expiry of the earliest
+	//! timer, or earlier, when timers are due to cascade.
+	std::optional<uint64_t> next_wakeup() const;
+
+	uint64_t now() const { return now_ms_; }
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+  private:
+	static constexpr unsigned LEVELS = 6;
+	static constexpr unsigned SLOT_BITS = 6;
+	static constexpr unsigned SLOTS = 1 << SLOT_BITS;
+	static constexpr uint64_t MAX_DELAY = ( uint64_t { 1 } << ( LEVELS * SLOT_BITS ) ) - 1;
+	static constexpr uint32_t NIL = UINT32_MAX;
+	static constexpr uint16_t NO_LIST = UINT16_MAX;
+	static constexpr uint16_t FIRING_LIST = LEVELS * SLOTS; // timers due now, being fired
+
+	struct Timer
+	{
+		uint64_t expiry_ms {};
+		CallbackT callback {};
+		uint32_t prev { NIL };
+		uint32_t next { NIL };
+		uint32_t generation {};
+		uint16_t list { NO_LIST }; //!< The slot (level * SLOTS + slot) or other list the timer is linked into
+	};
+
+	std::vector<Timer> timers_ {};
+	uint32_t free_ { NIL }; //!< Unused entries of timers_, linked through Timer::next
+	std::array<uint32_t, LEVELS * SLOTS + 1> heads_ {};
+	std::array<uint32_t, LEVELS * SLOTS + 1> tails_ {}; //!< Timers are appended, so equal expiries fire in order
+	std::array<uint64_t, LEVELS> occupied_ {}; //!< Which slots of each level have timers
+	uint64_t now_ms_;
+	size_t size_ {};
+
+	void link( uint32_t index, uint16_t list );
+	void unlink( uint32_t index );
+	void schedule( uint32_t index );
+	uint32_t detach( uint16_t list );
+	std::optional<uint64_t> slot_start( unsigned level ) const;
+};